@@ -79,3 +79,88 @@
 @call ../src/semper_build.bat -c Debug
 @popd
 
+
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@REM |                          glTF Generator                                |
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@set S_OUT_BIN=gltf_generator.exe
+@set S_STATIC_LIB=0
+
+@REM -----------------------------Sources--------------------------------------
+@set S_SOURCES=tools/gltf_generator.cpp tools/mvSceneGenerator.cpp
+
+@REM ----------------------------Libraries-------------------------------------
+@set S_LINK_LIBRARIES=
+
+@REM ---------------------Run Semper build script------------------------------
+@pushd %dir%
+@call ../src/semper_build.bat -c Release
+@popd
+
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@REM |                          Render Benchmark                              |
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@set S_OUT_BIN=render_benchmark.exe
+@set S_STATIC_LIB=0
+
+@REM -----------------------------Sources--------------------------------------
+@set S_SOURCES=tools/render_benchmark.cpp tools/mvSceneGenerator.cpp mv*.cpp
+
+@REM ----------------------------Libraries-------------------------------------
+@set S_LINK_LIBRARIES=dependencies.lib d3d11.lib d3dcompiler.lib psapi.lib
+
+@REM ---------------------Run Semper build script------------------------------
+@pushd %dir%
+@call ../src/semper_build.bat -c Debug
+@popd
+
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@REM |                          Asset Analysis                                |
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@set S_OUT_BIN=asset_analysis.exe
+@set S_STATIC_LIB=0
+
+@REM -----------------------------Sources--------------------------------------
+@set S_SOURCES=tools/asset_analysis.cpp mv*.cpp
+
+@REM ----------------------------Libraries-------------------------------------
+@set S_LINK_LIBRARIES=dependencies.lib d3d11.lib d3dcompiler.lib
+
+@REM ---------------------Run Semper build script------------------------------
+@pushd %dir%
+@call ../src/semper_build.bat -c Debug
+@popd
+
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@REM |                          Load Benchmark                                |
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@set S_OUT_BIN=load_benchmark.exe
+@set S_STATIC_LIB=0
+
+@REM -----------------------------Sources--------------------------------------
+@set S_SOURCES=tools/load_benchmark.cpp mv*.cpp
+
+@REM ----------------------------Libraries-------------------------------------
+@set S_LINK_LIBRARIES=dependencies.lib d3d11.lib d3dcompiler.lib
+
+@REM ---------------------Run Semper build script------------------------------
+@pushd %dir%
+@call ../src/semper_build.bat -c Debug
+@popd
+
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@REM |                          Shader Census                                 |
+@REM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+@set S_OUT_BIN=shader_census.exe
+@set S_STATIC_LIB=0
+
+@REM -----------------------------Sources--------------------------------------
+@set S_SOURCES=tools/shader_census.cpp mv*.cpp
+
+@REM ----------------------------Libraries-------------------------------------
+@set S_LINK_LIBRARIES=dependencies.lib d3d11.lib d3dcompiler.lib
+
+@REM ---------------------Run Semper build script------------------------------
+@pushd %dir%
+@call ../src/semper_build.bat -c Debug
+@popd
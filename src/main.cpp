@@ -10,10 +10,11 @@
 #include "gltf_scene_info.h"
 #include "mvAnimation.h"
 #include "mvAssetLoader.h"
+#include "mvModelCache.h"
+#include "mvPipelineCompiler.h"
 #include "mvViewport.h"
 
 #define MV_ENVIRONMENT_CACHE 3
-#define MV_MODEL_CACHE 5
 
 struct mvTimer
 {
@@ -41,6 +42,10 @@ bool reloadMaterials = false;
 bool recreatePrimary = false;
 bool recreateEnvironment = false;
 bool changeScene = true;
+bool reloadModels = false;
+bool batchStatic = false;
+bool bakeOcclusion = false;
+bool progressiveLoading = true;
 
 int main()
 {    
@@ -53,21 +58,20 @@ int main()
 
     // model caching
     int modelIndex = 27;
-    int currentModel = 0;
-    int nextModelCacheIndex = 1;
-    mvModel modelCache[MV_MODEL_CACHE];
-    int modelIDCache[MV_MODEL_CACHE];
+    mvModelCache modelCache;
+    mvProgressiveLoad progressiveLoad;
+    mvModel loadingModel;
 
     for (int i = 0; i < MV_ENVIRONMENT_CACHE; i++)
         environmentIDCache[i] = -1;
     environmentIDCache[0] = envMapIndex;
 
-    for (int i = 0; i < MV_MODEL_CACHE; i++)
-        modelIDCache[i] = -1;
-    modelIDCache[0] = modelIndex;
-    
+
     window = initialize_viewport(1850, 900);
     mvGraphics graphics = setup_graphics(*window, "../src/shaders/");
+    load_shader_archive(graphics.shaderCache, MV_SHADER_ARCHIVE_PATH);
+    start_pipeline_compiler(graphics);
+    start_morph_blender(graphics);
 
     // setup imgui
     ImGui::CreateContext();
@@ -81,7 +85,7 @@ int main()
 
     environmentCache[0] = create_environment(graphics, "../data/glTF-Sample-Environments/" + std::string(env_maps[envMapIndex]) + ".hdr", 1024, 1024, 1.0f, 7);
     sGLTFModel gltfmodel0 = Semper::load_gltf(gltf_directories[modelIndex], gltf_models[modelIndex]);
-    modelCache[0] = load_gltf_assets(graphics, gltfmodel0);
+    mvAssetID currentModel = insert_cached_model(graphics, modelCache, modelIndex, load_gltf_assets(graphics, gltfmodel0, gltf_models[modelIndex], batchStatic, bakeOcclusion));
     
     mvRendererContext renderCtx = create_renderer_context(graphics);
 
@@ -119,7 +123,8 @@ int main()
 
         if (reloadMaterials)
         {
-            reload_materials(graphics, &modelCache[currentModel].materialManager);
+            mvModel& model = progressiveLoad.phase != MV_LOAD_PHASE_IDLE ? loadingModel : modelCache.entries[currentModel].model;
+            reload_materials(graphics, &model.materialManager);
             reloadMaterials = false;
         }
 
@@ -162,37 +167,41 @@ int main()
                 }
             }
         }
+        if (reloadModels)
+        {
+            reloadModels = false;
+            clear_model_cache(graphics, modelCache);
+            changeScene = true;
+        }
+
         if (changeScene)
         {
             changeScene = false;
 
-
-            bool cacheFound = false;
-            for (int i = 0; i < MV_MODEL_CACHE; i++)
+            // another model was picked before the last one finished
+            if (progressiveLoad.phase != MV_LOAD_PHASE_IDLE)
             {
-                if (modelIndex == modelIDCache[i])
-                {
-                    currentModel = i;
-                    cacheFound = true;
-                    break;
-                }
+                cancel_progressive_load(graphics, progressiveLoad, loadingModel);
+                Semper::free_gltf(gltfmodel0);
+                loadingModel = {};
             }
 
-            if (!cacheFound)
+            currentModel = find_cached_model(modelCache, modelIndex);
+            if (currentModel == -1)
             {
-                currentModel = nextModelCacheIndex;
-                unload_gltf_assets(modelCache[nextModelCacheIndex]);
-                modelIDCache[nextModelCacheIndex] = modelIndex;
                 gltfmodel0 = Semper::load_gltf(gltf_directories[modelIndex], gltf_models[modelIndex]);
-                modelCache[nextModelCacheIndex] = load_gltf_assets(graphics, gltfmodel0);
-                Semper::free_gltf(gltfmodel0);
-                nextModelCacheIndex++;
-                if (nextModelCacheIndex >= MV_MODEL_CACHE)
-                    nextModelCacheIndex = 0;
+                if (progressiveLoading)
+                    begin_progressive_load(graphics, progressiveLoad, loadingModel, gltfmodel0, gltf_models[modelIndex], batchStatic, bakeOcclusion);
+                else
+                {
+                    currentModel = insert_cached_model(graphics, modelCache, modelIndex, load_gltf_assets(graphics, gltfmodel0, gltf_models[modelIndex], batchStatic, bakeOcclusion));
+                    Semper::free_gltf(gltfmodel0);
+                }
             }
 
-            camera.minBound = sVec3{ modelCache[currentModel].minBoundary[0], modelCache[currentModel].minBoundary[1], modelCache[currentModel].minBoundary[2] };
-            camera.maxBound = sVec3{ modelCache[currentModel].maxBoundary[0], modelCache[currentModel].maxBoundary[1], modelCache[currentModel].maxBoundary[2] };
+            mvModel& model = progressiveLoad.phase != MV_LOAD_PHASE_IDLE ? loadingModel : modelCache.entries[currentModel].model;
+            camera.minBound = sVec3{ model.minBoundary[0], model.minBoundary[1], model.minBoundary[2] };
+            camera.maxBound = sVec3{ model.maxBoundary[0], model.maxBoundary[1], model.maxBoundary[2] };
 
             camera.target.x = (camera.minBound.x + camera.maxBound.x) / 2.0f;
             camera.target.y = (camera.minBound.y + camera.maxBound.y) / 2.0f;
@@ -223,6 +232,17 @@ int main()
             camera.pos = sVec3{ target[0], target[1], target[2] + camera.distance };
         }
 
+        // uses last frame's camera and node transforms for priorities
+        if (progressiveLoad.phase != MV_LOAD_PHASE_IDLE)
+        {
+            if (update_progressive_load(graphics, progressiveLoad, loadingModel, create_arcball_view(camera), create_projection(camera), offscreen.viewport.Height))
+            {
+                Semper::free_gltf(gltfmodel0);
+                currentModel = insert_cached_model(graphics, modelCache, modelIndex, std::move(loadingModel));
+                loadingModel = {};
+            }
+        }
+
         //-----------------------------------------------------------------------------
         // clear targets
         //-----------------------------------------------------------------------------
@@ -232,11 +252,13 @@ int main()
         ctx->ClearRenderTargetView(offscreen.targetView.Get(), backgroundColor2);
         ctx->ClearDepthStencilView(offscreen.depthView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0u);
 
+        mvModel& model = progressiveLoad.phase != MV_LOAD_PHASE_IDLE ? loadingModel : modelCache.entries[currentModel].model;
+
         //-----------------------------------------------------------------------------
         // update animations
         //-----------------------------------------------------------------------------
-        for (int i = 0; i < modelCache[currentModel].animations.size(); i++)
-            advance_animations(modelCache[currentModel], modelCache[currentModel].animations[i], currentTime);
+        for (int i = 0; i < model.animations.size(); i++)
+            advance_animations(model, model.animations[i], currentTime);
 
         //-----------------------------------------------------------------------------
         // begin frame
@@ -245,11 +267,12 @@ int main()
         ImGui_ImplWin32_NewFrame();
         ImGui::NewFrame();
 
-        ID3D11ShaderResourceView* const pSRV[12] = { NULL };
-        for(int i = 0; i < 12; i++)
-            ctx->PSSetShaderResources(i, 6, pSRV);
+        // nothing from last frame stays bound while it is a render target again, render_job
+        // leaves slots its materials don't read untouched
+        ID3D11ShaderResourceView* const pSRV[17] = { NULL };
+        ctx->PSSetShaderResources(0u, 17u, pSRV);
 
-        int activeScene = modelCache[currentModel].defaultScene;
+        int activeScene = model.defaultScene;
 
         //-----------------------------------------------------------------------------
         // offscreen pass
@@ -261,6 +284,7 @@ int main()
         sMat4 projMatrix = create_projection(camera);
 
         renderCtx.globalInfo.camPos = camera.pos;
+        renderCtx.globalInfo.lightingFlags = (int)get_lighting_flags(graphics);
 
         // update constant buffers
         update_const_buffer(graphics, pointlight.buffer, &pointlight.info);
@@ -282,32 +306,35 @@ int main()
             ctx->PSSetShaderResources(14u, 1, environmentCache[currentEnvironment].brdfLUT.textureView.GetAddressOf());
         }
 
-        render_mesh_solid(graphics, renderCtx, modelCache[currentModel], pointlight.mesh, Semper::translate(pointlight.info.viewLightPos.xyz), viewMatrix, projMatrix);
+        render_mesh_solid(graphics, renderCtx, model, pointlight.mesh, Semper::translate(pointlight.info.viewLightPos.xyz), viewMatrix, projMatrix);
 
         if (activeScene > -1)
         {
-            submit_scene(graphics, modelCache[currentModel], renderCtx, modelCache[currentModel].scenes[activeScene]);
+            submit_scene(graphics, model, renderCtx, model.scenes[activeScene]);
             //-----------------------------------------------------------------------------
             // update skins
             //-----------------------------------------------------------------------------
-            for (int i = 0; i < modelCache[currentModel].nodes.size(); i++)
+            for (int i = 0; i < model.nodes.size(); i++)
             {
-                mvNode& node = modelCache[currentModel].nodes[i];
+                mvNode& node = model.nodes[i];
                 if (node.skin != -1 && node.mesh != -1)
                 {
-                    unsigned int skeleton = modelCache[currentModel].skins[node.skin].skeleton;
+                    unsigned int skeleton = model.skins[node.skin].skeleton;
                     if(skeleton != -1)
-                        compute_joints(graphics, modelCache[currentModel], modelCache[currentModel].nodes[skeleton].inverseWorldTransform, modelCache[currentModel].skins[node.skin]);
+                        compute_joints(graphics, model, model.nodes[skeleton].inverseWorldTransform, model.skins[node.skin]);
                     else
-                        compute_joints(graphics, modelCache[currentModel], viewMatrix, modelCache[currentModel].skins[node.skin]);
+                        compute_joints(graphics, model, viewMatrix, model.skins[node.skin]);
                 }
             }
 
-            render_scenes(graphics, modelCache[currentModel], renderCtx, viewMatrix, projMatrix);
+            render_scenes(graphics, model, renderCtx, viewMatrix, projMatrix);
         }
 
         if (showSkybox && envMapIndex > -1)
-           render_skybox(graphics, renderCtx, modelCache[currentModel], blur ? environmentCache[currentEnvironment].specularMap : environmentCache[currentEnvironment].skyMap, environmentCache[currentEnvironment].sampler.Get(), viewMatrix, projMatrix);
+           render_skybox(graphics, renderCtx, model, blur ? environmentCache[currentEnvironment].specularMap : environmentCache[currentEnvironment].skyMap, environmentCache[currentEnvironment].sampler.Get(), viewMatrix, projMatrix);
+
+        // stream in texture detail requested this frame
+        update_texture_streaming(graphics);
 
         //-----------------------------------------------------------------------------
         // ui
@@ -402,10 +429,32 @@ int main()
             ImGui::Text("%s", "Models");
             if (ImGui::Combo("##models", &modelIndex, gltf_names, 80 + 36 + 59, 20)) changeScene = true;
 
+            if (!model.variants.empty())
+            {
+                ImGui::Text("%s", "Material Variants");
+                std::string preview = model.activeVariant == -1 ? "Default" : model.variants[model.activeVariant];
+                if (ImGui::BeginCombo("##variants", preview.c_str()))
+                {
+                    if (ImGui::Selectable("Default", model.activeVariant == -1)) set_material_variant(model, -1);
+                    for (int i = 0; i < model.variants.size(); i++)
+                    {
+                        if (ImGui::Selectable(model.variants[i].c_str(), model.activeVariant == i)) set_material_variant(model, i);
+                    }
+                    ImGui::EndCombo();
+                }
+            }
+
             ImGui::Dummy(ImVec2(50.0f, 25.0f));
             ImGui::Text("%s", "Lighting");
-            if (ImGui::Checkbox("Punctual Lighting", (bool*)&graphics.punctualLighting))reloadMaterials = true;
-            if (ImGui::Checkbox("Image Based", (bool*)&graphics.imageBasedLighting)) reloadMaterials = true;
+            // toggles in lightingBranches only change GlobalInfo::lightingFlags, the rest recompile
+            if (ImGui::Checkbox("Punctual Lighting", (bool*)&graphics.punctualLighting) && !(graphics.lightingBranches & MV_LIGHTING_PUNCTUAL)) reloadMaterials = true;
+            if (ImGui::Checkbox("Image Based", (bool*)&graphics.imageBasedLighting) && !(graphics.lightingBranches & MV_LIGHTING_IBL)) reloadMaterials = true;
+            bool lightingBranches = graphics.lightingBranches != 0u;
+            if (ImGui::Checkbox("Toggles as Branches", &lightingBranches))
+            {
+                graphics.lightingBranches = lightingBranches ? MV_LIGHTING_ALL : 0u;
+                reloadMaterials = true;
+            }
 
             ImGui::Dummy(ImVec2(50.0f, 25.0f));
             ImGui::Text("%s", "Background");
@@ -425,9 +474,69 @@ int main()
             ImGui::Text("%s", "Point Light:");
             ImGui::SliderFloat3("Position##o", &pointlight.info.viewLightPos.x, -25.0f, 50.0f);
 
+            ImGui::Dummy(ImVec2(50.0f, 25.0f));
+            ImGui::Text("%s", "Texture Streaming");
+            static int textureBudget = graphics.textureStreamer.budget / (1024 * 1024);
+            if (ImGui::SliderInt("Budget (MB)", &textureBudget, 16, 2048)) graphics.textureStreamer.budget = textureBudget * 1024u * 1024u;
+            ImGui::Text("Resident: %.1f MB", graphics.textureStreamer.residentBytes / (1024.0f * 1024.0f));
+            ImGui::Text("Uploaded: %.1f MB, Evictions: %u", graphics.textureStreamer.uploadedBytes / (1024.0f * 1024.0f), graphics.textureStreamer.evictions);
+
+            ImGui::Dummy(ImVec2(50.0f, 25.0f));
+            ImGui::Text("%s", "Geometry Pool");
+            {
+                mvGeometryPool& pool = graphics.geometryPool;
+                unsigned int capacity = pool.indexHeap.capacity * pool.indexHeap.stride;
+                unsigned int used = pool.indexHeap.used * pool.indexHeap.stride;
+                for (int i = 0; i < pool.vertexHeaps.size(); i++)
+                {
+                    capacity += pool.vertexHeaps[i].capacity * pool.vertexHeaps[i].stride;
+                    used += pool.vertexHeaps[i].used * pool.vertexHeaps[i].stride;
+                }
+                ImGui::Text("Heaps: %d, Used: %.1f / %.1f MB", (int)pool.vertexHeaps.size() + 1, used / (1024.0f * 1024.0f), capacity / (1024.0f * 1024.0f));
+                ImGui::Text("Buffers: %u, Defrags: %u", pool.bufferAllocations, pool.defragmentations);
+                ImGui::Text("Binds: %u, Skipped: %u", pool.binds, pool.bindsSkipped);
+                pool.binds = 0u;
+                pool.bindsSkipped = 0u;
+            }
+
+            ImGui::Dummy(ImVec2(50.0f, 25.0f));
+            ImGui::Text("%s", "Model Cache");
+            static int modelBudget = (int)(modelCache.budget / (1024 * 1024));
+            if (ImGui::SliderInt("Cache Budget (MB)", &modelBudget, 64, 4096)) modelCache.budget = modelBudget * (size_t)(1024 * 1024);
+            static bool pinModel = false;
+            if (progressiveLoad.phase == MV_LOAD_PHASE_IDLE)
+            {
+                pinModel = modelCache.entries[currentModel].pinned;
+                if (ImGui::Checkbox("Pin Current Model", &pinModel)) pin_cached_model(modelCache, currentModel, pinModel);
+            }
+            if (ImGui::Checkbox("Static Batching", &batchStatic)) reloadModels = true;
+            if (ImGui::Checkbox("Bake Vertex Occlusion", &bakeOcclusion)) reloadModels = true;
+            ImGui::Checkbox("Morph Pre-blending", &graphics.morphPreblend);
+            ImGui::Checkbox("Progressive Loading", &progressiveLoading);
+            if (progressiveLoad.phase == MV_LOAD_PHASE_GEOMETRY)
+                ImGui::Text("Loading geometry: %u / %u", progressiveLoad.loadedGeometry, progressiveLoad.primitiveCount);
+            else if (progressiveLoad.phase == MV_LOAD_PHASE_MATERIALS)
+                ImGui::Text("Loading materials: %u / %u", progressiveLoad.loadedMaterials, progressiveLoad.primitiveCount);
+            ImGui::Text("CPU: %.1f MB, GPU: %.1f MB", modelCache.cpuBytes / (1024.0f * 1024.0f), modelCache.gpuBytes / (1024.0f * 1024.0f));
+            ImGui::Text("Hits: %u, Misses: %u, Evictions: %u", modelCache.hits, modelCache.misses, modelCache.evictions);
+            ImGui::Text("Shared primitives: %u", model.sharedPrimitives);
+
+            ImGui::Dummy(ImVec2(50.0f, 25.0f));
+            ImGui::Text("%s", "Shader Cache");
+            ImGui::Text("Compiled: %u, Disk: %u, Memory: %u", graphics.shaderCache.compiles, graphics.shaderCache.diskHits, graphics.shaderCache.memoryHits);
+            ImGui::Text("Archived: %u", graphics.shaderCache.archived);
+            ImGui::Text("Pipelines pending: %u, Completed: %u, Failed: %u", graphics.pipelineCompiler->pending.load(), graphics.pipelineCompiler->completed.load(), graphics.pipelineCompiler->failed.load());
+
+            ImGui::Dummy(ImVec2(50.0f, 25.0f));
+            ImGui::Text("%s", "State Cache");
+            ImGui::Text("Hits: %u, Misses: %u, Collisions: %u", graphics.stateCache.hits, graphics.stateCache.misses, graphics.stateCache.collisions);
+            ImGui::Text("Vertex shaders: %zu, Pixel shaders: %zu", graphics.stateCache.vertexShaders.size(), graphics.stateCache.pixelShaders.size());
+            ImGui::Text("Binds skipped: %u", graphics.stateCache.bindsSkipped);
+            graphics.stateCache.bindsSkipped = 0u;
+
             ImGui::Dummy(ImVec2(50.0f, 25.0f));
             ImGui::Text("%s", "Extensions");
-            if (ImGui::Checkbox("KHR_materials_clearcoat", (bool*)&graphics.clearcoat)) reloadMaterials = true;
+            if (ImGui::Checkbox("KHR_materials_clearcoat", (bool*)&graphics.clearcoat) && !(graphics.lightingBranches & MV_LIGHTING_CLEARCOAT)) reloadMaterials = true;
 
             ImGui::Unindent(14.0f);
             ImGui::EndTable();
@@ -446,6 +555,8 @@ int main()
     }
 
     offscreen.cleanup();
+    stop_pipeline_compiler(graphics);
+    stop_morph_blender(graphics);
 
     // Cleanup
     renderCtx.finalBlendState->Release();
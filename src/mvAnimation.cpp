@@ -2,6 +2,9 @@
 #include "mvAssetLoader.h"
 #include "sMath.h"
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 static sVec4
 slerpQuat(sVec4 q1, sVec4 q2, float t)
@@ -320,7 +323,7 @@ compute_joints(mvGraphics& graphics, mvModel& model, sMat4 transform, mvSkin& sk
 
     for (unsigned int i = 0; i < skin.jointCount; i++)
     {
-        int joint = skin.joints[i];
+        int joint = model.nodeIndices[skin.jointOffset + i];
         mvNode& node = model.nodes[joint];
         sMat4 ibm = (*(sMat4*)&skin.inverseBindMatrices[i * 16]);
         sMat4 jointMatrix = transform * node.worldTransform * ibm;
@@ -332,4 +335,195 @@ compute_joints(mvGraphics& graphics, mvModel& model, sMat4 transform, mvSkin& sk
     }
 
     update_dynamic_texture(graphics, skin.jointTexture, textureWidth, textureWidth, skin.textureData.data());
-}
\ No newline at end of file
+}
+
+static void
+blend_morph_chunk(const mvMorphBlendChunk& chunk)
+{
+    mvMeshPrimitive& primitive = *chunk.primitive;
+    const std::vector<float>& targets = chunk.mesh->morphTargets;
+    unsigned int stride = primitive.layout.size / sizeof(float);
+    unsigned int layerSize = primitive.morphWidth * primitive.morphWidth * 4u;
+    unsigned int activeCount = (unsigned int)targets[0];
+
+    unsigned int begin = chunk.firstVertex * stride;
+    unsigned int end = (chunk.firstVertex + chunk.vertexCount) * stride;
+    std::copy(primitive.morphBase.begin() + begin, primitive.morphBase.begin() + end, primitive.morphBlended.begin() + begin);
+
+    for (unsigned int i = 0; i < activeCount; i++)
+    {
+        float weight = targets[4 + i * 4];
+        unsigned int target = (unsigned int)targets[4 + i * 4 + 1];
+        for (const mvMorphAttribute& attribute : primitive.morphAttributes)
+        {
+            const float* displacement = &primitive.morphData[(attribute.layerOffset + target) * layerSize];
+            for (unsigned int v = chunk.firstVertex; v < chunk.firstVertex + chunk.vertexCount; v++)
+            {
+                float* vertex = &primitive.morphBlended[v * stride + attribute.vertexOffset];
+                for (unsigned int c = 0; c < attribute.componentCount; c++)
+                    vertex[c] += weight * displacement[v * 4 + c];
+            }
+        }
+    }
+}
+
+static void
+blend_morph_chunks(mvMorphBlender* blender, const std::vector<mvMorphBlendChunk>& chunks)
+{
+    for (unsigned int i = blender->nextChunk++; i < chunks.size(); i = blender->nextChunk++)
+        blend_morph_chunk(chunks[i]);
+}
+
+static void
+run_morph_blender(mvMorphBlender* blender)
+{
+    unsigned int generation = 0u;
+    while (true)
+    {
+        const std::vector<mvMorphBlendChunk>* chunks = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(blender->mutex);
+            blender->wake.wait(lock, [blender, generation] { return blender->stopping || blender->generation != generation; });
+            if (blender->stopping)
+                return;
+            generation = blender->generation;
+            chunks = blender->chunks;
+            if (chunks == nullptr) // woke after the batch was already finished
+                continue;
+            blender->active++;
+        }
+
+        blend_morph_chunks(blender, *chunks);
+
+        std::lock_guard<std::mutex> lock(blender->mutex);
+        if (--blender->active == 0u)
+            blender->done.notify_all();
+    }
+}
+
+void
+start_morph_blender(mvGraphics& graphics, unsigned int threadCount)
+{
+    assert(graphics.morphBlender == nullptr);
+    mvMorphBlender* blender = new mvMorphBlender();
+
+    // the render thread blends too
+    if (threadCount == 0u)
+        threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1u;
+    for (unsigned int i = 0; i < threadCount; i++)
+        blender->workers.emplace_back(run_morph_blender, blender);
+
+    graphics.morphBlender = blender;
+}
+
+void
+stop_morph_blender(mvGraphics& graphics)
+{
+    mvMorphBlender* blender = graphics.morphBlender;
+    if (blender == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(blender->mutex);
+        blender->stopping = true;
+    }
+    blender->wake.notify_all();
+    for (auto& worker : blender->workers)
+        worker.join();
+
+    delete blender;
+    graphics.morphBlender = nullptr;
+}
+
+void
+update_morph_targets(mvGraphics& graphics, mvModel& model)
+{
+    std::vector<mvMorphBlendChunk> chunks;
+    unsigned int blendedVertices = 0u;
+
+    for (unsigned int i = 0; i < model.meshes.size(); i++)
+    {
+        mvMesh& mesh = model.meshes[i];
+        if (!mesh.morphBuffer.buffer)
+            continue;
+        if (mesh.weightsApplied == mesh.weightsAnimated && mesh.morphPreblended == graphics.morphPreblend)
+            continue;
+
+        bool wasPreblended = mesh.morphPreblended;
+        mesh.weightsApplied = mesh.weightsAnimated;
+        mesh.morphPreblended = graphics.morphPreblend;
+
+        // header (active count) then one float4 per active target, zero weights are skipped
+        mesh.morphTargets.assign(4u + mesh.weightCount * 4u, 0.0f);
+        unsigned int activeCount = 0u;
+        for (unsigned int j = 0; j < mesh.weightCount; j++)
+        {
+            if (mesh.weightsAnimated[j * 4] == 0.0f)
+                continue;
+            mesh.morphTargets[4 + activeCount * 4] = mesh.weightsAnimated[j * 4];
+            mesh.morphTargets[4 + activeCount * 4 + 1] = (float)j;
+            activeCount++;
+        }
+        mesh.morphTargets[0] = (float)activeCount;
+
+        for (unsigned int j = 0; j < mesh.primitives.size(); j++)
+        {
+            mvMeshPrimitive& primitive = mesh.primitives[j];
+            if (primitive.morphBase.empty() || primitive.geometryID == -1)
+                continue;
+
+            if (!mesh.morphPreblended)
+            {
+                // back to the shader, which displaces the undeformed vertices
+                if (wasPreblended)
+                    update_geometry(graphics, primitive.geometryID, primitive.morphBase.data());
+                continue;
+            }
+
+            primitive.morphBlended.resize(primitive.morphBase.size());
+            unsigned int vertexCount = (unsigned int)(primitive.morphBase.size() * sizeof(float) / primitive.layout.size);
+            for (unsigned int first = 0u; first < vertexCount; first += 4096u)
+                chunks.push_back({ &primitive, &mesh, first, std::min(4096u, vertexCount - first) });
+            blendedVertices += vertexCount;
+        }
+
+        // pre-blended vertices already carry the displacement, the shader gets no targets
+        if (mesh.morphPreblended)
+            mesh.morphTargets[0] = 0.0f;
+        update_const_buffer(graphics, mesh.morphBuffer, mesh.morphTargets.data());
+        mesh.morphTargets[0] = (float)activeCount;
+    }
+
+    if (chunks.empty())
+        return;
+
+    // small rigs aren't worth waking the workers for
+    mvMorphBlender* blender = graphics.morphBlender;
+    if (blender == nullptr || blender->workers.empty() || blendedVertices < 16384u || chunks.size() == 1u)
+    {
+        for (const mvMorphBlendChunk& chunk : chunks)
+            blend_morph_chunk(chunk);
+    }
+    else
+    {
+        {
+            std::lock_guard<std::mutex> lock(blender->mutex);
+            blender->chunks = &chunks;
+            blender->nextChunk = 0u;
+            blender->generation++;
+        }
+        blender->wake.notify_all();
+        blend_morph_chunks(blender, chunks);
+
+        // workers that woke late find nothing left, the chunks must outlive all of them
+        std::unique_lock<std::mutex> lock(blender->mutex);
+        blender->done.wait(lock, [blender] { return blender->active == 0u; });
+        blender->chunks = nullptr;
+    }
+
+    for (unsigned int i = 0; i < chunks.size(); i++)
+    {
+        if (chunks[i].firstVertex == 0u)
+            update_geometry(graphics, chunks[i].primitive->geometryID, chunks[i].primitive->morphBlended.data());
+    }
+}
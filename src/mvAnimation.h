@@ -2,6 +2,10 @@
 
 #include <vector>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "mvGraphics.h"
 
 // forward declarations
@@ -9,14 +13,19 @@ struct mvAnimationChannel;
 struct mvAnimation;
 struct mvSkin;
 struct mvModel;
+struct mvMorphBlendChunk;
+struct mvMorphBlender;
 
-void advance_animations(mvModel& model, mvAnimation& animation, float tcurrent);
-void compute_joints    (mvGraphics& graphics, mvModel& model, sMat4 transform, mvSkin& skin);
+void advance_animations  (mvModel& model, mvAnimation& animation, float tcurrent);
+void compute_joints      (mvGraphics& graphics, mvModel& model, sMat4 transform, mvSkin& skin);
+void update_morph_targets(mvGraphics& graphics, mvModel& model); // meshes whose weights changed only
+void start_morph_blender (mvGraphics& graphics, unsigned int threadCount = 0u); // 0 for hardware_concurrency - 1, without it pre-blending runs on the caller
+void stop_morph_blender  (mvGraphics& graphics);
 
 struct mvSkin
 {
     unsigned int       skeleton = 0u;
-    mvAssetID          joints[256];
+    unsigned int       jointOffset = 0u; // into mvModel::nodeIndices
     unsigned int       jointCount = 0u;
     mvTexture          jointTexture;
     std::vector<float> inverseBindMatrices;
@@ -39,4 +48,26 @@ struct mvAnimation
     mvAnimationChannel* channels = nullptr;
     unsigned int        channelCount = 0u;
     float               tmax = 0.0f;
-};
\ No newline at end of file
+};
+
+struct mvMorphBlendChunk
+{
+    mvMeshPrimitive* primitive = nullptr;
+    mvMesh*          mesh = nullptr;
+    unsigned int     firstVertex = 0u;
+    unsigned int     vertexCount = 0u;
+};
+
+// workers live as long as the viewer, update_morph_targets hands them each frame's chunks
+struct mvMorphBlender
+{
+    std::vector<std::thread>              workers;
+    std::mutex                            mutex;
+    std::condition_variable               wake;
+    std::condition_variable               done;
+    const std::vector<mvMorphBlendChunk>* chunks = nullptr;
+    std::atomic<unsigned int>             nextChunk = 0u;
+    unsigned int                          generation = 0u; // bumped per batch of chunks
+    unsigned int                          active = 0u;     // workers still inside a batch
+    bool                                  stopping = false;
+};
@@ -1,10 +1,16 @@
 #include "mvAssetLoader.h"
 #include <unordered_map>
+#include <algorithm>
 #include <assert.h>
+#include <chrono>
 #include "sGltf.h"
 #include "mvGraphics.h"
 #include "mvAnimation.h"
 #include "mvCamera.h"
+#include "mvHash.h"
+#include "mvJson.h"
+#include "mvOcclusionBake.h"
+#include "mvPipelineCompiler.h"
 
 static unsigned char
 mvGetAccessorItemCompCount(sGLTFAccessor& accessor)
@@ -67,6 +73,7 @@ mvFillBufferAsType(sGLTFModel& model, sGLTFAccessor& accessor, std::vector<W>& o
     if (componentCap < accessorItemCompCount)
         accessorItemCompCount = componentCap;
 
+    outBuffer.reserve(outBuffer.size() + accessor.count * accessorItemCompCount);
     for (int i = 0; i < accessor.count; i++)
     {
         T* values = (T*)&bufferRawSection[i * bufferviewStride];
@@ -175,10 +182,13 @@ setup_texture(mvGraphics& graphics, sGLTFModel& model, unsigned int currentPrimi
     mvTexture result{};
     if (model.images[texture.image_index].embedded)
     {
-        result = create_texture(graphics, model.images[texture.image_index].data, model.images[texture.image_index].dataCount);
+        // embedded images are shared by content
+        sGLTFImage& image = model.images[texture.image_index];
+        std::string key = "embedded:" + std::to_string(hash_bytes(image.data, image.dataCount));
+        result = create_streamed_texture(graphics, key, image.data, image.dataCount);
     }
     else
-        result = create_texture(graphics, model.root + uri);
+        result = create_streamed_texture(graphics, model.root + uri);
     flag = true;
     if (texture.sampler_index > -1)
     {
@@ -195,8 +205,7 @@ setup_texture(mvGraphics& graphics, sGLTFModel& model, unsigned int currentPrimi
         samplerDesc.MinLOD = -FLT_MAX;
         samplerDesc.MaxLOD = FLT_MAX;
 
-        HRESULT hResult = graphics.device->CreateSamplerState(&samplerDesc, result.sampler.GetAddressOf());
-        assert(SUCCEEDED(hResult));
+        result.sampler = get_sampler_state(graphics, samplerDesc);
     }
 
     return result;
@@ -212,11 +221,9 @@ load_gltf_skins(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model)
         mvSkin skin{};
 
         skin.skeleton = glskin.skeleton;
+        skin.jointOffset = (unsigned int)mvmodel.nodeIndices.size();
         skin.jointCount = glskin.joints_count;
-        for (unsigned int joint = 0; joint < skin.jointCount; joint++)
-        {
-            skin.joints[joint] = glskin.joints[joint];
-        }
+        mvmodel.nodeIndices.insert(mvmodel.nodeIndices.end(), glskin.joints, glskin.joints + glskin.joints_count);
 
         mvFillBuffer(model, model.accessors[glskin.inverseBindMatrices], skin.inverseBindMatrices, 16);
 
@@ -225,7 +232,7 @@ load_gltf_skins(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model)
         skin.jointTexture = create_dynamic_texture(graphics, textureWidth, textureWidth);
         skin.textureData.resize(textureWidth * textureWidth * 4);
 
-        mvmodel.skins.push_back(skin);
+        mvmodel.skins.push_back(std::move(skin));
     }
 
 }
@@ -364,15 +371,16 @@ load_raw_attribute_buffers(sGLTFModel& model, sGLTFMeshPrimitive& glprimitive, R
 }
 
 static void
-combine_vertex_buffer(unsigned int triangleCount, mvVertexLayout& modifiedLayout, sGLTFMeshPrimitive& glprimitive, std::vector<unsigned int> origIndexBuffer, RawAttributeBuffers& rawBuffers, std::vector<unsigned int>& indexBuffer, std::vector<float>& combinedVertexBuffer)
+combine_vertex_buffer(unsigned int triangleCount, mvVertexLayout& modifiedLayout, sGLTFMeshPrimitive& glprimitive, const std::vector<unsigned int>& origIndexBuffer, RawAttributeBuffers& rawBuffers, std::vector<unsigned int>& indexBuffer, std::vector<float>& combinedVertexBuffer)
 {
+    combinedVertexBuffer.reserve((triangleCount / 3) * modifiedLayout.elementCount);
     for (size_t i = 0; i < triangleCount / 3; i++)
     {
         size_t i0 = glprimitive.indices_index == -1 ? i : origIndexBuffer[i];
 
         for (size_t j = 0; j < modifiedLayout.semantics.size(); j++)
         {
-            std::string semantic = modifiedLayout.semantics[j];
+            const std::string& semantic = modifiedLayout.semantics[j];
 
             if (strcmp(semantic.c_str(), "Position") == 0)
             {
@@ -585,7 +593,7 @@ finalize_vertex_buffers(RawAttributeBuffers& rawBuffers, mvVertexLayout& modifie
         unsigned int currentLocation = 0u;
         for (size_t j = 0; j < modifiedLayout.semantics.size(); j++)
         {
-            std::string semantic = modifiedLayout.semantics[j];
+            const std::string& semantic = modifiedLayout.semantics[j];
 
             if (strcmp(semantic.c_str(), "Position") == 0)
             {
@@ -797,7 +805,7 @@ finalize_vertex_buffers(RawAttributeBuffers& rawBuffers, mvVertexLayout& modifie
         {
             for (size_t j = 0; j < modifiedLayout.semantics.size(); j++)
             {
-                std::string semantic = modifiedLayout.semantics[j];
+                const std::string& semantic = modifiedLayout.semantics[j];
 
                 if (strcmp(semantic.c_str(), "Position") == 0)
                 {
@@ -988,308 +996,563 @@ gather_target_attributes(sGLTFModel& model, sGLTFMeshPrimitive& glprimitive)
 }
 
 static void
-load_gltf_meshes(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model, float* minBoundary, float* maxBoundary)
+release_material_textures(mvGraphics& graphics, mvMaterial& material)
 {
+    release_streamed_texture(graphics.textureStreamer, material.albedoTexture.streamID);
+    release_streamed_texture(graphics.textureStreamer, material.normalTexture.streamID);
+    release_streamed_texture(graphics.textureStreamer, material.metalRoughnessTexture.streamID);
+    release_streamed_texture(graphics.textureStreamer, material.emissiveTexture.streamID);
+    release_streamed_texture(graphics.textureStreamer, material.occlusionTexture.streamID);
+    release_streamed_texture(graphics.textureStreamer, material.clearcoatTexture.streamID);
+    release_streamed_texture(graphics.textureStreamer, material.clearcoatRoughnessTexture.streamID);
+    release_streamed_texture(graphics.textureStreamer, material.clearcoatNormalTexture.streamID);
+}
 
-    for (unsigned int currentMesh = 0u; currentMesh < model.mesh_count; currentMesh++)
+void
+cook_gltf_material(sGLTFModel& model, int materialIndex, mvMaterial& materialData)
+{
+    if (materialIndex == -1)
     {
-        sGLTFMesh& glmesh = model.meshes[currentMesh];
+        materialData.data.albedo = { 0.45f, 0.45f, 0.85f, 1.0f };
+        materialData.data.metalness = 0.0f;
+        materialData.data.roughness = 0.5f;
+        materialData.data.alphaCutoff = 0.5f;
+        materialData.data.doubleSided = false;
+        return;
+    }
+
+    sGLTFMaterial& material = model.materials[materialIndex];
+
+    materialData.data.albedo = *(sVec4*)material.base_color_factor;
+    materialData.data.metalness = material.metallic_factor;
+    materialData.data.roughness = material.roughness_factor;
+    materialData.data.emisiveFactor = *(sVec3*)material.emissive_factor;
+    materialData.data.occlusionStrength = material.occlusion_texture_strength;
+    materialData.data.alphaCutoff = 0.5f;
+    materialData.data.doubleSided = material.double_sided;
+    materialData.data.clearcoatFactor = material.clearcoat_factor;
+    materialData.data.clearcoatRoughnessFactor = material.clearcoat_roughness_factor;
+    materialData.data.clearcoatNormalScale = material.clearcoat_normal_texture_scale;
+    materialData.extensionClearcoat = material.clearcoat_extension;
+    materialData.pbrMetallicRoughness = material.pbrMetallicRoughness;
+    materialData.alphaMode = material.alphaMode;
+    if (materialData.alphaMode == 1)
+        materialData.data.alphaCutoff = material.alphaCutoff;
+
+    // setup_texture sets these too, the tools never create the textures
+    materialData.hasAlbedoMap = material.base_color_texture != -1;
+    materialData.hasNormalMap = material.normal_texture != -1;
+    materialData.hasMetallicRoughnessMap = material.metallic_roughness_texture != -1;
+    materialData.hasEmmissiveMap = material.emissive_texture != -1;
+    materialData.hasOcculusionMap = material.occlusion_texture != -1;
+    materialData.hasClearcoatMap = material.clearcoat_texture != -1;
+    materialData.hasClearcoatRoughnessMap = material.clearcoat_roughness_texture != -1;
+    materialData.hasClearcoatNormalMap = material.clearcoat_normal_texture != -1;
+}
+
+static mvAssetID
+load_gltf_material(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model, int materialIndex, mvMaterial materialData, unsigned int currentPrimitive, std::string& meshName, bool instanced)
+{
+    cook_gltf_material(model, materialIndex, materialData);
+    if (materialIndex != -1)
+    {
+        sGLTFMaterial& material = model.materials[materialIndex];
+        materialData.albedoTexture = setup_texture(graphics, model, currentPrimitive, material.base_color_texture, materialData.hasAlbedoMap, meshName, "_a");
+        materialData.normalTexture = setup_texture(graphics, model, currentPrimitive, material.normal_texture, materialData.hasNormalMap, meshName, "_n");
+        materialData.metalRoughnessTexture = setup_texture(graphics, model, currentPrimitive, material.metallic_roughness_texture, materialData.hasMetallicRoughnessMap, meshName, "_m");
+        materialData.emissiveTexture = setup_texture(graphics, model, currentPrimitive, material.emissive_texture, materialData.hasEmmissiveMap, meshName, "_e");
+        materialData.occlusionTexture = setup_texture(graphics, model, currentPrimitive, material.occlusion_texture, materialData.hasOcculusionMap, meshName, "_o");
+        materialData.clearcoatTexture = setup_texture(graphics, model, currentPrimitive, material.clearcoat_texture, materialData.hasClearcoatMap, meshName, "_cc");
+        materialData.clearcoatRoughnessTexture = setup_texture(graphics, model, currentPrimitive, material.clearcoat_roughness_texture, materialData.hasClearcoatRoughnessMap, meshName, "_ccr");
+        materialData.clearcoatNormalTexture = setup_texture(graphics, model, currentPrimitive, material.clearcoat_normal_texture, materialData.hasClearcoatNormalMap, meshName, "_ccn");
+    }
+
+    uint64_t pipelineKey = hash_material(materialData, materialData.layout, "PBR_PS.hlsl", "PBR_VS.hlsl");
+    pipelineKey = hash_bytes(&instanced, sizeof(instanced), pipelineKey);
 
-        mvMesh newMesh{};
-        newMesh.name = glmesh.name;
-        bool useMorphing = false;
-        newMesh.weightCount = glmesh.weights_count;
-        for (unsigned int currentWeight = 0; currentWeight < glmesh.weights_count; currentWeight++)
+    // textures and factors belong to the material
+    uint64_t key = hash_material_data(materialData, hash_material_textures(materialData, pipelineKey));
+    mvMaterialManager& manager = mvmodel.materialManager;
+    mvAssetID materialID = mvGetMaterialAssetID(&manager, key);
+    if (materialID != -1)
+    {
+        mvMaterial& existing = manager.materials[materialID].asset;
+        if (same_material_pipeline(existing, materialData) && same_material_textures(existing, materialData) && same_material_data(existing, materialData))
         {
-            newMesh.weights.push_back(glmesh.weights[currentWeight]);
-            newMesh.weights.push_back(0.0f);
-            newMesh.weights.push_back(0.0f);
-            newMesh.weights.push_back(0.0f);
-            newMesh.weightsAnimated.push_back(glmesh.weights[currentWeight]);
-            newMesh.weightsAnimated.push_back(0.0f);
-            newMesh.weightsAnimated.push_back(0.0f);
-            newMesh.weightsAnimated.push_back(0.0f);
+            release_material_textures(graphics, materialData);
+            return materialID;
         }
+        manager.collisions++;
+    }
 
-        if (!newMesh.weights.empty())
+    // same shaders with other textures, share the pipeline
+    mvAssetID pipelineID = mvGetMaterialPipelineID(&manager, pipelineKey);
+    if (pipelineID != -1)
+    {
+        mvMaterial& existing = manager.materials[pipelineID].asset;
+        if (same_material_pipeline(existing, materialData))
         {
-            useMorphing = true;
-
-            // create transform constant buffer
-            D3D11_BUFFER_DESC cbd;
-            cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-            cbd.Usage = D3D11_USAGE_DYNAMIC;
-            cbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-            cbd.MiscFlags = 0u;
-            cbd.ByteWidth = sizeof(float)*newMesh.weights.size();
-            cbd.StructureByteStride = 0u;
-
-            newMesh.morphBuffer.size = cbd.ByteWidth;
-            graphics.device->CreateBuffer(&cbd, nullptr, &newMesh.morphBuffer.buffer);
-            update_const_buffer(graphics, newMesh.morphBuffer, newMesh.weights.data());
+            materialData.pipeline = existing.pipeline;
+            materialData.pendingPipeline = existing.pendingPipeline;
+            materialData.bindings = existing.bindings;
+            retain_pipeline(graphics, existing.pendingPipeline);
+            return register_asset(&manager, key, pipelineKey, std::move(materialData));
         }
+        manager.collisions++;
+    }
 
-        for (unsigned int currentPrimitive = 0u; currentPrimitive < glmesh.primitives_count; currentPrimitive++)
-        {
+    return register_asset(&manager, key, pipelineKey, create_material(graphics, "PBR_VS.hlsl", "PBR_PS.hlsl", std::move(materialData)));
+}
 
-            sGLTFMeshPrimitive& glprimitive = glmesh.primitives[currentPrimitive];
+static mvMesh
+create_gltf_mesh(mvGraphics& graphics, sGLTFMesh& glmesh)
+{
+    mvMesh newMesh{};
+    newMesh.name = glmesh.name;
+    newMesh.weightCount = glmesh.weights_count;
+    for (unsigned int currentWeight = 0; currentWeight < glmesh.weights_count; currentWeight++)
+    {
+        newMesh.weights.push_back(glmesh.weights[currentWeight]);
+        newMesh.weights.push_back(0.0f);
+        newMesh.weights.push_back(0.0f);
+        newMesh.weights.push_back(0.0f);
+        newMesh.weightsAnimated.push_back(glmesh.weights[currentWeight]);
+        newMesh.weightsAnimated.push_back(0.0f);
+        newMesh.weightsAnimated.push_back(0.0f);
+        newMesh.weightsAnimated.push_back(0.0f);
+    }
 
-            std::vector<unsigned int> origIndexBuffer;
-            if (glprimitive.indices_index > -1)
-            {
-                unsigned char indexCompCount = mvGetAccessorItemCompCount(model.accessors[glprimitive.indices_index]);
+    if (!newMesh.weights.empty())
+    {
+        // active target list, filled by update_morph_targets before the first draw
+        D3D11_BUFFER_DESC cbd;
+        cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        cbd.Usage = D3D11_USAGE_DYNAMIC;
+        cbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        cbd.MiscFlags = 0u;
+        cbd.ByteWidth = sizeof(float) * (4u + newMesh.weights.size());
+        cbd.StructureByteStride = 0u;
+
+        newMesh.morphBuffer.size = cbd.ByteWidth;
+        if (graphics.device)
+            graphics.device->CreateBuffer(&cbd, nullptr, &newMesh.morphBuffer.buffer);
+    }
 
-                sGLTFComponentType indexCompType = model.accessors[glprimitive.indices_index].component_type;
-                mvFillBuffer(model, model.accessors[glprimitive.indices_index], origIndexBuffer);
-            }
+    return newMesh;
+}
+
+void
+cook_gltf_primitive(sGLTFModel& model, sGLTFMesh& glmesh, unsigned int currentPrimitive, bool instanced, mvCookedPrimitive& cooked)
+{
+    sGLTFMeshPrimitive& glprimitive = glmesh.primitives[currentPrimitive];
+
+    std::vector<unsigned int> origIndexBuffer;
+    if (glprimitive.indices_index > -1)
+    {
+        unsigned char indexCompCount = mvGetAccessorItemCompCount(model.accessors[glprimitive.indices_index]);
 
-            RawAttributeBuffers rawBuffers{};
-            std::vector<mvVertexElement> attributes = load_raw_attribute_buffers(model, glprimitive, rawBuffers, minBoundary, maxBoundary);
+        sGLTFComponentType indexCompType = model.accessors[glprimitive.indices_index].component_type;
+        mvFillBuffer(model, model.accessors[glprimitive.indices_index], origIndexBuffer);
+        cooked.sourceIndexSize = indexCompType == S_GLTF_UNSIGNED_BYTE ? 1 : indexCompType == S_GLTF_UNSIGNED_SHORT ? 2 : 4;
+    }
 
-            std::vector<unsigned int> indexBuffer;
-            std::vector<float> vertexBuffer;
+    RawAttributeBuffers rawBuffers{};
+    float primitiveMax[3] = { -FLT_MAX , -FLT_MAX , -FLT_MAX };
+    float primitiveMin[3] = { FLT_MAX , FLT_MAX , FLT_MAX };
+    std::vector<mvVertexElement> attributes = load_raw_attribute_buffers(model, glprimitive, rawBuffers, primitiveMin, primitiveMax);
+    cooked.sourceVertexCount = rawBuffers.positionAttributeBuffer.size() / 3;
 
-            unsigned int triangleCount = origIndexBuffer.size() * 3;
+    std::vector<unsigned int> indexBuffer;
+    std::vector<float> vertexBuffer;
 
-            if (glprimitive.indices_index == -1)
-                triangleCount = rawBuffers.positionAttributeBuffer.size();
+    unsigned int triangleCount = origIndexBuffer.size() * 3;
 
-            if (rawBuffers.normalAttributeBuffer.empty())
-            {
-                attributes.push_back(Normal);
-            }
-            if (rawBuffers.tangentAttributeBuffer.empty())
-            {
-                attributes.push_back(Tangent);
-            }
+    if (glprimitive.indices_index == -1)
+        triangleCount = rawBuffers.positionAttributeBuffer.size();
 
-            mvVertexLayout modifiedLayout = create_vertex_layout(attributes);
+    if (rawBuffers.normalAttributeBuffer.empty())
+    {
+        attributes.push_back(Normal);
+    }
+    if (rawBuffers.tangentAttributeBuffer.empty())
+    {
+        attributes.push_back(Tangent);
+    }
+
+    mvVertexLayout modifiedLayout = create_vertex_layout(attributes);
+
+    // triangleCount is 3x the emitted vertex count
+    vertexBuffer.reserve(triangleCount / 3 * modifiedLayout.elementCount);
+    indexBuffer.reserve(triangleCount / 3);
+
+    std::vector<float> combinedVertexBuffer;
 
-            vertexBuffer.reserve(triangleCount * modifiedLayout.size * 3);
-            indexBuffer.reserve(triangleCount * 3);
+    combine_vertex_buffer(triangleCount, modifiedLayout, glprimitive, origIndexBuffer, rawBuffers, indexBuffer, combinedVertexBuffer);
+    finalize_vertex_buffers(rawBuffers, modifiedLayout, combinedVertexBuffer, indexBuffer, vertexBuffer);
+    mvMaterial materialData{};
 
-            std::vector<float> combinedVertexBuffer;
+    std::vector<mvVertexElement> targetAttributes = gather_target_attributes(model, glprimitive);
 
-            combine_vertex_buffer(triangleCount, modifiedLayout, glprimitive, origIndexBuffer, rawBuffers, indexBuffer, combinedVertexBuffer);
-            finalize_vertex_buffers(rawBuffers, modifiedLayout, combinedVertexBuffer, indexBuffer, vertexBuffer);
-            mvMaterial materialData{};
-            newMesh.primitives.push_back({});
+    if (!targetAttributes.empty())
+    {
+        
+        materialData.extramacros.push_back({ "HAS_MORPH_TARGETS", "1" });
+        const auto max2DTextureSize = pow(D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION, 2);
+        const auto maxTextureArraySize = D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION;
 
-            std::vector<mvVertexElement> targetAttributes = gather_target_attributes(model, glprimitive);
+        std::unordered_map<mvVertexElement, int> attributeOffsets;
+        int attributeOffset = 0;
 
-            if (!targetAttributes.empty())
+        for (int i = 0; i < targetAttributes.size(); i++)
+        {
+            switch (targetAttributes[i])
+            {
+            case Position3D:
+                materialData.extramacros.push_back({ "HAS_MORPH_TARGET_POSITION", "1" });
+                materialData.extramacros.push_back({ "MORPH_TARGET_POSITION_OFFSET", std::to_string(attributeOffset) });
+                break;
+            case Normal:
+                materialData.extramacros.push_back({ "HAS_MORPH_TARGET_NORMAL", "1" });
+                materialData.extramacros.push_back({ "MORPH_TARGET_NORMAL_OFFSET", std::to_string(attributeOffset) });
+                break;
+            case Tangent:
+                materialData.extramacros.push_back({ "HAS_MORPH_TARGET_TANGENT", "1" });
+                materialData.extramacros.push_back({ "MORPH_TARGET_TANGENT_OFFSET", std::to_string(attributeOffset) });
+                break;
+            case TexCoord0:
+                materialData.extramacros.push_back({ "HAS_MORPH_TARGET_TEXCOORD_0", "1" });
+                materialData.extramacros.push_back({ "MORPH_TARGET_TEXCOORD_0_OFFSET", std::to_string(attributeOffset) });
+                break;
+            case TexCoord1:
+                materialData.extramacros.push_back({ "HAS_MORPH_TARGET_TEXCOORD_1", "1" });
+                materialData.extramacros.push_back({ "MORPH_TARGET_TEXCOORD_1_OFFSET", std::to_string(attributeOffset) });
+                break;
+            }
+            
+            // where CPU pre-blending finds the attribute in the vertex
+            auto element = std::find(attributes.begin(), attributes.end(), targetAttributes[i]);
+            if (element != attributes.end())
             {
-                
-                materialData.extramacros.push_back({ "HAS_MORPH_TARGETS", "1" });
-                const auto max2DTextureSize = pow(D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION, 2);
-                const auto maxTextureArraySize = D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION;
+                mvMorphAttribute morphAttribute{};
+                morphAttribute.vertexOffset = modifiedLayout.offsets[element - attributes.begin()] / sizeof(float);
+                morphAttribute.componentCount = targetAttributes[i] == TexCoord0 || targetAttributes[i] == TexCoord1 ? 2u : 3u;
+                morphAttribute.layerOffset = attributeOffset;
+                cooked.morphAttributes.push_back(morphAttribute);
+            }
 
-                std::unordered_map<mvVertexElement, int> attributeOffsets;
-                int attributeOffset = 0;
+            attributeOffsets[targetAttributes[i]] = attributeOffset;
+            attributeOffset += glprimitive.target_count;
+        }
 
-                for (int i = 0; i < targetAttributes.size(); i++)
-                {
-                    switch (targetAttributes[i])
-                    {
-                    case Position3D:
-                        materialData.extramacros.push_back({ "HAS_MORPH_TARGET_POSITION", "1" });
-                        materialData.extramacros.push_back({ "MORPH_TARGET_POSITION_OFFSET", std::to_string(attributeOffset) });
-                        break;
-                    case Normal:
-                        materialData.extramacros.push_back({ "HAS_MORPH_TARGET_NORMAL", "1" });
-                        materialData.extramacros.push_back({ "MORPH_TARGET_NORMAL_OFFSET", std::to_string(attributeOffset) });
-                        break;
-                    case Tangent:
-                        materialData.extramacros.push_back({ "HAS_MORPH_TARGET_TANGENT", "1" });
-                        materialData.extramacros.push_back({ "MORPH_TARGET_TANGENT_OFFSET", std::to_string(attributeOffset) });
-                        break;
-                    case TexCoord0:
-                        materialData.extramacros.push_back({ "HAS_MORPH_TARGET_TEXCOORD_0", "1" });
-                        materialData.extramacros.push_back({ "MORPH_TARGET_TEXCOORD_0_OFFSET", std::to_string(attributeOffset) });
-                        break;
-                    case TexCoord1:
-                        materialData.extramacros.push_back({ "HAS_MORPH_TARGET_TEXCOORD_1", "1" });
-                        materialData.extramacros.push_back({ "MORPH_TARGET_TEXCOORD_1_OFFSET", std::to_string(attributeOffset) });
-                        break;
-                    }
-                    
-                    attributeOffsets[targetAttributes[i]] = attributeOffset;
-                    attributeOffset += glprimitive.target_count;
-                }
+        int vertexCount = triangleCount * 3;
+        float textureWidth = ceil(sqrt(vertexCount));
+        float singleTextureSize = pow(textureWidth, 2) * 4;
+        cooked.morphWidth = textureWidth;
+        cooked.morphLayers = glprimitive.target_count * targetAttributes.size();
+        cooked.morphData = new float[singleTextureSize * cooked.morphLayers];
+        memset(cooked.morphData, 0, sizeof(float) * singleTextureSize * cooked.morphLayers);
 
-                int vertexCount = triangleCount * 3;
-                float textureWidth = ceil(sqrt(vertexCount));
-                float singleTextureSize = pow(textureWidth, 2) * 4;
-                newMesh.primitives.back().morphData = new float[singleTextureSize * glprimitive.target_count * targetAttributes.size()];
-                ZeroMemory(newMesh.primitives.back().morphData, sizeof(float)*singleTextureSize* glprimitive.target_count* targetAttributes.size());
+        for (int i = 0; i < glprimitive.target_count; i++)
+        {
+            sGLTFMorphTarget& target = glprimitive.targets[i];
 
-                for (int i = 0; i < glprimitive.target_count; i++)
+            for (const auto& item : attributeOffsets)
+            {
+                for (int j = 0; j < target.attribute_count; j++)
                 {
-                    sGLTFMorphTarget& target = glprimitive.targets[i];
+                    // todo: handle colors
+                    mvVertexElement semantic = get_element_from_gltf_semantic(target.attributes[j].semantic);
 
-                    for (const auto& item : attributeOffsets)
+                    if (item.first == semantic)
                     {
-                        for (int j = 0; j < target.attribute_count; j++)
+                        std::vector<float> data;
+                        
+                        sGLTFAccessor& accessor = model.accessors[target.attributes[j].index];
+                        int offset = item.second * singleTextureSize;
+                        mvFillBuffer(model, accessor, data);
+
+                        std::vector<float> rdata;
+                        if (accessor.type == S_GLTF_VEC2)
                         {
-                            // todo: handle colors
-                            mvVertexElement semantic = get_element_from_gltf_semantic(target.attributes[j].semantic);
-
-                            if (item.first == semantic)
+                            rdata.resize(origIndexBuffer.size() * 2);
+                            for (int k = 0; k < origIndexBuffer.size(); k++)
                             {
-                                std::vector<float> data;
-                                
-                                sGLTFAccessor& accessor = model.accessors[target.attributes[j].index];
-                                int offset = item.second * singleTextureSize;
-                                mvFillBuffer(model, accessor, data);
-
-                                std::vector<float> rdata;
-                                if (accessor.type == S_GLTF_VEC2)
-                                {
-                                    rdata.resize(origIndexBuffer.size() * 2);
-                                    for (int k = 0; k < origIndexBuffer.size(); k++)
-                                    {
-                                        unsigned int i0 = origIndexBuffer[k];
-                                        rdata[k * 3] = data[i0 * 3];
-                                        rdata[k * 3 + 1] = data[i0 * 3 + 1];
-                                    }
-                                }
-                                else if (accessor.type == S_GLTF_VEC3)
-                                {
-                                    rdata.resize(origIndexBuffer.size() * 3);
-                                    for (int k = 0; k < origIndexBuffer.size(); k++)
-                                    {
-                                        unsigned int i0 = origIndexBuffer[k];
-                                        rdata[k * 3] = data[i0 * 3];
-                                        rdata[k * 3 + 1] = data[i0 * 3 + 1];
-                                        rdata[k * 3 + 2] = data[i0 * 3 + 2];
-                                    }
-                                }
-                                else if (accessor.type == S_GLTF_VEC4)
-                                {
-                                    rdata.resize(origIndexBuffer.size() * 4);
-                                    for (int k = 0; k < origIndexBuffer.size(); k++)
-                                    {
-                                        unsigned int i0 = origIndexBuffer[k];
-                                        rdata[k * 3] = data[i0 * 3];
-                                        rdata[k * 3 + 1] = data[i0 * 3 + 1];
-                                        rdata[k * 3 + 2] = data[i0 * 3 + 2];
-                                        rdata[k * 3 + 3] = data[i0 * 3 + 3];
-                                    }
-                                }
-
-
-                                switch (accessor.type)
-                                {
-                                case S_GLTF_VEC2:
-                                case S_GLTF_VEC3:
-                                {
-                                    int paddingOffset = 0;
-                                    int accessorOffset = 0;
-                                    int componentCount = accessor.type == S_GLTF_VEC2 ? 2 : 3;
-                                    for (int k = 0; k < origIndexBuffer.size(); k++)
-                                    {
-                                        memcpy(&newMesh.primitives.back().morphData[offset + paddingOffset], &rdata[accessorOffset], sizeof(float)*componentCount);
-                                        paddingOffset += 4;
-                                        accessorOffset += componentCount;
-                                    }
-                                    break;
-                                }
-                                case S_GLTF_VEC4:
-                                {
-                                    memcpy(&newMesh.primitives.back().morphData[offset], rdata.data(), rdata.size() * sizeof(float));
-                                    break;
-                                }
-
-                                default:
-                                    assert(false);
-                                    
-                                }
+                                unsigned int i0 = origIndexBuffer[k];
+                                rdata[k * 3] = data[i0 * 3];
+                                rdata[k * 3 + 1] = data[i0 * 3 + 1];
+                            }
+                        }
+                        else if (accessor.type == S_GLTF_VEC3)
+                        {
+                            rdata.resize(origIndexBuffer.size() * 3);
+                            for (int k = 0; k < origIndexBuffer.size(); k++)
+                            {
+                                unsigned int i0 = origIndexBuffer[k];
+                                rdata[k * 3] = data[i0 * 3];
+                                rdata[k * 3 + 1] = data[i0 * 3 + 1];
+                                rdata[k * 3 + 2] = data[i0 * 3 + 2];
+                            }
+                        }
+                        else if (accessor.type == S_GLTF_VEC4)
+                        {
+                            rdata.resize(origIndexBuffer.size() * 4);
+                            for (int k = 0; k < origIndexBuffer.size(); k++)
+                            {
+                                unsigned int i0 = origIndexBuffer[k];
+                                rdata[k * 3] = data[i0 * 3];
+                                rdata[k * 3 + 1] = data[i0 * 3 + 1];
+                                rdata[k * 3 + 2] = data[i0 * 3 + 2];
+                                rdata[k * 3 + 3] = data[i0 * 3 + 3];
+                            }
+                        }
+
 
+                        switch (accessor.type)
+                        {
+                        case S_GLTF_VEC2:
+                        case S_GLTF_VEC3:
+                        {
+                            int paddingOffset = 0;
+                            int accessorOffset = 0;
+                            int componentCount = accessor.type == S_GLTF_VEC2 ? 2 : 3;
+                            for (int k = 0; k < origIndexBuffer.size(); k++)
+                            {
+                                memcpy(&cooked.morphData[offset + paddingOffset], &rdata[accessorOffset], sizeof(float)*componentCount);
+                                paddingOffset += 4;
+                                accessorOffset += componentCount;
                             }
+                            break;
+                        }
+                        case S_GLTF_VEC4:
+                        {
+                            memcpy(&cooked.morphData[offset], rdata.data(), rdata.size() * sizeof(float));
+                            break;
                         }
-                        attributeOffsets[item.first] = item.second + 1;
+
+                        default:
+                            assert(false);
+                            
+                        }
+
                     }
                 }
-                newMesh.primitives.back().morphTexture = create_texture(graphics, textureWidth, textureWidth, glprimitive.target_count* targetAttributes.size(), newMesh.primitives.back().morphData);
+                attributeOffsets[item.first] = item.second + 1;
             }
+        }
+    }
 
-            newMesh.primitives.back().layout = modifiedLayout;
-            materialData.extramacros.push_back({ "HAS_NORMALS", "0" });
-            materialData.extramacros.push_back({ "HAS_TANGENTS", "0" });
-            std::string weightCount = std::to_string(glmesh.weights_count);
-            if (!rawBuffers.texture0AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_TEXCOORD_0_VEC2", "0" });
-            if (useMorphing) materialData.extramacros.push_back({ "USE_MORPHING", "0" });
-            if (useMorphing) materialData.extramacros.push_back({ "WEIGHT_COUNT", weightCount.c_str() });
-            if (!rawBuffers.texture1AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_TEXCOORD_1_VEC2", "0" });
-            if (!rawBuffers.color0AttributeBuffer.empty() && rawBuffers.hasColor0Vec3) materialData.extramacros.push_back({ "HAS_VERTEX_COLOR_0_VEC3", "0" });
-            if (!rawBuffers.color0AttributeBuffer.empty() && rawBuffers.hasColor0Vec4) materialData.extramacros.push_back({ "HAS_VERTEX_COLOR_0_VEC4", "0" });
-            if (!rawBuffers.color1AttributeBuffer.empty() && rawBuffers.hasColor1Vec3) materialData.extramacros.push_back({ "HAS_VERTEX_COLOR_1_VEC3", "0" });
-            if (!rawBuffers.color1AttributeBuffer.empty() && rawBuffers.hasColor1Vec4) materialData.extramacros.push_back({ "HAS_VERTEX_COLOR_1_VEC4", "0" });
-            if (!rawBuffers.joints0AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_JOINTS_0_VEC4", "0" });
-            if (!rawBuffers.joints1AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_JOINTS_1_VEC4", "0" });
-            if (!rawBuffers.weights0AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_WEIGHTS_0_VEC4", "0" });
-            if (!rawBuffers.weights1AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_WEIGHTS_1_VEC4", "0" });
-            if (!rawBuffers.joints0AttributeBuffer.empty()) materialData.extramacros.push_back({ "USE_SKINNING", "0" });
-
-            // upload index buffer
-
-            if (glprimitive.material_index != -1)
-            {
+    cooked.minBound = *(sVec3*)primitiveMin;
+    cooked.maxBound = *(sVec3*)primitiveMax;
+    materialData.extramacros.push_back({ "HAS_NORMALS", "0" });
+    materialData.extramacros.push_back({ "HAS_TANGENTS", "0" });
+    std::string weightCount = std::to_string(glmesh.weights_count);
+    if (!rawBuffers.texture0AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_TEXCOORD_0_VEC2", "0" });
+    if (glmesh.weights_count > 0) materialData.extramacros.push_back({ "USE_MORPHING", "0" });
+    if (glmesh.weights_count > 0) materialData.extramacros.push_back({ "WEIGHT_COUNT", weightCount.c_str() });
+    if (!rawBuffers.texture1AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_TEXCOORD_1_VEC2", "0" });
+    if (!rawBuffers.color0AttributeBuffer.empty() && rawBuffers.hasColor0Vec3) materialData.extramacros.push_back({ "HAS_VERTEX_COLOR_0_VEC3", "0" });
+    if (!rawBuffers.color0AttributeBuffer.empty() && rawBuffers.hasColor0Vec4) materialData.extramacros.push_back({ "HAS_VERTEX_COLOR_0_VEC4", "0" });
+    if (!rawBuffers.color1AttributeBuffer.empty() && rawBuffers.hasColor1Vec3) materialData.extramacros.push_back({ "HAS_VERTEX_COLOR_1_VEC3", "0" });
+    if (!rawBuffers.color1AttributeBuffer.empty() && rawBuffers.hasColor1Vec4) materialData.extramacros.push_back({ "HAS_VERTEX_COLOR_1_VEC4", "0" });
+    if (!rawBuffers.joints0AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_JOINTS_0_VEC4", "0" });
+    if (!rawBuffers.joints1AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_JOINTS_1_VEC4", "0" });
+    if (!rawBuffers.weights0AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_WEIGHTS_0_VEC4", "0" });
+    if (!rawBuffers.weights1AttributeBuffer.empty()) materialData.extramacros.push_back({ "HAS_WEIGHTS_1_VEC4", "0" });
+    if (!rawBuffers.joints0AttributeBuffer.empty()) materialData.extramacros.push_back({ "USE_SKINNING", "0" });
+    if (instanced) materialData.extramacros.push_back({ "USE_INSTANCING", "0" });
+
+    materialData.layout = modifiedLayout;
+
+    cooked.layout = std::move(modifiedLayout);
+    cooked.material = std::move(materialData);
+    cooked.vertexData = std::move(vertexBuffer);
+    cooked.indexData = std::move(indexBuffer);
+    cooked.sourceIndexData = std::move(origIndexBuffer);
+}
 
-                sGLTFMaterial& material = model.materials[glprimitive.material_index];
-
-                materialData.data.albedo = *(sVec4*)material.base_color_factor;
-                materialData.data.metalness = material.metallic_factor;
-                materialData.data.roughness = material.roughness_factor;
-                materialData.data.emisiveFactor = *(sVec3*)material.emissive_factor;
-                materialData.data.occlusionStrength = material.occlusion_texture_strength;
-                materialData.data.alphaCutoff = 0.5f;
-                materialData.data.doubleSided = material.double_sided;
-                materialData.data.clearcoatFactor = material.clearcoat_factor;
-                materialData.data.clearcoatRoughnessFactor = material.clearcoat_roughness_factor;
-                materialData.data.clearcoatNormalScale = material.clearcoat_normal_texture_scale;
-                materialData.extensionClearcoat = material.clearcoat_extension;
-                materialData.pbrMetallicRoughness = material.pbrMetallicRoughness;
-                materialData.alphaMode = material.alphaMode;
-                if (materialData.alphaMode == 1)
-                    materialData.data.alphaCutoff = material.alphaCutoff;
-
-                newMesh.primitives.back().albedoTexture = setup_texture(graphics, model, currentPrimitive, material.base_color_texture, materialData.hasAlbedoMap, newMesh.name, "_a");
-                newMesh.primitives.back().normalTexture = setup_texture(graphics, model, currentPrimitive, material.normal_texture, materialData.hasNormalMap, newMesh.name, "_n");
-                newMesh.primitives.back().metalRoughnessTexture = setup_texture(graphics, model, currentPrimitive, material.metallic_roughness_texture, materialData.hasMetallicRoughnessMap, newMesh.name, "_m");
-                newMesh.primitives.back().emissiveTexture = setup_texture(graphics, model, currentPrimitive, material.emissive_texture, materialData.hasEmmissiveMap, newMesh.name, "_e");
-                newMesh.primitives.back().occlusionTexture = setup_texture(graphics, model, currentPrimitive, material.occlusion_texture, materialData.hasOcculusionMap, newMesh.name, "_o");
-                newMesh.primitives.back().clearcoatTexture = setup_texture(graphics, model, currentPrimitive, material.clearcoat_texture, materialData.hasClearcoatMap, newMesh.name, "_cc");
-                newMesh.primitives.back().clearcoatRoughnessTexture = setup_texture(graphics, model, currentPrimitive, material.clearcoat_roughness_texture, materialData.hasClearcoatRoughnessMap, newMesh.name, "_ccr");
-                newMesh.primitives.back().clearcoatNormalTexture = setup_texture(graphics, model, currentPrimitive, material.clearcoat_normal_texture, materialData.hasClearcoatNormalMap, newMesh.name, "_ccn");
-            }
-            else
-            {
-                materialData.data.albedo = { 0.45f, 0.45f, 0.85f, 1.0f };
-                materialData.data.metalness = 0.0f;
-                materialData.data.roughness = 0.5f;
-                materialData.data.alphaCutoff = 0.5f;
-                materialData.data.doubleSided = false;
-            }
+static mvMaterial
+upload_cooked_primitive(mvGraphics& graphics, mvCookedPrimitive& cooked, mvMeshPrimitive& primitive, bool keepGeometry, float* minBoundary, float* maxBoundary)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (cooked.minBound[i] < minBoundary[i]) minBoundary[i] = cooked.minBound[i];
+        if (cooked.maxBound[i] > maxBoundary[i]) maxBoundary[i] = cooked.maxBound[i];
+    }
+
+    if (cooked.morphData)
+    {
+        primitive.morphData = cooked.morphData;
+        primitive.morphWidth = cooked.morphWidth;
+        primitive.morphTexture = create_texture(graphics, cooked.morphWidth, cooked.morphWidth, cooked.morphLayers, cooked.morphData);
+        primitive.morphAttributes = std::move(cooked.morphAttributes);
+        primitive.morphBase = cooked.vertexData;
+    }
+
+    primitive.minBound = cooked.minBound;
+    primitive.maxBound = cooked.maxBound;
+    primitive.geometryID = allocate_geometry(graphics, cooked.layout, cooked.vertexData.data(), cooked.vertexData.size() * sizeof(float) / cooked.layout.size, cooked.indexData.data(), cooked.indexData.size());
+    primitive.layout = std::move(cooked.layout);
+
+    if (keepGeometry)
+    {
+        primitive.vertexData = std::move(cooked.vertexData);
+        primitive.indexData = std::move(cooked.indexData);
+    }
+
+    return std::move(cooked.material);
+}
+
+// everything cook_gltf_primitive reads, the layout follows from the attribute semantics
+static bool
+get_shared_geometry_key(sGLTFMesh& glmesh, unsigned int currentPrimitive, bool instanced, bool bakeOcclusion, uint64_t& key)
+{
+    sGLTFMeshPrimitive& glprimitive = glmesh.primitives[currentPrimitive];
+
+    // morph data is per primitive, baked occlusion depends on the rest of the mesh
+    if (glprimitive.target_count > 0 || bakeOcclusion)
+        return false;
+
+    key = hash_bytes(&glprimitive.indices_index, sizeof(glprimitive.indices_index));
+    for (unsigned int i = 0; i < glprimitive.attribute_count; i++)
+    {
+        auto& attribute = glprimitive.attributes[i];
+        key = hash_bytes(attribute.semantic, strlen(attribute.semantic), key);
+        key = hash_bytes(&attribute.index, sizeof(attribute.index), key);
+    }
+    key = hash_bytes(&instanced, sizeof(instanced), key);
+    key = hash_bytes(&glmesh.weights_count, sizeof(glmesh.weights_count), key);
+    return true;
+}
+
+static mvMaterial
+share_primitive_geometry(mvGraphics& graphics, mvModel& mvmodel, const mvSharedGeometry& shared, mvMeshPrimitive& primitive, bool keepGeometry, float* minBoundary, float* maxBoundary)
+{
+    mvMeshPrimitive& source = mvmodel.meshes[shared.mesh].primitives[shared.primitive];
+    for (int i = 0; i < 3; i++)
+    {
+        if (source.minBound[i] < minBoundary[i]) minBoundary[i] = source.minBound[i];
+        if (source.maxBound[i] > maxBoundary[i]) maxBoundary[i] = source.maxBound[i];
+    }
+
+    retain_geometry(graphics, source.geometryID);
+    primitive.geometryID = source.geometryID;
+    primitive.layout = source.layout;
+    primitive.minBound = source.minBound;
+    primitive.maxBound = source.maxBound;
 
-            materialData.layout = modifiedLayout;
-            std::string hash = hash_material(materialData, modifiedLayout, std::string("PBR_PS.hlsl"), std::string("PBR_VS.hlsl"));
+    if (keepGeometry)
+    {
+        primitive.vertexData = source.vertexData;
+        primitive.indexData = source.indexData;
+    }
+
+    mvmodel.sharedPrimitives++;
+    return shared.material;
+}
 
-            newMesh.primitives.back().materialID = mvGetMaterialAssetID(&mvmodel.materialManager, hash);
-            if (newMesh.primitives.back().materialID == -1)
+static mvMaterial
+load_gltf_primitive_geometry(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model, mvSharedGeometryMap& sharedGeometry, unsigned int currentMesh, unsigned int currentPrimitive, bool instanced, bool keepGeometry, bool bakeOcclusion, float* minBoundary, float* maxBoundary)
+{
+    mvMeshPrimitive& primitive = mvmodel.meshes[currentMesh].primitives[currentPrimitive];
+
+    uint64_t key = 0u;
+    bool shareable = get_shared_geometry_key(model.meshes[currentMesh], currentPrimitive, instanced, bakeOcclusion, key);
+    if (shareable)
+    {
+        auto shared = sharedGeometry.find(key);
+        if (shared != sharedGeometry.end())
+            return share_primitive_geometry(graphics, mvmodel, shared->second, primitive, keepGeometry, minBoundary, maxBoundary);
+    }
+
+    mvCookedPrimitive cooked;
+    cook_gltf_primitive(model, model.meshes[currentMesh], currentPrimitive, instanced, cooked);
+    if (bakeOcclusion)
+    {
+        std::vector<mvCookedPrimitive*> primitives = { &cooked };
+        bake_vertex_occlusion(primitives, mvOcclusionSettings{});
+    }
+
+    if (shareable)
+        sharedGeometry[key] = { (mvAssetID)currentMesh, currentPrimitive, cooked.material };
+    return upload_cooked_primitive(graphics, cooked, primitive, keepGeometry, minBoundary, maxBoundary);
+}
+
+static void
+load_gltf_primitive_materials(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model, const mvJsonValue* jsonMeshes, unsigned int currentMesh, unsigned int currentPrimitive, mvMaterial& materialData, bool instanced)
+{
+    mvMesh& mesh = mvmodel.meshes[currentMesh];
+    mvMeshPrimitive& primitive = mesh.primitives[currentPrimitive];
+    sGLTFMeshPrimitive& glprimitive = model.meshes[currentMesh].primitives[currentPrimitive];
+
+    primitive.materialID = load_gltf_material(graphics, mvmodel, model, glprimitive.material_index, materialData, currentPrimitive, mesh.name, instanced);
+    primitive.defaultMaterialID = primitive.materialID;
+
+    // KHR_materials_variants, every variant is built up front so switching is a remap
+    const mvJsonValue* mappings = nullptr;
+    if (jsonMeshes && currentMesh < jsonMeshes->elements.size())
+    {
+        const mvJsonValue* jsonPrimitives = get_json_member(jsonMeshes->elements[currentMesh], "primitives");
+        if (jsonPrimitives && currentPrimitive < jsonPrimitives->elements.size())
+            mappings = get_json_path(jsonPrimitives->elements[currentPrimitive], { "extensions", "KHR_materials_variants", "mappings" });
+    }
+    if (mappings && !mvmodel.variants.empty())
+    {
+        primitive.variantMaterialIDs.resize(mvmodel.variants.size(), -1);
+        for (unsigned int i = 0; i < mappings->elements.size(); i++)
+        {
+            const mvJsonValue* material = get_json_member(mappings->elements[i], "material");
+            const mvJsonValue* variants = get_json_member(mappings->elements[i], "variants");
+            if (material == nullptr || variants == nullptr || material->number < 0.0 || material->number >= model.material_count)
+                continue;
+
+            mvAssetID materialID = load_gltf_material(graphics, mvmodel, model, (int)material->number, materialData, currentPrimitive, mesh.name, instanced);
+            for (unsigned int j = 0; j < variants->elements.size(); j++)
             {
-                newMesh.primitives.back().materialID = register_asset(&mvmodel.materialManager, hash, create_material(graphics, "PBR_VS.hlsl", "PBR_PS.hlsl", materialData));
+                int variant = (int)variants->elements[j].number;
+                if (variant >= 0 && variant < (int)primitive.variantMaterialIDs.size())
+                    primitive.variantMaterialIDs[variant] = materialID;
             }
+        }
+    }
+}
 
-            newMesh.primitives.back().vertexBuffer = create_buffer(graphics, vertexBuffer.data(), vertexBuffer.size() * sizeof(float), D3D11_BIND_VERTEX_BUFFER);
-            newMesh.primitives.back().indexBuffer = create_buffer(graphics, indexBuffer.data(), indexBuffer.size() * sizeof(unsigned int), D3D11_BIND_INDEX_BUFFER);
+static void
+load_gltf_meshes(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model, float* minBoundary, float* maxBoundary, bool keepGeometry, bool bakeOcclusion, std::vector<bool>& instancedMeshes, const mvJsonValue* jsonMeshes)
+{
+    mvSharedGeometryMap sharedGeometry;
+    for (unsigned int currentMesh = 0u; currentMesh < model.mesh_count; currentMesh++)
+    {
+        sGLTFMesh& glmesh = model.meshes[currentMesh];
+        mvmodel.meshes.push_back(create_gltf_mesh(graphics, glmesh));
+        mvmodel.meshes.back().primitives.resize(glmesh.primitives_count);
 
+        if (!bakeOcclusion)
+        {
+            for (unsigned int currentPrimitive = 0u; currentPrimitive < glmesh.primitives_count; currentPrimitive++)
+            {
+                mvMaterial materialData = load_gltf_primitive_geometry(graphics, mvmodel, model, sharedGeometry, currentMesh, currentPrimitive, instancedMeshes[currentMesh], keepGeometry, false, minBoundary, maxBoundary);
+                load_gltf_primitive_materials(graphics, mvmodel, model, jsonMeshes, currentMesh, currentPrimitive, materialData, instancedMeshes[currentMesh]);
+            }
+            continue;
         }
 
-        mvmodel.meshes.push_back(newMesh);
+        // cook the whole mesh first so its primitives occlude each other
+        std::vector<mvCookedPrimitive> cookedPrimitives(glmesh.primitives_count);
+        std::vector<mvCookedPrimitive*> primitives;
+        for (unsigned int currentPrimitive = 0u; currentPrimitive < glmesh.primitives_count; currentPrimitive++)
+        {
+            cook_gltf_primitive(model, glmesh, currentPrimitive, instancedMeshes[currentMesh], cookedPrimitives[currentPrimitive]);
+            primitives.push_back(&cookedPrimitives[currentPrimitive]);
+        }
+        bake_vertex_occlusion(primitives, mvOcclusionSettings{});
 
+        for (unsigned int currentPrimitive = 0u; currentPrimitive < glmesh.primitives_count; currentPrimitive++)
+        {
+            mvMeshPrimitive& primitive = mvmodel.meshes.back().primitives[currentPrimitive];
+            mvMaterial materialData = upload_cooked_primitive(graphics, cookedPrimitives[currentPrimitive], primitive, keepGeometry, minBoundary, maxBoundary);
+            load_gltf_primitive_materials(graphics, mvmodel, model, jsonMeshes, currentMesh, currentPrimitive, materialData, instancedMeshes[currentMesh]);
+        }
     }
-
 }
 
 static void
@@ -1309,10 +1572,9 @@ load_gltf_nodes(mvModel& mvmodel, sGLTFModel& model)
         if (glnode.camera_index > -1)
             newNode.camera = glnode.camera_index;
 
+        newNode.childOffset = (unsigned int)mvmodel.nodeIndices.size();
         newNode.childCount = glnode.child_count;
-
-        for (int i = 0; i < glnode.child_count; i++)
-            newNode.children[i] = (mvAssetID)glnode.children[i];
+        mvmodel.nodeIndices.insert(mvmodel.nodeIndices.end(), glnode.children, glnode.children + glnode.child_count);
 
         newNode.rotation = *(sVec4*)(glnode.rotation);
         newNode.scale = *(sVec3*)(glnode.scale);
@@ -1329,11 +1591,104 @@ load_gltf_nodes(mvModel& mvmodel, sGLTFModel& model)
 
         newNode.transform = newNode.matrix;
 
-        mvmodel.nodes.push_back(newNode);
+        mvmodel.nodes.push_back(std::move(newNode));
     }
 
 }
 
+static const mvJsonValue*
+get_instancing_attributes(const mvJsonValue* jsonNodes, unsigned int node)
+{
+    if (jsonNodes == nullptr || node >= jsonNodes->elements.size())
+        return nullptr;
+    return get_json_path(jsonNodes->elements[node], { "extensions", "EXT_mesh_gpu_instancing", "attributes" });
+}
+
+static void
+load_gltf_instances(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model, const mvJsonValue* jsonNodes, std::vector<bool>& instancedMeshes)
+{
+    static const char* semantics[] = { "TRANSLATION", "ROTATION", "SCALE" };
+    static const unsigned int componentCaps[] = { 3u, 4u, 3u };
+
+    for (unsigned int currentNode = 0u; currentNode < model.node_count; currentNode++)
+    {
+        mvNode& node = mvmodel.nodes[currentNode];
+        if (node.mesh == -1 || !instancedMeshes[node.mesh])
+            continue;
+
+        // other nodes sharing an instanced mesh draw a single instance
+        std::vector<sMat4> transforms;
+        const mvJsonValue* attributes = get_instancing_attributes(jsonNodes, currentNode);
+        if (attributes)
+        {
+            std::vector<float> values[3];
+            unsigned int count = 0u;
+            bool counted = false;
+            bool valid = true;
+            for (int i = 0; i < 3 && valid; i++)
+            {
+                const mvJsonValue* accessorIndex = get_json_member(*attributes, semantics[i]);
+                if (accessorIndex == nullptr || accessorIndex->type != MV_JSON_NUMBER || accessorIndex->number < 0.0 || accessorIndex->number >= model.accessor_count)
+                    continue;
+
+                sGLTFAccessor& accessor = model.accessors[(int)accessorIndex->number];
+                mvFillBuffer(model, accessor, values[i], componentCaps[i]);
+
+                // every attribute needs one full element per instance
+                if (!counted)
+                {
+                    count = accessor.count;
+                    counted = true;
+                }
+                valid = accessor.count == count && values[i].size() >= (size_t)count * componentCaps[i];
+
+                // rotations may be normalized integers
+                if (accessor.component_type == S_GLTF_BYTE)
+                {
+                    for (float& value : values[i])
+                        value = fmaxf((value > 127.0f ? value - 256.0f : value) / 127.0f, -1.0f);
+                }
+                else if (accessor.component_type == S_GLTF_SHORT)
+                {
+                    for (float& value : values[i])
+                        value = fmaxf(value / 32767.0f, -1.0f);
+                }
+            }
+
+            if (valid)
+            {
+                transforms.resize(count);
+                for (unsigned int i = 0; i < count; i++)
+                {
+                    sVec3 translation = values[0].empty() ? sVec3{ 0.0f, 0.0f, 0.0f } : *(sVec3*)&values[0][i * 3];
+                    sVec4 rotation = values[1].empty() ? sVec4{ 0.0f, 0.0f, 0.0f, 1.0f } : *(sVec4*)&values[1][i * 4];
+                    sVec3 scale = values[2].empty() ? sVec3{ 1.0f, 1.0f, 1.0f } : *(sVec3*)&values[2][i * 3];
+                    transforms[i] = Semper::rotation_translation_scale(rotation, translation, scale);
+                }
+            }
+            else
+                transforms.push_back(sMat4(1.0f)); // malformed attributes, ignore the extension and draw the mesh once
+        }
+        else
+            transforms.push_back(sMat4(1.0f));
+
+        if (transforms.empty())
+            continue;
+
+        // transform and normal matrix pairs like the joint texture, SCALE may be non-uniform
+        std::vector<sMat4> instanceData(transforms.size() * 2u);
+        for (size_t i = 0; i < transforms.size(); i++)
+        {
+            instanceData[i * 2u] = transforms[i];
+            instanceData[i * 2u + 1u] = Semper::transpose(Semper::invert(transforms[i]));
+        }
+
+        mvBuffer buffer = create_buffer(graphics, instanceData.data(), instanceData.size() * sizeof(sMat4), D3D11_BIND_SHADER_RESOURCE, sizeof(sMat4), D3D11_RESOURCE_MISC_BUFFER_STRUCTURED);
+        node.instanceBuffer = buffer.shaderResourceView;
+        node.instanceCount = (unsigned int)transforms.size();
+    }
+}
+
 static void
 load_gltf_animations(mvModel& mvmodel, sGLTFModel& model)
 {
@@ -1377,23 +1732,334 @@ load_gltf_animations(mvModel& mvmodel, sGLTFModel& model)
             }
         }
 
-        mvmodel.animations.push_back(animation);
+        mvmodel.animations.push_back(std::move(animation));
     }
 
 }
 
-mvModel
-load_gltf_assets(mvGraphics& graphics, sGLTFModel& model)
+static bool
+has_material_variants(mvMesh& mesh)
 {
-    mvModel mvmodel{};
-    float maxBoundary[3] = { -FLT_MAX , -FLT_MAX , -FLT_MAX };
-    float minBoundary[3] = { FLT_MAX , FLT_MAX , FLT_MAX };
-    mvmodel.loaded = true;
-    load_gltf_skins(graphics, mvmodel, model);
-    load_gltf_meshes(graphics, mvmodel, model, minBoundary, maxBoundary);
-    load_gltf_nodes(mvmodel, model);
-    load_gltf_animations(mvmodel, model);
+    for (unsigned int i = 0; i < mesh.primitives.size(); i++)
+    {
+        if (!mesh.primitives[i].variantMaterialIDs.empty())
+            return true;
+    }
+    return false;
+}
+
+static void
+collect_static_nodes(mvModel& model, mvAssetID nodeID, sMat4 parentTransform, bool dynamic, std::vector<mvAssetID>& nodes, std::vector<sMat4>& transforms)
+{
+    mvNode& node = model.nodes[nodeID];
+    sMat4 worldTransform = parentTransform * node.transform;
+
+    // anything below an animated node moves with it
+    dynamic = dynamic || node.animated;
+
+    // variant switching remaps materials, which would split batches
+    if (!dynamic && node.mesh > -1 && node.camera == -1 && node.skin == -1 && node.instanceCount == 0u && model.meshes[node.mesh].weights.empty()
+        && !has_material_variants(model.meshes[node.mesh]))
+    {
+        nodes.push_back(nodeID);
+        transforms.push_back(worldTransform);
+    }
+
+    for (unsigned int i = 0; i < node.childCount; i++)
+        collect_static_nodes(model, model.nodeIndices[node.childOffset + i], worldTransform, dynamic, nodes, transforms);
+}
+
+static void
+append_batch_primitive(mvStaticBatch& batch, mvMeshPrimitive& primitive, sMat4 transform, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+    mvVertexLayout& layout = primitive.layout;
+    unsigned int stride = layout.size / sizeof(float);
+    unsigned int baseVertex = (unsigned int)(vertices.size() / stride);
+
+    // normals use the inverse transpose, mirrored transforms flip winding
+    sMat4 normalTransform = Semper::transpose(Semper::invert(transform));
+    float determinant =
+        transform[0][0] * (transform[1][1] * transform[2][2] - transform[2][1] * transform[1][2]) -
+        transform[1][0] * (transform[0][1] * transform[2][2] - transform[2][1] * transform[0][2]) +
+        transform[2][0] * (transform[0][1] * transform[1][2] - transform[1][1] * transform[0][2]);
+    bool mirrored = determinant < 0.0f;
+
+    size_t vertexStart = vertices.size();
+    vertices.insert(vertices.end(), primitive.vertexData.begin(), primitive.vertexData.end());
+    for (size_t v = vertexStart; v < vertices.size(); v += stride)
+    {
+        for (size_t e = 0; e < layout.semantics.size(); e++)
+        {
+            float* item = &vertices[v + layout.offsets[e] / sizeof(float)];
+            if (layout.semantics[e] == "Position" && layout.formats[e] == DXGI_FORMAT_R32G32B32_FLOAT)
+            {
+                sVec4 position = transform * sVec4{ item[0], item[1], item[2], 1.0f };
+                item[0] = position.x;
+                item[1] = position.y;
+                item[2] = position.z;
+            }
+            else if (layout.semantics[e] == "Normal")
+            {
+                sVec4 normal = normalTransform * sVec4{ item[0], item[1], item[2], 0.0f };
+                sVec3 result = Semper::normalize(normal.xyz);
+                item[0] = result.x;
+                item[1] = result.y;
+                item[2] = result.z;
+            }
+            else if (layout.semantics[e] == "Tangent")
+            {
+                sVec4 tangent = transform * sVec4{ item[0], item[1], item[2], 0.0f };
+                sVec3 result = Semper::normalize(tangent.xyz);
+                item[0] = result.x;
+                item[1] = result.y;
+                item[2] = result.z;
+                if (mirrored)
+                    item[3] = -item[3];
+            }
+        }
+    }
+
+    mvBatchRange range{};
+    range.indexOffset = (unsigned int)indices.size();
+    range.indexCount = (unsigned int)primitive.indexData.size();
+    for (size_t i = 0; i + 2 < primitive.indexData.size(); i += 3)
+    {
+        indices.push_back(baseVertex + primitive.indexData[i]);
+        indices.push_back(baseVertex + primitive.indexData[mirrored ? i + 2 : i + 1]);
+        indices.push_back(baseVertex + primitive.indexData[mirrored ? i + 1 : i + 2]);
+    }
+
+    // world space bounds of the source primitive
+    range.minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+    range.maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int i = 0; i < 8; i++)
+    {
+        sVec4 corner = transform * sVec4{
+            (i & 1) ? primitive.maxBound.x : primitive.minBound.x,
+            (i & 2) ? primitive.maxBound.y : primitive.minBound.y,
+            (i & 4) ? primitive.maxBound.z : primitive.minBound.z,
+            1.0f };
+        for (int c = 0; c < 3; c++)
+        {
+            if (corner[c] < range.minBound[c]) range.minBound[c] = corner[c];
+            if (corner[c] > range.maxBound[c]) range.maxBound[c] = corner[c];
+            if (corner[c] < batch.primitive.minBound[c]) batch.primitive.minBound[c] = corner[c];
+            if (corner[c] > batch.primitive.maxBound[c]) batch.primitive.maxBound[c] = corner[c];
+        }
+    }
+    batch.ranges.push_back(range);
+}
+
+static void
+batch_static_geometry(mvGraphics& graphics, mvModel& model)
+{
+    for (unsigned int currentScene = 0u; currentScene < model.scenes.size(); currentScene++)
+    {
+        mvScene& scene = model.scenes[currentScene];
+
+        std::vector<mvAssetID> nodes;
+        std::vector<sMat4> transforms;
+        for (unsigned int i = 0; i < scene.nodeCount; i++)
+            collect_static_nodes(model, model.nodeIndices[scene.nodeOffset + i], sMat4(1.0f), false, nodes, transforms);
+
+        // group primitives by material (textures and layout included)
+        size_t firstBatch = model.staticBatches.size();
+        std::vector<std::vector<mvMeshPrimitive*>> groupPrimitives;
+        std::vector<std::vector<sMat4>> groupTransforms;
+        for (unsigned int i = 0; i < nodes.size(); i++)
+        {
+            mvMesh& mesh = model.meshes[model.nodes[nodes[i]].mesh];
+            for (unsigned int j = 0; j < mesh.primitives.size(); j++)
+            {
+                mvMeshPrimitive& primitive = mesh.primitives[j];
+
+                size_t group = firstBatch;
+                while (group < model.staticBatches.size() && model.staticBatches[group].primitive.materialID != primitive.materialID)
+                    group++;
+
+                if (group == model.staticBatches.size())
+                {
+                    mvStaticBatch batch{};
+                    batch.scene = currentScene;
+                    batch.primitive.layout = primitive.layout;
+                    batch.primitive.materialID = primitive.materialID;
+                    batch.primitive.defaultMaterialID = primitive.materialID;
+                    batch.primitive.minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+                    batch.primitive.maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+                    model.staticBatches.push_back(batch);
+                    groupPrimitives.push_back({});
+                    groupTransforms.push_back({});
+                }
+
+                groupPrimitives[group - firstBatch].push_back(&primitive);
+                groupTransforms[group - firstBatch].push_back(transforms[i]);
+            }
+            model.nodes[nodes[i]].batched = true;
+        }
+
+        for (size_t i = firstBatch; i < model.staticBatches.size(); i++)
+        {
+            mvStaticBatch& batch = model.staticBatches[i];
+            std::vector<float> vertices;
+            std::vector<unsigned int> indices;
+            for (size_t j = 0; j < groupPrimitives[i - firstBatch].size(); j++)
+                append_batch_primitive(batch, *groupPrimitives[i - firstBatch][j], groupTransforms[i - firstBatch][j], vertices, indices);
+
+            batch.primitive.geometryID = allocate_geometry(graphics, batch.primitive.layout, vertices.data(), vertices.size() * sizeof(float) / batch.primitive.layout.size, indices.data(), indices.size());
+        }
+    }
+
+    // meshes only drawn through batches no longer need their own buffers
+    std::vector<bool> meshInUse(model.meshes.size(), false);
+    for (unsigned int i = 0; i < model.nodes.size(); i++)
+    {
+        if (model.nodes[i].mesh > -1 && !model.nodes[i].batched)
+            meshInUse[model.nodes[i].mesh] = true;
+    }
+
+    for (unsigned int i = 0; i < model.meshes.size(); i++)
+    {
+        if (meshInUse[i])
+            continue;
+        for (unsigned int j = 0; j < model.meshes[i].primitives.size(); j++)
+        {
+            mvMeshPrimitive& primitive = model.meshes[i].primitives[j];
+            release_geometry(graphics, primitive.geometryID);
+            primitive.geometryID = -1;
+        }
+    }
+}
+
+static void
+compute_model_footprint(mvGraphics& graphics, mvModel& model)
+{
+    model.cpuBytes = 0u;
+    model.gpuBytes = 0u;
+
+    std::vector<mvAssetID> textures;
+    std::vector<mvAssetID> geometry; // shared between primitives, count once
+    for (unsigned int i = 0; i < model.meshes.size(); i++)
+    {
+        mvMesh& mesh = model.meshes[i];
+        model.cpuBytes += (mesh.weights.size() + mesh.weightsAnimated.size()) * sizeof(float);
+        model.gpuBytes += mesh.morphBuffer.buffer ? mesh.morphBuffer.size : 0u;
+
+        for (unsigned int j = 0; j < mesh.primitives.size(); j++)
+        {
+            mvMeshPrimitive& primitive = mesh.primitives[j];
+            model.gpuBytes += primitive.vertexBuffer.buffer ? primitive.vertexBuffer.size : 0u;
+            model.gpuBytes += primitive.indexBuffer.buffer ? primitive.indexBuffer.size : 0u;
+            if (primitive.geometryID != -1 && std::find(geometry.begin(), geometry.end(), primitive.geometryID) == geometry.end())
+            {
+                geometry.push_back(primitive.geometryID);
+                model.gpuBytes += get_geometry_size(graphics.geometryPool, primitive.geometryID);
+            }
+
+            if (primitive.morphTexture.textureView)
+            {
+                ID3D11Resource* resource;
+                primitive.morphTexture.textureView->GetResource(&resource);
+                D3D11_TEXTURE2D_DESC desc;
+                ((ID3D11Texture2D*)resource)->GetDesc(&desc);
+                model.gpuBytes += desc.Width * desc.Height * desc.ArraySize * 4u * sizeof(float);
+                model.cpuBytes += desc.Width * desc.Height * desc.ArraySize * 4u * sizeof(float); // morphData
+                resource->Release();
+            }
+            model.cpuBytes += (primitive.morphBase.size() + primitive.morphBlended.size()) * sizeof(float);
+        }
+    }
+
+    for (unsigned int i = 0; i < model.materialManager.materials.size(); i++)
+    {
+        mvMaterial& material = model.materialManager.materials[i].asset;
+        mvAssetID ids[] = {
+            material.albedoTexture.streamID, material.normalTexture.streamID, material.metalRoughnessTexture.streamID,
+            material.emissiveTexture.streamID, material.occlusionTexture.streamID, material.clearcoatTexture.streamID,
+            material.clearcoatRoughnessTexture.streamID, material.clearcoatNormalTexture.streamID };
+        for (int k = 0; k < 8; k++)
+        {
+            if (ids[k] != -1 && std::find(textures.begin(), textures.end(), ids[k]) == textures.end())
+                textures.push_back(ids[k]);
+        }
+    }
+
+    // cpu mip chains kept by the streamer (its gpu side has its own budget)
+    for (unsigned int i = 0; i < textures.size(); i++)
+        model.cpuBytes += get_streamed_texture_size(graphics.textureStreamer, textures[i]);
+
+    for (unsigned int i = 0; i < model.skins.size(); i++)
+    {
+        mvSkin& skin = model.skins[i];
+        model.cpuBytes += (skin.inverseBindMatrices.size() + skin.textureData.size()) * sizeof(float);
+        model.gpuBytes += skin.textureData.size() * sizeof(float);
+    }
+
+    for (unsigned int i = 0; i < model.animations.size(); i++)
+    {
+        mvAnimation& animation = model.animations[i];
+        for (unsigned int j = 0; j < animation.channelCount; j++)
+            model.cpuBytes += (animation.channels[j].inputdata.size() + animation.channels[j].outputdata.size()) * sizeof(float);
+    }
 
+    for (unsigned int i = 0; i < model.staticBatches.size(); i++)
+    {
+        mvStaticBatch& batch = model.staticBatches[i];
+        model.gpuBytes += get_geometry_size(graphics.geometryPool, batch.primitive.geometryID);
+        model.cpuBytes += batch.ranges.size() * sizeof(mvBatchRange);
+    }
+
+    model.gpuBytes += model.materialManager.materials.size() * sizeof(mvMaterialData);
+    model.cpuBytes += model.materialManager.materials.size() * sizeof(mvMaterialAsset);
+    model.cpuBytes += model.nodes.size() * sizeof(mvNode);
+    model.cpuBytes += model.nodeIndices.size() * sizeof(mvAssetID);
+
+    for (unsigned int i = 0; i < model.nodes.size(); i++)
+        model.gpuBytes += model.nodes[i].instanceCount * 2u * sizeof(sMat4);
+}
+
+static void
+prepare_gltf_extensions(mvModel& mvmodel, sGLTFModel& model, const char* path, mvJsonValue& json, std::vector<bool>& instancedMeshes)
+{
+    // sGltf doesn't expose extensions, read EXT_mesh_gpu_instancing from the json
+    load_gltf_json(path, json);
+    const mvJsonValue* jsonNodes = get_json_member(json, "nodes");
+
+    // same for KHR_materials_variants
+    const mvJsonValue* variants = get_json_path(json, { "extensions", "KHR_materials_variants", "variants" });
+    for (unsigned int i = 0; variants && i < variants->elements.size(); i++)
+    {
+        const mvJsonValue* name = get_json_member(variants->elements[i], "name");
+        mvmodel.variants.push_back(name ? name->string : "Variant " + std::to_string(i));
+    }
+
+    instancedMeshes.assign(model.mesh_count, false);
+    for (unsigned int currentNode = 0u; currentNode < model.node_count; currentNode++)
+    {
+        int mesh = model.nodes[currentNode].mesh_index;
+        if (mesh > -1 && get_instancing_attributes(jsonNodes, currentNode))
+            instancedMeshes[mesh] = true;
+    }
+
+    // size every container once, cameras add a frustum mesh each
+    size_t indexCount = 0u;
+    for (unsigned int i = 0u; i < model.node_count; i++)
+        indexCount += model.nodes[i].child_count;
+    for (unsigned int i = 0u; i < model.scene_count; i++)
+        indexCount += model.scenes[i].node_count;
+    for (unsigned int i = 0u; i < model.skin_count; i++)
+        indexCount += model.skins[i].joints_count;
+    mvmodel.nodeIndices.reserve(indexCount);
+    mvmodel.meshes.reserve(model.mesh_count + model.camera_count);
+    mvmodel.nodes.reserve(model.node_count);
+    mvmodel.skins.reserve(model.skin_count);
+    mvmodel.cameras.reserve(model.camera_count);
+    mvmodel.animations.reserve(model.animation_count);
+    mvmodel.scenes.reserve(model.scene_count);
+}
+
+static void
+load_gltf_hierarchy(mvGraphics& graphics, mvModel& mvmodel, sGLTFModel& model)
+{
     for (unsigned int currentCamera = 0u; currentCamera < model.camera_count; currentCamera++)
     {
         sGLTFCamera& glcamera = model.cameras[currentCamera];
@@ -1416,14 +2082,7 @@ load_gltf_assets(mvGraphics& graphics, sGLTFModel& model)
             camera.height = glcamera.orthographic.ymag * 2.0f;
         }
 
-        mvmodel.cameras.push_back(camera);
-    }
-
-
-    for (int i = 0; i < 3; i++)
-    {
-        mvmodel.minBoundary[i] = minBoundary[i];
-        mvmodel.maxBoundary[i] = maxBoundary[i];
+        mvmodel.cameras.push_back(std::move(camera));
     }
 
     // updates based on correct offset mapping
@@ -1451,13 +2110,13 @@ load_gltf_assets(mvGraphics& graphics, sGLTFModel& model)
             if (camera.type == MV_CAMERA_PERSPECTIVE)
             {
                 mvMesh frustum1 = create_frustum2(graphics, camera.fieldOfView * 180.0f / S_PI, camera.aspectRatio, camera.nearZ, camera.farZ);
-                mvmodel.meshes.push_back(frustum1);
+                mvmodel.meshes.push_back(std::move(frustum1));
                 node.mesh = mvmodel.meshes.size() - 1;
             }
             else
             {
                 mvMesh frustum1 = create_ortho_frustum(graphics, camera.width, camera.height, camera.nearZ, camera.farZ);
-                mvmodel.meshes.push_back(frustum1);
+                mvmodel.meshes.push_back(std::move(frustum1));
                 node.mesh = mvmodel.meshes.size() - 1;
             }
         }
@@ -1470,25 +2129,269 @@ load_gltf_assets(mvGraphics& graphics, sGLTFModel& model)
         sGLTFScene& glscene = model.scenes[currentScene];
 
         mvScene newScene{};
+        newScene.nodeOffset = (unsigned int)mvmodel.nodeIndices.size();
         newScene.nodeCount = glscene.node_count;
+        mvmodel.nodeIndices.insert(mvmodel.nodeIndices.end(), glscene.nodes, glscene.nodes + glscene.node_count);
 
-        for (int i = 0; i < glscene.node_count; i++)
-            newScene.nodes[i] = glscene.nodes[i];
-
-
-        mvmodel.scenes.push_back(newScene);
+        mvmodel.scenes.push_back(std::move(newScene));
 
         if (currentScene == model.scene)
             defaultScene = mvmodel.scenes.size()-1;
     }
 
     mvmodel.defaultScene = defaultScene;
+}
+
+static void
+finish_gltf_assets(mvGraphics& graphics, mvModel& mvmodel, bool batchStatic)
+{
+    if (batchStatic)
+    {
+        batch_static_geometry(graphics, mvmodel);
+
+        // geometry is on the GPU now
+        for (unsigned int i = 0; i < mvmodel.meshes.size(); i++)
+        {
+            for (unsigned int j = 0; j < mvmodel.meshes[i].primitives.size(); j++)
+            {
+                mvMeshPrimitive& primitive = mvmodel.meshes[i].primitives[j];
+                std::vector<float>().swap(primitive.vertexData);
+                std::vector<unsigned int>().swap(primitive.indexData);
+            }
+        }
+    }
+
+    compute_model_footprint(graphics, mvmodel);
+}
+
+mvModel
+load_gltf_assets(mvGraphics& graphics, sGLTFModel& model, const char* path, bool batchStatic, bool bakeOcclusion)
+{
+    mvModel mvmodel{};
+    float maxBoundary[3] = { -FLT_MAX , -FLT_MAX , -FLT_MAX };
+    float minBoundary[3] = { FLT_MAX , FLT_MAX , FLT_MAX };
+    mvmodel.loaded = true;
+
+    mvJsonValue json;
+    std::vector<bool> instancedMeshes;
+    prepare_gltf_extensions(mvmodel, model, path, json, instancedMeshes);
+
+    load_gltf_skins(graphics, mvmodel, model);
+    load_gltf_meshes(graphics, mvmodel, model, minBoundary, maxBoundary, batchStatic, bakeOcclusion, instancedMeshes, get_json_member(json, "meshes"));
+    load_gltf_nodes(mvmodel, model);
+    load_gltf_instances(graphics, mvmodel, model, get_json_member(json, "nodes"), instancedMeshes);
+    load_gltf_animations(mvmodel, model);
+    load_gltf_hierarchy(graphics, mvmodel, model);
+
+    for (int i = 0; i < 3; i++)
+    {
+        mvmodel.minBoundary[i] = minBoundary[i];
+        mvmodel.maxBoundary[i] = maxBoundary[i];
+    }
+
+    finish_gltf_assets(graphics, mvmodel, batchStatic);
     return mvmodel;
 }
 
+static void
+load_primitive_bounds(sGLTFModel& model, sGLTFMeshPrimitive& glprimitive, mvMeshPrimitive& primitive)
+{
+    // accessor min/max is required for POSITION, no need to touch the buffers
+    for (unsigned int i = 0; i < glprimitive.attribute_count; i++)
+    {
+        auto& attribute = glprimitive.attributes[i];
+        if (strcmp(attribute.semantic, "POSITION") == 0)
+        {
+            sGLTFAccessor& accessor = model.accessors[attribute.index];
+            primitive.minBound = { accessor.mins[0], accessor.mins[1], accessor.mins[2] };
+            primitive.maxBound = { accessor.maxes[0], accessor.maxes[1], accessor.maxes[2] };
+        }
+    }
+}
+
+static void
+sort_load_tasks(mvProgressiveLoad& load, mvModel& mvmodel, std::vector<mvLoadTask>& tasks, sMat4 cam, sMat4 proj, float viewportHeight)
+{
+    // largest on screen from the current camera, across every node using the mesh
+    for (unsigned int i = 0; i < tasks.size(); i++)
+    {
+        mvLoadTask& task = tasks[i];
+        mvMeshPrimitive& primitive = mvmodel.meshes[task.mesh].primitives[task.primitive];
+        std::vector<mvAssetID>& nodes = load.meshNodes[task.mesh];
+
+        task.priority = 0.0f;
+        for (unsigned int j = 0; j < nodes.size(); j++)
+            task.priority = fmaxf(task.priority, get_projected_size(primitive, mvmodel.nodes[nodes[j]].worldTransform, cam, proj, viewportHeight));
+    }
+
+    // most important last, tasks are popped from the back
+    std::stable_sort(tasks.begin(), tasks.end(), [](const mvLoadTask& left, const mvLoadTask& right) {
+        return left.priority < right.priority;
+    });
+}
+
+void
+begin_progressive_load(mvGraphics& graphics, mvProgressiveLoad& load, mvModel& mvmodel, sGLTFModel& model, const char* path, bool batchStatic, bool bakeOcclusion)
+{
+    float maxBoundary[3] = { -FLT_MAX , -FLT_MAX , -FLT_MAX };
+    float minBoundary[3] = { FLT_MAX , FLT_MAX , FLT_MAX };
+    mvmodel.loaded = true;
+
+    load = {};
+    load.gltf = &model;
+    load.batchStatic = batchStatic;
+    load.bakeOcclusion = bakeOcclusion;
+    prepare_gltf_extensions(mvmodel, model, path, load.json, load.instancedMeshes);
+
+    load_gltf_skins(graphics, mvmodel, model);
+
+    // empty primitives, drawn as their bounding boxes until the geometry is in
+    for (unsigned int currentMesh = 0u; currentMesh < model.mesh_count; currentMesh++)
+    {
+        sGLTFMesh& glmesh = model.meshes[currentMesh];
+        mvmodel.meshes.push_back(create_gltf_mesh(graphics, glmesh));
+        mvmodel.meshes.back().primitives.resize(glmesh.primitives_count);
+
+        for (unsigned int currentPrimitive = 0u; currentPrimitive < glmesh.primitives_count; currentPrimitive++)
+        {
+            mvMeshPrimitive& primitive = mvmodel.meshes.back().primitives[currentPrimitive];
+            load_primitive_bounds(model, glmesh.primitives[currentPrimitive], primitive);
+            for (int i = 0; i < 3; i++)
+            {
+                if (primitive.minBound[i] < minBoundary[i]) minBoundary[i] = primitive.minBound[i];
+                if (primitive.maxBound[i] > maxBoundary[i]) maxBoundary[i] = primitive.maxBound[i];
+            }
+
+            mvLoadTask task{};
+            task.mesh = currentMesh;
+            task.primitive = currentPrimitive;
+            load.geometryTasks.push_back(task);
+        }
+    }
+    load.primitiveCount = load.geometryTasks.size();
+
+    load_gltf_nodes(mvmodel, model);
+    load_gltf_instances(graphics, mvmodel, model, get_json_member(load.json, "nodes"), load.instancedMeshes);
+    load_gltf_animations(mvmodel, model);
+    load_gltf_hierarchy(graphics, mvmodel, model);
+
+    for (int i = 0; i < 3; i++)
+    {
+        mvmodel.minBoundary[i] = minBoundary[i];
+        mvmodel.maxBoundary[i] = maxBoundary[i];
+    }
+
+    load.meshNodes.resize(model.mesh_count);
+    for (unsigned int currentNode = 0u; currentNode < model.node_count; currentNode++)
+    {
+        int mesh = model.nodes[currentNode].mesh_index;
+        if (mesh > -1)
+            load.meshNodes[mesh].push_back(currentNode);
+    }
+
+    load.phase = MV_LOAD_PHASE_GEOMETRY;
+}
+
+bool
+update_progressive_load(mvGraphics& graphics, mvProgressiveLoad& load, mvModel& mvmodel, sMat4 cam, sMat4 proj, float viewportHeight)
+{
+    if (load.phase == MV_LOAD_PHASE_IDLE)
+        return true;
+
+    auto start = std::chrono::steady_clock::now();
+    sGLTFModel& model = *load.gltf;
+
+    std::vector<mvLoadTask>& tasks = load.phase == MV_LOAD_PHASE_GEOMETRY ? load.geometryTasks : load.materialTasks;
+    sort_load_tasks(load, mvmodel, tasks, cam, proj, viewportHeight);
+
+    // at least one primitive per frame so huge ones can't stall the load
+    while (!tasks.empty())
+    {
+        mvLoadTask task = std::move(tasks.back());
+        tasks.pop_back();
+
+        mvMesh& mesh = mvmodel.meshes[task.mesh];
+        mvMeshPrimitive& primitive = mesh.primitives[task.primitive];
+        bool instanced = load.instancedMeshes[task.mesh];
+
+        if (load.phase == MV_LOAD_PHASE_GEOMETRY)
+        {
+            // boundaries were taken from the accessors up front
+            float maxBoundary[3] = { -FLT_MAX , -FLT_MAX , -FLT_MAX };
+            float minBoundary[3] = { FLT_MAX , FLT_MAX , FLT_MAX };
+            task.material = load_gltf_primitive_geometry(graphics, mvmodel, model, load.sharedGeometry, task.mesh, task.primitive, instanced, load.batchStatic, load.bakeOcclusion, minBoundary, maxBoundary);
+
+            // flat fallback until the real material is ready
+            primitive.materialID = load_gltf_material(graphics, mvmodel, model, -1, task.material, task.primitive, mesh.name, instanced);
+            load.materialTasks.push_back(std::move(task));
+            load.loadedGeometry++;
+        }
+        else
+        {
+            load_gltf_primitive_materials(graphics, mvmodel, model, get_json_member(load.json, "meshes"), task.mesh, task.primitive, task.material, instanced);
+            load.loadedMaterials++;
+        }
+
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= load.frameBudget)
+            break;
+    }
+
+    if (!tasks.empty())
+        return false;
+
+    if (load.phase == MV_LOAD_PHASE_GEOMETRY)
+    {
+        load.phase = MV_LOAD_PHASE_MATERIALS;
+        return false;
+    }
+
+    // a variant picked mid-load only reached primitives that were done
+    if (mvmodel.activeVariant != -1)
+        set_material_variant(mvmodel, mvmodel.activeVariant);
+
+    finish_gltf_assets(graphics, mvmodel, load.batchStatic);
+    load = {};
+    return true;
+}
+
+void
+cancel_progressive_load(mvGraphics& graphics, mvProgressiveLoad& load, mvModel& mvmodel)
+{
+    if (load.phase == MV_LOAD_PHASE_IDLE)
+        return;
+
+    // pending material templates hold no textures yet
+    unload_gltf_assets(graphics, mvmodel);
+    load = {};
+}
+
 void
-unload_gltf_assets(mvModel& model)
+unload_gltf_assets(mvGraphics& graphics, mvModel& model)
 {
+    for (unsigned int i = 0; i < model.meshes.size(); i++)
+    {
+        for (unsigned int j = 0; j < model.meshes[i].primitives.size(); j++)
+        {
+            mvMeshPrimitive& primitive = model.meshes[i].primitives[j];
+            release_geometry(graphics, primitive.geometryID);
+            delete[] primitive.morphData;
+        }
+    }
+
+    for (unsigned int i = 0; i < model.staticBatches.size(); i++)
+        release_geometry(graphics, model.staticBatches[i].primitive.geometryID);
+
+    for (unsigned int i = 0; i < model.animations.size(); i++)
+        delete[] model.animations[i].channels;
+
+    for (unsigned int i = 0; i < model.materialManager.materials.size(); i++)
+    {
+        release_material_textures(graphics, model.materialManager.materials[i].asset);
+        release_pipeline(graphics, model.materialManager.materials[i].asset.pendingPipeline);
+    }
+    clear_materials(&model.materialManager);
+
     model.loaded = false;
     model.defaultScene = -1;
     model.skins.clear();
@@ -1497,4 +2400,29 @@ unload_gltf_assets(mvModel& model)
     model.nodes.clear();
     model.animations.clear();
     model.scenes.clear();
-}
\ No newline at end of file
+    model.staticBatches.clear();
+    model.variants.clear();
+    model.activeVariant = -1;
+    model.cpuBytes = 0u;
+    model.gpuBytes = 0u;
+}
+
+void
+set_material_variant(mvModel& model, mvAssetID variant)
+{
+    model.activeVariant = variant;
+    for (unsigned int i = 0; i < model.meshes.size(); i++)
+    {
+        for (unsigned int j = 0; j < model.meshes[i].primitives.size(); j++)
+        {
+            mvMeshPrimitive& primitive = model.meshes[i].primitives[j];
+            if (primitive.variantMaterialIDs.empty())
+                continue;
+
+            mvAssetID materialID = -1;
+            if (variant > -1 && variant < (mvAssetID)primitive.variantMaterialIDs.size())
+                materialID = primitive.variantMaterialIDs[variant];
+            primitive.materialID = materialID == -1 ? primitive.defaultMaterialID : materialID;
+        }
+    }
+}
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <stdint.h>
 #include <vector>
+#include <unordered_map>
 #include "mvMaterials.h"
 #include "mvGraphics.h"
+#include "mvJson.h"
 
 // forward declarations
 struct sGLTFModel;
+struct sGLTFMesh;
 struct mvCamera;
 struct mvMesh;
 struct mvNode;
@@ -15,18 +19,94 @@ struct mvSkin;
 
 struct mvModel
 {
-    mvMaterialManager        materialManager;
-    bool                     loaded = false;
-    mvAssetID                defaultScene = -1;
-    std::vector<mvSkin>      skins;
-    std::vector<mvCamera>    cameras;
-    std::vector<mvMesh>      meshes;
-    std::vector<mvNode>      nodes;
-    std::vector<mvAnimation> animations;
-    std::vector<mvScene>     scenes;
-    float                    minBoundary[3];
-    float                    maxBoundary[3];
+    mvMaterialManager          materialManager;
+    bool                       loaded = false;
+    mvAssetID                  defaultScene = -1;
+    std::vector<mvSkin>        skins;
+    std::vector<mvCamera>      cameras;
+    std::vector<mvMesh>        meshes;
+    std::vector<mvNode>        nodes;
+    std::vector<mvAssetID>     nodeIndices;        // node children, scene roots and skin joints
+    std::vector<mvAnimation>   animations;
+    std::vector<mvScene>       scenes;
+    std::vector<mvStaticBatch> staticBatches;
+    std::vector<std::string>   variants;           // KHR_materials_variants names
+    mvAssetID                  activeVariant = -1; // -1 for default materials
+    float                      minBoundary[3];
+    float                      maxBoundary[3];
+    size_t                     cpuBytes = 0u; // system memory held after load
+    size_t                     gpuBytes = 0u; // buffers and non-streamed textures
+    unsigned int               sharedPrimitives = 0u; // primitives reusing another primitive's geometry
 };
 
-mvModel load_gltf_assets  (mvGraphics& graphics, sGLTFModel& model);
-void    unload_gltf_assets(mvModel& model);
\ No newline at end of file
+// CPU side of a primitive, exactly what load_gltf_assets uploads
+struct mvCookedPrimitive
+{
+    mvVertexLayout                layout;
+    std::vector<float>            vertexData;
+    std::vector<unsigned int>     indexData;
+    std::vector<unsigned int>     sourceIndexData;         // glTF indices, empty if not indexed
+    unsigned int                  sourceVertexCount = 0u;  // POSITION accessor count
+    int                           sourceIndexSize = 0;     // bytes per glTF index, 0 if not indexed
+    float*                        morphData = nullptr;     // caller owns (delete[])
+    unsigned int                  morphWidth = 0u;
+    unsigned int                  morphLayers = 0u;
+    std::vector<mvMorphAttribute> morphAttributes;         // for CPU pre-blending
+    sVec3                         minBound = { 0.0f, 0.0f, 0.0f };
+    sVec3                         maxBound = { 0.0f, 0.0f, 0.0f };
+    mvMaterial                    material;                // shader macros and layout, no textures
+};
+
+enum mvLoadPhase
+{
+    MV_LOAD_PHASE_IDLE,
+    MV_LOAD_PHASE_GEOMETRY,  // hierarchy and bounds are in, primitives upload
+    MV_LOAD_PHASE_MATERIALS, // primitives drawn with a fallback, textures and materials swap in
+};
+
+// first primitive cooked from a set of accessors, later matches retain its geometry
+struct mvSharedGeometry
+{
+    mvAssetID    mesh = -1;
+    unsigned int primitive = 0u;
+    mvMaterial   material; // template cooked with it
+};
+
+typedef std::unordered_map<uint64_t, mvSharedGeometry> mvSharedGeometryMap;
+
+struct mvLoadTask
+{
+    mvAssetID    mesh = -1;
+    unsigned int primitive = 0u;
+    float        priority = 0.0f; // projected size in pixels
+    mvMaterial   material;        // template from the geometry phase
+};
+
+struct mvProgressiveLoad
+{
+    mvLoadPhase                         phase = MV_LOAD_PHASE_IDLE;
+    sGLTFModel*                         gltf = nullptr; // owned by the caller, needed until the load finishes
+    mvJsonValue                         json;
+    std::vector<bool>                   instancedMeshes;
+    std::vector<std::vector<mvAssetID>> meshNodes;      // nodes using each mesh, for priorities
+    std::vector<mvLoadTask>             geometryTasks;
+    std::vector<mvLoadTask>             materialTasks;
+    mvSharedGeometryMap                 sharedGeometry;
+    bool                                batchStatic = false;
+    bool                                bakeOcclusion = false; // per primitive, meshes are not baked as a whole
+    float                               frameBudget = 4.0f; // milliseconds per update
+    unsigned int                        primitiveCount = 0u;
+    unsigned int                        loadedGeometry = 0u;
+    unsigned int                        loadedMaterials = 0u;
+};
+
+mvModel load_gltf_assets    (mvGraphics& graphics, sGLTFModel& model, const char* path, bool batchStatic = false, bool bakeOcclusion = false);
+void    unload_gltf_assets  (mvGraphics& graphics, mvModel& model);
+void    set_material_variant(mvModel& model, mvAssetID variant);
+void    cook_gltf_primitive (sGLTFModel& model, sGLTFMesh& glmesh, unsigned int currentPrimitive, bool instanced, mvCookedPrimitive& cooked);
+void    cook_gltf_material  (sGLTFModel& model, int materialIndex, mvMaterial& material); // factors and texture flags, -1 for the default material
+
+// progressive loading, model is usable (and drawn) from begin until update returns true
+void begin_progressive_load (mvGraphics& graphics, mvProgressiveLoad& load, mvModel& mvmodel, sGLTFModel& model, const char* path, bool batchStatic = false, bool bakeOcclusion = false);
+bool update_progressive_load(mvGraphics& graphics, mvProgressiveLoad& load, mvModel& mvmodel, sMat4 cam, sMat4 proj, float viewportHeight);
+void cancel_progressive_load(mvGraphics& graphics, mvProgressiveLoad& load, mvModel& mvmodel);
@@ -0,0 +1,136 @@
+#include "mvEnvironmentCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include "mvHash.h"
+
+struct mvEnvironmentCacheHeader
+{
+    char     magic[4];
+    int      version;
+    uint64_t key;
+    int      skyResolution;
+    int      resolution;
+    int      mipLevels;
+    int      padding;
+};
+
+static size_t
+get_specular_size(int resolution, int mipLevels)
+{
+    size_t size = 0u;
+    for (int i = 0; i < mipLevels; i++)
+    {
+        size_t width = resolution >> i;
+        size += 6u * width * width * 4u;
+    }
+    return size;
+}
+
+static bool
+read_floats(FILE* file, std::vector<float>& dst, size_t count)
+{
+    dst.resize(count);
+    return fread(dst.data(), sizeof(float), count, file) == count;
+}
+
+uint64_t
+get_environment_cache_key(const std::string& hdrPath, int resolution, int sampleCount, float lodBias, int mipLevels)
+{
+    uint64_t key = MV_HASH_SEED;
+
+    FILE* file = fopen(hdrPath.c_str(), "rb");
+    if (file)
+    {
+        unsigned char buffer[64 * 1024];
+        size_t count = 0u;
+        while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0u)
+            key = hash_bytes(buffer, count, key);
+        fclose(file);
+    }
+
+    int version = MV_ENVIRONMENT_CACHE_VERSION;
+    key = hash_bytes(&version, sizeof(int), key);
+    key = hash_bytes(&resolution, sizeof(int), key);
+    key = hash_bytes(&sampleCount, sizeof(int), key);
+    key = hash_bytes(&lodBias, sizeof(float), key);
+    key = hash_bytes(&mipLevels, sizeof(int), key);
+    return key;
+}
+
+std::string
+get_environment_cache_path(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.mvenv", (unsigned long long)key);
+    return std::string(MV_ENVIRONMENT_CACHE_DIRECTORY) + name;
+}
+
+bool
+load_environment_cache(const std::string& path, uint64_t key, mvEnvironmentBake& bake)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    mvEnvironmentCacheHeader header{};
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, "MVEC", 4) == 0
+        && header.version == MV_ENVIRONMENT_CACHE_VERSION
+        && header.key == key;
+
+    if (valid)
+    {
+        size_t skySize = 6u * header.skyResolution * header.skyResolution * 4u;
+        size_t irradianceSize = 6u * header.resolution * header.resolution * 4u;
+        size_t lutSize = (size_t)header.resolution * header.resolution * 4u;
+
+        bake.skyResolution = header.skyResolution;
+        bake.resolution = header.resolution;
+        bake.mipLevels = header.mipLevels;
+        valid = read_floats(file, bake.sky, skySize)
+            && read_floats(file, bake.irradiance, irradianceSize)
+            && read_floats(file, bake.specular, get_specular_size(header.resolution, header.mipLevels))
+            && read_floats(file, bake.brdfLUT, lutSize);
+    }
+
+    fclose(file);
+    return valid;
+}
+
+bool
+save_environment_cache(const std::string& path, uint64_t key, mvEnvironmentBake& bake)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    // write to a temporary so an interrupted save never leaves a truncated cache
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+
+    mvEnvironmentCacheHeader header{};
+    memcpy(header.magic, "MVEC", 4);
+    header.version = MV_ENVIRONMENT_CACHE_VERSION;
+    header.key = key;
+    header.skyResolution = bake.skyResolution;
+    header.resolution = bake.resolution;
+    header.mipLevels = bake.mipLevels;
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(bake.sky.data(), sizeof(float), bake.sky.size(), file) == bake.sky.size()
+        && fwrite(bake.irradiance.data(), sizeof(float), bake.irradiance.size(), file) == bake.irradiance.size()
+        && fwrite(bake.specular.data(), sizeof(float), bake.specular.size(), file) == bake.specular.size()
+        && fwrite(bake.brdfLUT.data(), sizeof(float), bake.brdfLUT.size(), file) == bake.brdfLUT.size();
+    fclose(file);
+
+    if (success)
+    {
+        std::filesystem::rename(tempPath, path, ec);
+        success = !ec;
+    }
+    if (!success)
+        std::filesystem::remove(tempPath, ec);
+    return success;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+// bump when the bake or the file layout changes
+#define MV_ENVIRONMENT_CACHE_VERSION 1
+#define MV_ENVIRONMENT_CACHE_DIRECTORY "../cache/environments/"
+
+// forward declarations
+struct mvEnvironmentBake;
+
+uint64_t    get_environment_cache_key (const std::string& hdrPath, int resolution, int sampleCount, float lodBias, int mipLevels);
+std::string get_environment_cache_path(uint64_t key);
+bool        load_environment_cache    (const std::string& path, uint64_t key, mvEnvironmentBake& bake);
+bool        save_environment_cache    (const std::string& path, uint64_t key, mvEnvironmentBake& bake);
+
+// CPU copy of everything create_environment bakes (RGBA32F texels)
+struct mvEnvironmentBake
+{
+    int                skyResolution = 0;
+    int                resolution = 0;
+    int                mipLevels = 0;
+    std::vector<float> sky;        // 6 faces
+    std::vector<float> irradiance; // 6 faces
+    std::vector<float> specular;   // 6 faces per mip, mip 0 first
+    std::vector<float> brdfLUT;
+};
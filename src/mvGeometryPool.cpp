@@ -0,0 +1,342 @@
+#include "mvGeometryPool.h"
+#include <assert.h>
+#include <algorithm>
+#include "mvGraphics.h"
+
+static Microsoft::WRL::ComPtr<ID3D11Buffer>
+create_heap_buffer(mvGraphics& graphics, mvGeometryHeap& heap, unsigned int capacity)
+{
+    D3D11_BUFFER_DESC bufferDesc{};
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.CPUAccessFlags = 0u;
+    bufferDesc.ByteWidth = capacity * heap.stride;
+    bufferDesc.BindFlags = heap.bindFlags;
+    bufferDesc.StructureByteStride = 0u;
+    bufferDesc.MiscFlags = 0u;
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+    if (graphics.device.Get() == nullptr)
+        return buffer;
+    HRESULT hResult = graphics.device->CreateBuffer(&bufferDesc, nullptr, buffer.GetAddressOf());
+    assert(SUCCEEDED(hResult));
+    graphics.geometryPool.bufferAllocations++;
+    return buffer;
+}
+
+static void
+free_block(mvGeometryHeap& heap, unsigned int offset, unsigned int count)
+{
+    if (count == 0u)
+        return;
+
+    // insert sorted, merging with neighbours
+    size_t i = 0;
+    while (i < heap.freeBlocks.size() && heap.freeBlocks[i].offset < offset)
+        i++;
+    heap.freeBlocks.insert(heap.freeBlocks.begin() + i, { offset, count });
+
+    if (i + 1 < heap.freeBlocks.size() && heap.freeBlocks[i].offset + heap.freeBlocks[i].count == heap.freeBlocks[i + 1].offset)
+    {
+        heap.freeBlocks[i].count += heap.freeBlocks[i + 1].count;
+        heap.freeBlocks.erase(heap.freeBlocks.begin() + i + 1);
+    }
+    if (i > 0 && heap.freeBlocks[i - 1].offset + heap.freeBlocks[i - 1].count == heap.freeBlocks[i].offset)
+    {
+        heap.freeBlocks[i - 1].count += heap.freeBlocks[i].count;
+        heap.freeBlocks.erase(heap.freeBlocks.begin() + i);
+    }
+}
+
+static void
+grow_heap(mvGraphics& graphics, mvGeometryHeap& heap, unsigned int count)
+{
+    unsigned int capacity = heap.capacity * 2u;
+    while (capacity < heap.capacity + count)
+        capacity *= 2u;
+
+    // existing ranges keep their offsets
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = create_heap_buffer(graphics, heap, capacity);
+    if (buffer)
+        graphics.imDeviceContext->CopySubresourceRegion(buffer.Get(), 0u, 0u, 0u, 0u, heap.buffer.Get(), 0u, nullptr);
+
+    unsigned int oldCapacity = heap.capacity;
+    heap.buffer = buffer;
+    heap.capacity = capacity;
+    free_block(heap, oldCapacity, capacity - oldCapacity);
+}
+
+static unsigned int
+allocate_block(mvGraphics& graphics, mvGeometryHeap& heap, unsigned int count)
+{
+    if (count == 0u)
+        return 0u;
+
+    // first fit
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t i = 0; i < heap.freeBlocks.size(); i++)
+        {
+            mvGeometryBlock& block = heap.freeBlocks[i];
+            if (block.count < count)
+                continue;
+
+            unsigned int offset = block.offset;
+            block.offset += count;
+            block.count -= count;
+            if (block.count == 0u)
+                heap.freeBlocks.erase(heap.freeBlocks.begin() + i);
+            heap.used += count;
+            return offset;
+        }
+
+        grow_heap(graphics, heap, count);
+    }
+
+    assert(false && "geometry heap failed to grow");
+    return 0u;
+}
+
+static void
+upload_block(mvGraphics& graphics, mvGeometryHeap& heap, unsigned int offset, unsigned int count, void* data)
+{
+    if (count == 0u || heap.buffer.Get() == nullptr)
+        return;
+
+    D3D11_BOX box{};
+    box.left = offset * heap.stride;
+    box.right = (offset + count) * heap.stride;
+    box.top = 0u;
+    box.bottom = 1u;
+    box.front = 0u;
+    box.back = 1u;
+    graphics.imDeviceContext->UpdateSubresource(heap.buffer.Get(), 0u, &box, data, 0u, 0u);
+}
+
+static void
+defragment_heap(mvGraphics& graphics, mvGeometryHeap& heap, bool indexHeap, mvAssetID vertexHeap)
+{
+    mvGeometryPool& pool = graphics.geometryPool;
+
+    // live ranges in this heap, in buffer order
+    std::vector<mvAssetID> live;
+    for (int i = 0; i < pool.allocations.size(); i++)
+    {
+        mvGeometryAllocation& allocation = pool.allocations[i];
+        if (allocation.vertexHeap == -1)
+            continue;
+        if (indexHeap ? allocation.indexCount > 0u : allocation.vertexHeap == vertexHeap && allocation.vertexCount > 0u)
+            live.push_back(i);
+    }
+
+    std::sort(live.begin(), live.end(), [&](mvAssetID left, mvAssetID right) {
+        if (indexHeap)
+            return pool.allocations[left].indexOffset < pool.allocations[right].indexOffset;
+        return pool.allocations[left].vertexOffset < pool.allocations[right].vertexOffset;
+    });
+
+    // pack into a fresh buffer so source and destination never overlap
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = create_heap_buffer(graphics, heap, heap.capacity);
+    unsigned int offset = 0u;
+    for (size_t i = 0; i < live.size(); i++)
+    {
+        mvGeometryAllocation& allocation = pool.allocations[live[i]];
+        unsigned int& rangeOffset = indexHeap ? allocation.indexOffset : allocation.vertexOffset;
+        unsigned int rangeCount = indexHeap ? allocation.indexCount : allocation.vertexCount;
+
+        D3D11_BOX box{};
+        box.left = rangeOffset * heap.stride;
+        box.right = (rangeOffset + rangeCount) * heap.stride;
+        box.top = 0u;
+        box.bottom = 1u;
+        box.front = 0u;
+        box.back = 1u;
+        if (buffer)
+            graphics.imDeviceContext->CopySubresourceRegion(buffer.Get(), 0u, offset * heap.stride, 0u, 0u, heap.buffer.Get(), 0u, &box);
+
+        rangeOffset = offset;
+        offset += rangeCount;
+    }
+
+    heap.buffer = buffer;
+    heap.used = offset;
+    heap.freeBlocks.clear();
+    if (offset < heap.capacity)
+        heap.freeBlocks.push_back({ offset, heap.capacity - offset });
+
+    pool.defragmentations++;
+    reset_geometry_bindings(pool);
+}
+
+static void
+defragment_if_needed(mvGraphics& graphics, mvGeometryHeap& heap, bool indexHeap, mvAssetID vertexHeap)
+{
+    if (heap.freeBlocks.size() < 2)
+        return;
+
+    unsigned int totalFree = 0u;
+    unsigned int largestFree = 0u;
+    for (size_t i = 0; i < heap.freeBlocks.size(); i++)
+    {
+        totalFree += heap.freeBlocks[i].count;
+        if (heap.freeBlocks[i].count > largestFree)
+            largestFree = heap.freeBlocks[i].count;
+    }
+
+    float fragmentation = 1.0f - (float)largestFree / (float)totalFree;
+    if (fragmentation > graphics.geometryPool.defragmentThreshold)
+        defragment_heap(graphics, heap, indexHeap, vertexHeap);
+}
+
+static void
+init_heap(mvGraphics& graphics, mvGeometryHeap& heap, unsigned int stride, unsigned int capacity, D3D11_BIND_FLAG bindFlags)
+{
+    heap.stride = stride;
+    heap.capacity = capacity;
+    heap.used = 0u;
+    heap.bindFlags = bindFlags;
+    heap.buffer = create_heap_buffer(graphics, heap, capacity);
+    heap.freeBlocks.clear();
+    heap.freeBlocks.push_back({ 0u, capacity });
+}
+
+mvAssetID
+allocate_geometry(mvGraphics& graphics, mvVertexLayout& layout, void* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount)
+{
+    mvGeometryPool& pool = graphics.geometryPool;
+
+    if (pool.indexHeap.capacity == 0u)
+        init_heap(graphics, pool.indexHeap, sizeof(unsigned int), pool.initialIndexCapacity, D3D11_BIND_INDEX_BUFFER);
+
+    // find the heap for this layout
+    mvAssetID vertexHeap = -1;
+    for (int i = 0; i < pool.vertexHeaps.size(); i++)
+    {
+        if (pool.vertexHeaps[i].stride == layout.size && pool.vertexHeaps[i].formats == layout.formats)
+        {
+            vertexHeap = i;
+            break;
+        }
+    }
+    if (vertexHeap == -1)
+    {
+        pool.vertexHeaps.push_back({});
+        vertexHeap = (mvAssetID)pool.vertexHeaps.size() - 1;
+        pool.vertexHeaps.back().formats = layout.formats;
+        init_heap(graphics, pool.vertexHeaps.back(), layout.size, pool.initialVertexCapacity, D3D11_BIND_VERTEX_BUFFER);
+    }
+
+    mvAssetID id = -1;
+    for (int i = 0; i < pool.allocations.size(); i++)
+    {
+        if (pool.allocations[i].vertexHeap == -1)
+        {
+            id = i;
+            break;
+        }
+    }
+    if (id == -1)
+    {
+        pool.allocations.push_back({});
+        id = (mvAssetID)pool.allocations.size() - 1;
+    }
+
+    mvGeometryHeap& heap = pool.vertexHeaps[vertexHeap];
+    mvGeometryAllocation& allocation = pool.allocations[id];
+    allocation.vertexHeap = vertexHeap;
+    allocation.vertexCount = vertexCount;
+    allocation.indexCount = indexCount;
+    allocation.refCount = 1u;
+    allocation.vertexOffset = allocate_block(graphics, heap, vertexCount);
+    allocation.indexOffset = allocate_block(graphics, pool.indexHeap, indexCount);
+    upload_block(graphics, heap, allocation.vertexOffset, vertexCount, vertices);
+    upload_block(graphics, pool.indexHeap, allocation.indexOffset, indexCount, indices);
+
+    // buffers may have been recreated while growing
+    reset_geometry_bindings(pool);
+    return id;
+}
+
+void
+retain_geometry(mvGraphics& graphics, mvAssetID id)
+{
+    if (id == -1)
+        return;
+
+    mvGeometryAllocation& allocation = graphics.geometryPool.allocations[id];
+    assert(allocation.vertexHeap != -1);
+    allocation.refCount++;
+}
+
+void
+release_geometry(mvGraphics& graphics, mvAssetID id)
+{
+    if (id == -1)
+        return;
+
+    mvGeometryPool& pool = graphics.geometryPool;
+    mvGeometryAllocation& allocation = pool.allocations[id];
+    assert(allocation.vertexHeap != -1 && allocation.refCount > 0u);
+    if (--allocation.refCount > 0u)
+        return;
+
+    mvAssetID vertexHeap = allocation.vertexHeap;
+    free_block(pool.vertexHeaps[vertexHeap], allocation.vertexOffset, allocation.vertexCount);
+    free_block(pool.indexHeap, allocation.indexOffset, allocation.indexCount);
+    pool.vertexHeaps[vertexHeap].used -= allocation.vertexCount;
+    pool.indexHeap.used -= allocation.indexCount;
+    allocation = {};
+
+    defragment_if_needed(graphics, pool.vertexHeaps[vertexHeap], false, vertexHeap);
+    defragment_if_needed(graphics, pool.indexHeap, true, -1);
+}
+
+void
+update_geometry(mvGraphics& graphics, mvAssetID id, void* vertices)
+{
+    mvGeometryPool& pool = graphics.geometryPool;
+    mvGeometryAllocation& allocation = pool.allocations[id];
+    upload_block(graphics, pool.vertexHeaps[allocation.vertexHeap], allocation.vertexOffset, allocation.vertexCount, vertices);
+}
+
+void
+bind_geometry(mvGraphics& graphics, mvAssetID id)
+{
+    mvGeometryPool& pool = graphics.geometryPool;
+    mvGeometryHeap& heap = pool.vertexHeaps[pool.allocations[id].vertexHeap];
+
+    if (pool.boundVertexBuffer != heap.buffer.Get())
+    {
+        static const UINT offset = 0u;
+        graphics.imDeviceContext->IASetVertexBuffers(0u, 1u, heap.buffer.GetAddressOf(), &heap.stride, &offset);
+        pool.boundVertexBuffer = heap.buffer.Get();
+        pool.binds++;
+    }
+    else
+        pool.bindsSkipped++;
+
+    if (pool.boundIndexBuffer != pool.indexHeap.buffer.Get())
+    {
+        graphics.imDeviceContext->IASetIndexBuffer(pool.indexHeap.buffer.Get(), DXGI_FORMAT_R32_UINT, 0u);
+        pool.boundIndexBuffer = pool.indexHeap.buffer.Get();
+        pool.binds++;
+    }
+    else
+        pool.bindsSkipped++;
+}
+
+void
+reset_geometry_bindings(mvGeometryPool& pool)
+{
+    pool.boundVertexBuffer = nullptr;
+    pool.boundIndexBuffer = nullptr;
+}
+
+unsigned int
+get_geometry_size(mvGeometryPool& pool, mvAssetID id)
+{
+    if (id == -1)
+        return 0u;
+
+    mvGeometryAllocation& allocation = pool.allocations[id];
+    return allocation.vertexCount * pool.vertexHeaps[allocation.vertexHeap].stride + allocation.indexCount * sizeof(unsigned int);
+}
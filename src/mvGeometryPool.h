@@ -0,0 +1,73 @@
+#pragma once
+
+#include "mvWindows.h"
+#include <d3d11.h>
+#include <wrl.h>
+#include <vector>
+
+typedef int mvAssetID;
+
+// forward declarations
+struct mvGraphics;
+struct mvVertexLayout;
+struct mvGeometryBlock;
+struct mvGeometryHeap;
+struct mvGeometryAllocation;
+struct mvGeometryPool;
+
+mvAssetID    allocate_geometry      (mvGraphics& graphics, mvVertexLayout& layout, void* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount);
+void         retain_geometry        (mvGraphics& graphics, mvAssetID id);
+void         release_geometry       (mvGraphics& graphics, mvAssetID id); // frees on the last reference
+void         bind_geometry          (mvGraphics& graphics, mvAssetID id);
+void         update_geometry        (mvGraphics& graphics, mvAssetID id, void* vertices); // whole vertex range
+void         reset_geometry_bindings(mvGeometryPool& pool);
+unsigned int get_geometry_size      (mvGeometryPool& pool, mvAssetID id);
+
+struct mvGeometryBlock
+{
+    unsigned int offset = 0u; // in elements
+    unsigned int count = 0u;
+};
+
+struct mvGeometryHeap
+{
+    std::vector<DXGI_FORMAT>             formats;      // vertex layout served by this heap
+    unsigned int                         stride = 0u;  // bytes per element
+    unsigned int                         capacity = 0u;
+    unsigned int                         used = 0u;
+    D3D11_BIND_FLAG                      bindFlags = D3D11_BIND_VERTEX_BUFFER;
+    std::vector<mvGeometryBlock>         freeBlocks;   // sorted by offset, never adjacent
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+};
+
+struct mvGeometryAllocation
+{
+    mvAssetID    vertexHeap = -1; // -1 marks a free slot
+    unsigned int vertexOffset = 0u;
+    unsigned int vertexCount = 0u;
+    unsigned int indexOffset = 0u;
+    unsigned int indexCount = 0u;
+    unsigned int refCount = 0u;   // primitives drawing from this range
+};
+
+struct mvGeometryPool
+{
+    std::vector<mvGeometryHeap>       vertexHeaps; // one per vertex layout
+    mvGeometryHeap                    indexHeap;
+    std::vector<mvGeometryAllocation> allocations;
+
+    // settings
+    unsigned int initialVertexCapacity = 64u * 1024u;  // vertices
+    unsigned int initialIndexCapacity = 256u * 1024u;  // indices
+    float        defragmentThreshold = 0.5f;           // 1 - largest free block / total free
+
+    // currently bound, draws from the same heaps skip the rebind
+    ID3D11Buffer* boundVertexBuffer = nullptr;
+    ID3D11Buffer* boundIndexBuffer = nullptr;
+
+    // stats
+    unsigned int bufferAllocations = 0u;
+    unsigned int defragmentations = 0u;
+    unsigned int binds = 0u;
+    unsigned int bindsSkipped = 0u;
+};
@@ -8,6 +8,8 @@
 #include "mvAssetLoader.h"
 #include "mvAnimation.h"
 #include "mvViewport.h"
+#include "mvEnvironmentCache.h"
+#include "mvPipelineCompiler.h"
 
 #define S_GLTF_IMPLEMENTATION
 #include "sGltf.h"
@@ -120,6 +122,16 @@ setup_graphics(mvViewport& viewport, const char* shaderDirectory)
 	return graphics;
 }
 
+mvGraphics
+setup_headless_graphics(const char* shaderDirectory)
+{
+    // the loader still cooks, decodes and compiles everything, only the D3D calls are skipped
+    mvGraphics graphics{};
+    graphics.shaderDirectory = shaderDirectory;
+    graphics.threadID = std::this_thread::get_id();
+    return graphics;
+}
+
 void
 recreate_swapchain(mvGraphics& graphics, unsigned width, unsigned height)
 {
@@ -176,20 +188,57 @@ recreate_swapchain(mvGraphics& graphics, unsigned width, unsigned height)
     }
 }
 
+unsigned
+get_lighting_flags(mvGraphics& graphics)
+{
+    unsigned flags = 0u;
+    if (graphics.imageBasedLighting) flags |= MV_LIGHTING_IBL;
+    if (graphics.punctualLighting)   flags |= MV_LIGHTING_PUNCTUAL;
+    if (graphics.clearcoat)          flags |= MV_LIGHTING_CLEARCOAT;
+    return flags;
+}
+
 void 
 set_pipeline_state(mvGraphics& graphics, mvPipeline& pipeline)
 {
     auto device = graphics.imDeviceContext;
-    device->IASetPrimitiveTopology(pipeline.topology);
-    device->RSSetState(pipeline.rasterizationState.Get());
-    device->OMSetBlendState(pipeline.blendState.Get(), nullptr, 0xFFFFFFFFu);
-    device->OMSetDepthStencilState(pipeline.depthStencilState.Get(), 0xFF);;
-    device->IASetInputLayout(pipeline.inputLayout.Get());
-    device->VSSetShader(pipeline.vertexShader.Get(), nullptr, 0);
-    device->PSSetShader(pipeline.pixelShader.Get(), nullptr, 0);
-    device->HSSetShader(nullptr, nullptr, 0);
-    device->DSSetShader(nullptr, nullptr, 0);
-    device->GSSetShader(nullptr, nullptr, 0);
+    mvStateCache& cache = graphics.stateCache;
+
+    // cached states are shared, so while tracking only bind what changed
+    if (!cache.valid)
+    {
+        device->IASetPrimitiveTopology(pipeline.topology);
+        device->RSSetState(pipeline.rasterizationState.Get());
+        device->OMSetBlendState(pipeline.blendState.Get(), nullptr, 0xFFFFFFFFu);
+        device->OMSetDepthStencilState(pipeline.depthStencilState.Get(), 0xFF);
+        device->IASetInputLayout(pipeline.inputLayout.Get());
+        device->VSSetShader(pipeline.vertexShader.Get(), nullptr, 0);
+        device->PSSetShader(pipeline.pixelShader.Get(), nullptr, 0);
+        device->HSSetShader(nullptr, nullptr, 0);
+        device->DSSetShader(nullptr, nullptr, 0);
+        device->GSSetShader(nullptr, nullptr, 0);
+        cache.valid = cache.tracking;
+    }
+    else
+    {
+        unsigned int skipped = 0u;
+        if (cache.topology != pipeline.topology) device->IASetPrimitiveTopology(pipeline.topology); else skipped++;
+        if (cache.rasterizerState != pipeline.rasterizationState.Get()) device->RSSetState(pipeline.rasterizationState.Get()); else skipped++;
+        if (cache.blendState != pipeline.blendState.Get()) device->OMSetBlendState(pipeline.blendState.Get(), nullptr, 0xFFFFFFFFu); else skipped++;
+        if (cache.depthStencilState != pipeline.depthStencilState.Get()) device->OMSetDepthStencilState(pipeline.depthStencilState.Get(), 0xFF); else skipped++;
+        if (cache.inputLayout != pipeline.inputLayout.Get()) device->IASetInputLayout(pipeline.inputLayout.Get()); else skipped++;
+        if (cache.vertexShader != pipeline.vertexShader.Get()) device->VSSetShader(pipeline.vertexShader.Get(), nullptr, 0); else skipped++;
+        if (cache.pixelShader != pipeline.pixelShader.Get()) device->PSSetShader(pipeline.pixelShader.Get(), nullptr, 0); else skipped++;
+        cache.bindsSkipped += skipped;
+    }
+
+    cache.topology = pipeline.topology;
+    cache.rasterizerState = pipeline.rasterizationState.Get();
+    cache.blendState = pipeline.blendState.Get();
+    cache.depthStencilState = pipeline.depthStencilState.Get();
+    cache.inputLayout = pipeline.inputLayout.Get();
+    cache.vertexShader = pipeline.vertexShader.Get();
+    cache.pixelShader = pipeline.pixelShader.Get();
 }
 
 mvRendererContext
@@ -269,6 +318,7 @@ create_renderer_context(mvGraphics& graphics)
 
         ctx.solidWireframePipeline.info.layout = create_vertex_layout({Position3D});
 
+        ctx.boundsMesh = create_bounds_box(graphics);
     }
 
     {
@@ -370,7 +420,7 @@ create_renderer_context(mvGraphics& graphics)
 }
 
 static void
-submit_mesh(mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, mvMesh& mesh, sMat4 transform, mvSkin* skin)
+submit_mesh(mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, mvMesh& mesh, sMat4 transform, mvSkin* skin, mvNode& node)
 {
     auto device = graphics.imDeviceContext;
 
@@ -378,21 +428,25 @@ submit_mesh(mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, mvMesh
     {
         mvMeshPrimitive& primitive = mesh.primitives[i];
 
-        // if material not assigned, get material
+        // still loading, show its bounds
         if (primitive.materialID == -1)
         {
-            assert(false && "material not assigned");
+            sVec3 extent = { primitive.maxBound.x - primitive.minBound.x, primitive.maxBound.y - primitive.minBound.y, primitive.maxBound.z - primitive.minBound.z };
+            sMat4 boundsTransform = transform * Semper::translate(primitive.minBound) * Semper::scale(extent.x, extent.y, extent.z);
+            ctx.wireframeJobs.push_back({ &ctx.boundsMesh.primitives[0], boundsTransform });
+            continue;
         }
 
         mvMaterial* material = &model.materialManager.materials[primitive.materialID].asset;
 
-        if(mesh.morphBuffer.buffer)
-            update_const_buffer(graphics, mesh.morphBuffer, mesh.weightsAnimated.data());
+        mvRenderJob job{ &primitive, transform, skin, mesh.morphBuffer.buffer };
+        job.instanceBuffer = node.instanceBuffer.Get();
+        job.instanceCount = node.instanceCount;
 
         if (material->alphaMode == 2)
-            ctx.transparentJobs.push_back({ &primitive, transform, skin, mesh.morphBuffer.buffer });
+            ctx.transparentJobs.push_back(job);
         else
-            ctx.opaqueJobs.push_back({ &primitive, transform, skin, mesh.morphBuffer.buffer });
+            ctx.opaqueJobs.push_back(job);
     }
 }
 
@@ -406,8 +460,8 @@ submit_node(mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, mvNode
 
     if (node.skin != -1)
         skin = &model.skins[node.skin];
-    if (node.mesh > -1 && node.camera == -1)
-        submit_mesh(graphics, model, ctx, model.meshes[node.mesh], node.worldTransform, skin);
+    if (node.mesh > -1 && node.camera == -1 && !node.batched)
+        submit_mesh(graphics, model, ctx, model.meshes[node.mesh], node.worldTransform, skin, node);
     else if (node.camera > -1)
     {
         for (unsigned int i = 0; i < model.meshes[node.mesh].primitives.size(); i++)
@@ -419,7 +473,7 @@ submit_node(mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, mvNode
 
     for (unsigned int i = 0; i < node.childCount; i++)
     {
-        submit_node(graphics, model, ctx, model.nodes[node.children[i]], node.worldTransform);
+        submit_node(graphics, model, ctx, model.nodes[model.nodeIndices[node.childOffset + i]], node.worldTransform);
     }
 }
 
@@ -428,17 +482,20 @@ submit_scene(mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, mvSce
 {
     mvSkin* skin = nullptr;
 
+    // once per mesh, not per primitive or node
+    update_morph_targets(graphics, model);
+
     for (unsigned int i = 0; i < scene.nodeCount; i++)
     {
-        mvNode& rootNode = model.nodes[scene.nodes[i]];
+        mvNode& rootNode = model.nodes[model.nodeIndices[scene.nodeOffset + i]];
         rootNode.worldTransform = rootNode.transform;
         rootNode.inverseWorldTransform = Semper::invert(rootNode.worldTransform);
 
         if (rootNode.skin != -1)
             skin = &model.skins[rootNode.skin];
 
-        if (rootNode.mesh > -1 && rootNode.camera == -1)
-            submit_mesh(graphics, model, ctx, model.meshes[rootNode.mesh], rootNode.worldTransform, skin);
+        if (rootNode.mesh > -1 && rootNode.camera == -1 && !rootNode.batched)
+            submit_mesh(graphics, model, ctx, model.meshes[rootNode.mesh], rootNode.worldTransform, skin, rootNode);
         else if (rootNode.camera > -1)
         {
             for (unsigned int i = 0; i < model.meshes[rootNode.mesh].primitives.size(); i++)
@@ -450,13 +507,104 @@ submit_scene(mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, mvSce
 
         for (unsigned int j = 0; j < rootNode.childCount; j++)
         {
-            submit_node(graphics, model, ctx, model.nodes[rootNode.children[j]], rootNode.worldTransform);
+            submit_node(graphics, model, ctx, model.nodes[model.nodeIndices[rootNode.childOffset + j]], rootNode.worldTransform);
+        }
+    }
+
+    // static geometry, already in world space
+    mvAssetID sceneID = (mvAssetID)(&scene - model.scenes.data());
+    for (unsigned int i = 0; i < model.staticBatches.size(); i++)
+    {
+        mvStaticBatch& batch = model.staticBatches[i];
+        if (batch.scene != sceneID)
+            continue;
+
+        mvMaterial* material = &model.materialManager.materials[batch.primitive.materialID].asset;
+        if (material->alphaMode == 2)
+            ctx.transparentJobs.push_back({ &batch.primitive, sMat4(1.0f), nullptr, nullptr, &batch });
+        else
+            ctx.opaqueJobs.push_back({ &batch.primitive, sMat4(1.0f), nullptr, nullptr, &batch });
+    }
+}
+
+static ID3D11ShaderResourceView* const*
+get_texture_view(mvGraphics& graphics, mvTexture& texture)
+{
+    if (texture.streamID == -1)
+        return texture.textureView.GetAddressOf();
+    return get_streamed_view(graphics.textureStreamer, texture.streamID);
+}
+
+float
+get_projected_size(mvMeshPrimitive& primitive, sMat4 transform, sMat4 cam, sMat4 proj, float viewportHeight)
+{
+    sMat4 mvp = proj * cam * transform;
+
+    float minX = FLT_MAX;
+    float minY = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float maxY = -FLT_MAX;
+    for (int i = 0; i < 8; i++)
+    {
+        sVec4 corner = {
+            (i & 1) ? primitive.maxBound.x : primitive.minBound.x,
+            (i & 2) ? primitive.maxBound.y : primitive.minBound.y,
+            (i & 4) ? primitive.maxBound.z : primitive.minBound.z,
+            1.0f
+        };
+
+        sVec4 clip = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int c = 0; c < 4; c++)
+        {
+            clip.x += mvp[c][0] * corner[c];
+            clip.y += mvp[c][1] * corner[c];
+            clip.w += mvp[c][3] * corner[c];
         }
+
+        // camera inside or behind bounds, treat as full screen
+        if (clip.w <= 0.0001f)
+            return viewportHeight;
+
+        minX = fminf(minX, clip.x / clip.w);
+        minY = fminf(minY, clip.y / clip.w);
+        maxX = fmaxf(maxX, clip.x / clip.w);
+        maxY = fmaxf(maxY, clip.y / clip.w);
+    }
+
+    return fmaxf(maxX - minX, maxY - minY) * 0.5f * viewportHeight;
+}
+
+static bool
+is_box_visible(sVec3 minBound, sVec3 maxBound, sMat4 viewProj)
+{
+    // outside if every corner is beyond the same clip plane
+    int outside[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < 8; i++)
+    {
+        sVec4 clip = viewProj * sVec4{
+            (i & 1) ? maxBound.x : minBound.x,
+            (i & 2) ? maxBound.y : minBound.y,
+            (i & 4) ? maxBound.z : minBound.z,
+            1.0f };
+
+        if (clip.x < -clip.w) outside[0]++;
+        if (clip.x > clip.w)  outside[1]++;
+        if (clip.y < -clip.w) outside[2]++;
+        if (clip.y > clip.w)  outside[3]++;
+        if (clip.z < 0.0f)    outside[4]++;
+        if (clip.z > clip.w)  outside[5]++;
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (outside[i] == 8)
+            return false;
     }
+    return true;
 }
 
 static void
-render_job(mvGraphics& graphics, mvModel& model, mvRenderJob& job, sMat4 cam, sMat4 proj)
+render_job(mvGraphics& graphics, mvModel& model, mvRenderJob& job, sMat4 cam, sMat4 proj, float viewportHeight)
 {
     auto device = graphics.imDeviceContext;
 
@@ -464,50 +612,76 @@ render_job(mvGraphics& graphics, mvModel& model, mvRenderJob& job, sMat4 cam, sM
 
     mvMaterial* material = &model.materialManager.materials[primitive.materialID].asset;
 
+    // swap in the compiled pipeline once a worker has finished it
+    if (material->pendingPipeline != 0u && poll_pipeline(graphics, material->pendingPipeline, material->pipeline))
+        material->pendingPipeline = 0u;
+
     if (material->pipeline.info.layout != primitive.layout)
     {
         assert(false && "Mesh and material vertex layouts don't match.");
         return;
     }
 
+    // its shaders failed to compile
+    if (material->pipeline.vertexShader.Get() == nullptr)
+        return;
+
     // pipeline
     set_pipeline_state(graphics, material->pipeline);
-    
-    device->PSSetSamplers(0, 1, primitive.albedoTexture.sampler.GetAddressOf());
-    device->PSSetSamplers(1, 1, primitive.normalTexture.sampler.GetAddressOf());
-    device->PSSetSamplers(2, 1, primitive.metalRoughnessTexture.sampler.GetAddressOf());
-    device->PSSetSamplers(3, 1, primitive.emissiveTexture.sampler.GetAddressOf());
-    device->PSSetSamplers(4, 1, primitive.occlusionTexture.sampler.GetAddressOf());
-    device->PSSetSamplers(5, 1, primitive.clearcoatTexture.sampler.GetAddressOf());
-    device->PSSetSamplers(6, 1, primitive.clearcoatRoughnessTexture.sampler.GetAddressOf());
-    device->PSSetSamplers(7, 1, primitive.clearcoatNormalTexture.sampler.GetAddressOf());
-
-
-    static ID3D11SamplerState* emptySamplers = nullptr;
-    device->VSSetSamplers(0, 1, job.skin ? job.skin->jointTexture.sampler.GetAddressOf() : &emptySamplers);
-    device->VSSetSamplers(1, 1, primitive.morphTexture.sampler.GetAddressOf());
-
-    // maps
-    ID3D11ShaderResourceView* const pSRV[1] = { NULL };
-    device->PSSetShaderResources(0, 1, primitive.albedoTexture.textureView.GetAddressOf());
-    device->PSSetShaderResources(1, 1, primitive.normalTexture.textureView.GetAddressOf());
-    device->PSSetShaderResources(2, 1, primitive.metalRoughnessTexture.textureView.GetAddressOf());
-    device->PSSetShaderResources(3, 1, primitive.emissiveTexture.textureView.GetAddressOf());
-    device->PSSetShaderResources(4, 1, primitive.occlusionTexture.textureView.GetAddressOf());
-    device->PSSetShaderResources(5, 1, primitive.clearcoatTexture.textureView.GetAddressOf());
-    device->PSSetShaderResources(6, 1, primitive.clearcoatRoughnessTexture.textureView.GetAddressOf());
-    device->PSSetShaderResources(7, 1, primitive.clearcoatNormalTexture.textureView.GetAddressOf());
-
-    device->VSSetShaderResources(0, 1, job.skin ? job.skin->jointTexture.textureView.GetAddressOf() : pSRV);
-    device->VSSetShaderResources(1, 1, primitive.morphTexture.textureView.GetAddressOf());
-
-    update_const_buffer(graphics, material->buffer, &material->data);
-    device->PSSetConstantBuffers(1u, 1u, material->buffer.buffer.GetAddressOf());
+
+    // request texture detail for next frame, instances can be anywhere so
+    // they get full detail
+    float screenSize = viewportHeight;
+    if (job.instanceBuffer == nullptr)
+        screenSize = get_projected_size(primitive, job.accumulatedTransform, cam, proj, viewportHeight);
+    mvTexture* textures[] = {
+        &material->albedoTexture, &material->normalTexture, &material->metalRoughnessTexture, &material->emissiveTexture,
+        &material->occlusionTexture, &material->clearcoatTexture, &material->clearcoatRoughnessTexture, &material->clearcoatNormalTexture };
+    for (int i = 0; i < 8; i++)
+    {
+        if (textures[i]->streamID != -1)
+            request_streamed_mip(graphics.textureStreamer, textures[i]->streamID, screenSize);
+    }
+
+    // maps, only the slots the permutation reads and only when the previous draw left something else there
+    mvStateCache& cache = graphics.stateCache;
+    const mvMaterialBindings& bindings = material->bindings;
+    for (unsigned int i = 0; i < bindings.pixelSlotCount; i++)
+    {
+        unsigned int slot = bindings.pixelSlots[i];
+        ID3D11ShaderResourceView* const* view = get_texture_view(graphics, *textures[slot]);
+        if (update_texture_slot(cache, cache.pixelSlots, slot, *view, textures[slot]->sampler.Get()))
+        {
+            device->PSSetShaderResources(slot, 1, view);
+            device->PSSetSamplers(slot, 1, textures[slot]->sampler.GetAddressOf());
+        }
+    }
+
+    if (bindings.joints)
+    {
+        ID3D11ShaderResourceView* view = job.skin ? job.skin->jointTexture.textureView.Get() : nullptr;
+        ID3D11SamplerState* sampler = job.skin ? job.skin->jointTexture.sampler.Get() : nullptr;
+        if (update_texture_slot(cache, cache.vertexSlots, 0u, view, sampler))
+        {
+            device->VSSetShaderResources(0, 1, &view);
+            device->VSSetSamplers(0, 1, &sampler);
+        }
+    }
+
+    if (bindings.morphTargets && update_texture_slot(cache, cache.vertexSlots, 1u, primitive.morphTexture.textureView.Get(), primitive.morphTexture.sampler.Get()))
+    {
+        device->VSSetShaderResources(1, 1, primitive.morphTexture.textureView.GetAddressOf());
+        device->VSSetSamplers(1, 1, primitive.morphTexture.sampler.GetAddressOf());
+    }
+
+    if (bindings.instances && update_texture_slot(cache, cache.vertexSlots, 2u, job.instanceBuffer, nullptr))
+        device->VSSetShaderResources(2, 1, &job.instanceBuffer);
 
     mvTransforms transforms{};
     transforms.model = job.accumulatedTransform;
     transforms.modelView = cam * transforms.model;
     transforms.modelViewProjection = proj * cam * transforms.model;
+    transforms.materialIndex = primitive.materialID;
 
     D3D11_MAPPED_SUBRESOURCE mappedSubresource;
     device->Map(graphics.tranformCBuf.Get(), 0u, D3D11_MAP_WRITE_DISCARD, 0u, &mappedSubresource);
@@ -521,11 +695,56 @@ render_job(mvGraphics& graphics, mvModel& model, mvRenderJob& job, sMat4 cam, sM
     {
         device->VSSetConstantBuffers(3u, 1u, job.morphBuffer.GetAddressOf());
     }
-    device->IASetIndexBuffer(primitive.indexBuffer.buffer.Get(), DXGI_FORMAT_R32_UINT, 0u);
-    device->IASetVertexBuffers(0u, 1u, primitive.vertexBuffer.buffer.GetAddressOf(), &material->pipeline.info.layout.size, &offset);
+
+    // pooled geometry draws from shared buffers at an offset
+    unsigned int indexStart = 0u;
+    int baseVertex = 0;
+    unsigned int indexCount = primitive.indexBuffer.size / sizeof(unsigned int);
+    if (primitive.geometryID != -1)
+    {
+        mvGeometryAllocation& allocation = graphics.geometryPool.allocations[primitive.geometryID];
+        bind_geometry(graphics, primitive.geometryID);
+        indexStart = allocation.indexOffset;
+        baseVertex = (int)allocation.vertexOffset;
+        indexCount = allocation.indexCount;
+    }
+    else
+    {
+        device->IASetIndexBuffer(primitive.indexBuffer.buffer.Get(), DXGI_FORMAT_R32_UINT, 0u);
+        device->IASetVertexBuffers(0u, 1u, primitive.vertexBuffer.buffer.GetAddressOf(), &material->pipeline.info.layout.size, &offset);
+        reset_geometry_bindings(graphics.geometryPool);
+    }
 
     // draw
-    device->DrawIndexed(primitive.indexBuffer.size / sizeof(unsigned int), 0u, 0u);
+    if (job.batch)
+    {
+        // cull source primitives, merging neighbouring visible ranges
+        sMat4 viewProj = proj * cam;
+        unsigned int drawOffset = 0u;
+        unsigned int drawCount = 0u;
+        for (unsigned int i = 0; i < job.batch->ranges.size(); i++)
+        {
+            mvBatchRange& range = job.batch->ranges[i];
+            if (!is_box_visible(range.minBound, range.maxBound, viewProj))
+                continue;
+
+            if (drawCount > 0u && drawOffset + drawCount == range.indexOffset)
+                drawCount += range.indexCount;
+            else
+            {
+                if (drawCount > 0u)
+                    device->DrawIndexed(drawCount, indexStart + drawOffset, baseVertex);
+                drawOffset = range.indexOffset;
+                drawCount = range.indexCount;
+            }
+        }
+        if (drawCount > 0u)
+            device->DrawIndexed(drawCount, indexStart + drawOffset, baseVertex);
+    }
+    else if (job.instanceBuffer)
+        device->DrawIndexedInstanced(indexCount, job.instanceCount, indexStart, baseVertex, 0u);
+    else
+        device->DrawIndexed(indexCount, indexStart, baseVertex);
 }
 
 static void
@@ -551,8 +770,19 @@ render_wireframe_job(mvGraphics& graphics, mvRendererContext& rendererCtx, mvMod
     // mesh
     static const UINT offset = 0u;
     device->VSSetConstantBuffers(0u, 1u, graphics.tranformCBuf.GetAddressOf());
+
+    // pooled geometry draws from shared buffers at an offset, like render_job
+    if (primitive.geometryID != -1)
+    {
+        mvGeometryAllocation& allocation = graphics.geometryPool.allocations[primitive.geometryID];
+        bind_geometry(graphics, primitive.geometryID);
+        device->DrawIndexed(allocation.indexCount, allocation.indexOffset, (int)allocation.vertexOffset);
+        return;
+    }
+
     device->IASetIndexBuffer(primitive.indexBuffer.buffer.Get(), DXGI_FORMAT_R32_UINT, 0u);
     device->IASetVertexBuffers(0u, 1u, primitive.vertexBuffer.buffer.GetAddressOf(), &rendererCtx.solidWireframePipeline.info.layout.size, &offset);
+    reset_geometry_bindings(graphics.geometryPool);
 
     // draw
     device->DrawIndexed(primitive.indexBuffer.size / sizeof(unsigned int), 0u, 0u);
@@ -561,19 +791,35 @@ render_wireframe_job(mvGraphics& graphics, mvRendererContext& rendererCtx, mvMod
 void 
 render_scenes(mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, sMat4 cam, sMat4 proj)
 {
+    // used for texture streaming priorities
+    UINT viewportCount = 1u;
+    D3D11_VIEWPORT viewport{};
+    graphics.imDeviceContext->RSGetViewports(&viewportCount, &viewport);
+
+    // other passes bind their own buffers and states
+    reset_geometry_bindings(graphics.geometryPool);
+    begin_state_tracking(graphics.stateCache);
+
+    // material parameters for every draw, the pixel shader picks its entry
+    // using the material index in the transform buffer
+    update_material_buffer(graphics, &model.materialManager);
+    graphics.imDeviceContext->PSSetShaderResources(15u, 1u, model.materialManager.dataBuffer.shaderResourceView.GetAddressOf());
+    graphics.imDeviceContext->PSSetConstantBuffers(4u, 1u, graphics.tranformCBuf.GetAddressOf());
+
     // opaque objects
     for (int i = 0; i < ctx.opaqueJobs.size(); i++)
-        render_job(graphics, model, ctx.opaqueJobs[i], cam, proj);
+        render_job(graphics, model, ctx.opaqueJobs[i], cam, proj, viewport.Height);
 
     // transparent objects
     for (int i = 0; i < ctx.transparentJobs.size(); i++)
-        render_job(graphics, model, ctx.transparentJobs[i], cam, proj);
+        render_job(graphics, model, ctx.transparentJobs[i], cam, proj, viewport.Height);
 
     // wireframe objects
     for (int i = 0; i < ctx.wireframeJobs.size(); i++)
         render_wireframe_job(graphics, ctx, model, ctx.wireframeJobs[i], cam, proj);
 
     // reset
+    end_state_tracking(graphics.stateCache);
     ctx.opaqueJobs.clear();
     ctx.transparentJobs.clear();
     ctx.wireframeJobs.clear();
@@ -673,6 +919,8 @@ create_buffer(mvGraphics& graphics, void* data, unsigned int size, D3D11_BIND_FL
 {
 	mvBuffer buffer{};
 	buffer.size = size;
+    if (graphics.device.Get() == nullptr)
+        return buffer;
 
     // Fill in a buffer description.
     D3D11_BUFFER_DESC bufferDesc{};
@@ -702,7 +950,7 @@ create_buffer(mvGraphics& graphics, void* data, unsigned int size, D3D11_BIND_FL
         assert(SUCCEEDED(hresult));
     }
 
-    if (stride != 0u)
+    if (stride != 0u && (flags & D3D11_BIND_UNORDERED_ACCESS))
     {
         D3D11_BUFFER_DESC descBuf;
         buffer.buffer->GetDesc(&descBuf);
@@ -719,6 +967,19 @@ create_buffer(mvGraphics& graphics, void* data, unsigned int size, D3D11_BIND_FL
         assert(SUCCEEDED(hresult));
     }
 
+    if (stride != 0u && (flags & D3D11_BIND_SHADER_RESOURCE))
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC descView = {};
+        descView.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        descView.Format = DXGI_FORMAT_UNKNOWN;
+        descView.Buffer.FirstElement = 0;
+        descView.Buffer.NumElements = size / stride;
+
+        hresult = graphics.device->CreateShaderResourceView(buffer.buffer.Get(),
+            &descView, buffer.shaderResourceView.GetAddressOf());
+        assert(SUCCEEDED(hresult));
+    }
+
 	return buffer;
 }
 
@@ -727,6 +988,8 @@ create_const_buffer(mvGraphics& graphics, void* data, unsigned int size)
 {
     mvConstBuffer buffer{};
     buffer.size = size;
+    if (graphics.device.Get() == nullptr)
+        return buffer;
 
     D3D11_BUFFER_DESC cbd;
     cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
@@ -751,6 +1014,8 @@ create_const_buffer(mvGraphics& graphics, void* data, unsigned int size)
 void
 update_const_buffer(mvGraphics& graphics, mvConstBuffer& buffer, void* data)
 {
+    if (buffer.buffer.Get() == nullptr)
+        return;
     D3D11_MAPPED_SUBRESOURCE mappedSubresource;
     graphics.imDeviceContext->Map(buffer.buffer.Get(), 0u, D3D11_MAP_WRITE_DISCARD, 0u, &mappedSubresource);
     memcpy(mappedSubresource.pData, data, buffer.size);
@@ -1109,6 +1374,52 @@ create_ortho_frustum(mvGraphics& graphics, float width, float height, float near
     return mesh;
 }
 
+mvMesh
+create_bounds_box(mvGraphics& graphics)
+{
+    mvVertexLayout layout = create_vertex_layout(
+        {
+            Position3D
+        }
+    );
+
+    auto vertices = std::vector<float>{
+        0.0f, 0.0f, 0.0f,
+        1.0f, 0.0f, 0.0f,
+        1.0f, 1.0f, 0.0f,
+        0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 1.0f,
+        1.0f, 0.0f, 1.0f,
+        1.0f, 1.0f, 1.0f,
+        0.0f, 1.0f, 1.0f,
+    };
+
+    auto indices = std::vector<unsigned int>{
+        0, 1,
+        1, 2,
+        2, 3,
+        3, 0,
+        4, 5,
+        5, 6,
+        6, 7,
+        7, 4,
+        0, 4,
+        1, 5,
+        2, 6,
+        3, 7
+    };
+
+    mvMesh mesh{};
+
+    mesh.name = "bounds_box";
+    mesh.primitives.push_back({});
+    mesh.primitives.back().layout = layout;
+    mesh.primitives.back().vertexBuffer = create_buffer(graphics, vertices.data(), vertices.size() * sizeof(float), D3D11_BIND_VERTEX_BUFFER);
+    mesh.primitives.back().indexBuffer = create_buffer(graphics, indices.data(), indices.size() * sizeof(unsigned int), D3D11_BIND_INDEX_BUFFER);
+
+    return mesh;
+}
+
 mvTexture 
 create_texture(mvGraphics& graphics, unsigned int width, unsigned int height, unsigned int arraySize, float* data)
 {
@@ -1130,6 +1441,8 @@ create_texture(mvGraphics& graphics, unsigned int width, unsigned int height, un
 
 	//HRESULT hResult = graphics.device->CreateTexture2D(&textureDesc, nullptr, &texture.texture);
 	//assert(SUCCEEDED(hResult));
+	if (graphics.device.Get() == nullptr)
+		return texture;
 	int texBytesPerRow = 4 * width * sizeof(float);
 
 	// subresource data
@@ -1170,8 +1483,7 @@ create_texture(mvGraphics& graphics, unsigned int width, unsigned int height, un
 	samplerDesc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
 	samplerDesc.MinLOD = -FLT_MAX;
 	samplerDesc.MaxLOD = FLT_MAX;
-	hResult = graphics.device->CreateSamplerState(&samplerDesc, texture.sampler.GetAddressOf());
-	assert(SUCCEEDED(hResult));
+	texture.sampler = get_sampler_state(graphics, samplerDesc);
 
 	return texture;
 }
@@ -1194,6 +1506,8 @@ create_dynamic_texture(mvGraphics& graphics, unsigned int width, unsigned int he
 	textureDesc.Usage = D3D11_USAGE_DYNAMIC;
 	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 	textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (graphics.device.Get() == nullptr)
+		return texture;
 
 	HRESULT hResult = graphics.device->CreateTexture2D(&textureDesc, nullptr, textureResource.GetAddressOf());
 	assert(SUCCEEDED(hResult));
@@ -1221,8 +1535,7 @@ create_dynamic_texture(mvGraphics& graphics, unsigned int width, unsigned int he
 	samplerDesc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
 	samplerDesc.MinLOD = -FLT_MAX;
 	samplerDesc.MaxLOD = FLT_MAX;
-	hResult = graphics.device->CreateSamplerState(&samplerDesc, texture.sampler.GetAddressOf());
-	assert(SUCCEEDED(hResult));
+	texture.sampler = get_sampler_state(graphics, samplerDesc);
 
 	return texture;
 }
@@ -1230,6 +1543,9 @@ create_dynamic_texture(mvGraphics& graphics, unsigned int width, unsigned int he
 void
 update_dynamic_texture(mvGraphics& graphics, mvTexture& texture, unsigned int width, unsigned int height, float* data)
 {
+	if (texture.textureView.Get() == nullptr)
+		return;
+
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	ZeroMemory(&mappedResource, sizeof(D3D11_MAPPED_SUBRESOURCE));
 
@@ -1391,6 +1707,65 @@ create_texture(mvGraphics& graphics, const std::string& path)
     return texture;
 }
 
+mvTexture
+create_streamed_texture(mvGraphics& graphics, const std::string& path)
+{
+    mvTexture texture{};
+
+    // already decoded by another primitive/model
+    texture.streamID = find_streamed_texture(graphics.textureStreamer, path);
+    if (texture.streamID != -1)
+    {
+        retain_streamed_texture(graphics.textureStreamer, texture.streamID);
+        return texture;
+    }
+
+    if (!std::filesystem::exists(path))
+    {
+        assert(false && "File not found.");
+        return texture;
+    }
+
+    int texWidth, texHeight, texNumChannels;
+    unsigned char* testTextureBytes = stbi_load(path.c_str(), &texWidth, &texHeight, &texNumChannels, 4);
+    assert(testTextureBytes);
+
+    if (texNumChannels > 3)
+        texture.alpha = true;
+
+    texture.streamID = register_streamed_texture(graphics, path, testTextureBytes, texWidth, texHeight);
+
+    free(testTextureBytes);
+
+    return texture;
+}
+
+mvTexture
+create_streamed_texture(mvGraphics& graphics, const std::string& key, unsigned char* data, unsigned int dataSize)
+{
+    mvTexture texture{};
+
+    texture.streamID = find_streamed_texture(graphics.textureStreamer, key);
+    if (texture.streamID != -1)
+    {
+        retain_streamed_texture(graphics.textureStreamer, texture.streamID);
+        return texture;
+    }
+
+    int texWidth, texHeight, texNumChannels;
+    unsigned char* testTextureBytes = stbi_load_from_memory(data, dataSize, &texWidth, &texHeight, &texNumChannels, 4);
+    assert(testTextureBytes);
+
+    if (texNumChannels > 3)
+        texture.alpha = true;
+
+    texture.streamID = register_streamed_texture(graphics, key, testTextureBytes, texWidth, texHeight);
+
+    free(testTextureBytes);
+
+    return texture;
+}
+
 mvCubeTexture
 create_cube_texture(mvGraphics& graphics, const std::string& path)
 {
@@ -1581,7 +1956,7 @@ create_cube_texture(mvGraphics& graphics, const std::string& path)
 }
 
 static mvCubeTexture
-create_cube_map_from_hdr(mvGraphics& graphics, const std::string& path)
+create_cube_map_from_hdr(mvGraphics& graphics, const std::string& path, mvEnvironmentBake& bake)
 {
 	mvCubeTexture texture{};
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> textureResource;
@@ -1698,6 +2073,12 @@ create_cube_map_from_hdr(mvGraphics& graphics, const std::string& path)
 
 	graphics.device->CreateShaderResourceView(textureResource.Get(), &srvDesc, texture.textureView.GetAddressOf());
 
+	// keep a copy for the environment cache
+	bake.skyResolution = res;
+	bake.sky.resize(6 * res * res * 4);
+	for (int i = 0; i < 6; i++)
+		memcpy(&bake.sky[i * res * res * 4], surfaces[i], res * res * sizeof(float) * 4);
+
 	for (int i = 0; i < 6; i++)
 		delete[] surfaces[i];
 	return texture;
@@ -1875,7 +2256,7 @@ create_single_specular_map(mvGraphics& graphics, mvCubeTexture& cubemap, int res
 }
 
 static mvCubeTexture
-create_irradiance_map(mvGraphics& graphics, mvCubeTexture& cubemap, int resolution, int sampleCount, float lodBias)
+create_irradiance_map(mvGraphics& graphics, mvCubeTexture& cubemap, int resolution, int sampleCount, float lodBias, mvEnvironmentBake& bake)
 {
 
 	mvCubeTexture texture{};
@@ -1996,20 +2377,111 @@ create_irradiance_map(mvGraphics& graphics, mvCubeTexture& cubemap, int resoluti
 	graphics.device->CreateTexture2D(&textureDesc, data, textureResource.GetAddressOf());
 	graphics.device->CreateShaderResourceView(textureResource.Get(), &srvDesc, texture.textureView.GetAddressOf());
 
+	// keep a copy for the environment cache
+	bake.irradiance.resize(6 * resolution * resolution * 4);
+	for (int i = 0; i < 6; i++)
+		memcpy(&bake.irradiance[i * resolution * resolution * 4], surfaces[i], resolution * resolution * sizeof(float) * 4);
+
 	for (int i = 0; i < 6; i++)
 		delete[] surfaces[i];
 	return texture;
 
 }
 
+static mvTexture
+create_brdf_lut(mvGraphics& graphics, int width, float* data)
+{
+	mvTexture texture{};
+
+	// Create Texture
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = width;
+	textureDesc.Height = width;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.CPUAccessFlags = 0;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> textureResource;
+	HRESULT hResult = graphics.device->CreateTexture2D(&textureDesc, nullptr, textureResource.GetAddressOf());
+	assert(SUCCEEDED(hResult));
+	graphics.imDeviceContext->UpdateSubresource(textureResource.Get(), 0u, nullptr, data, 4 * width * sizeof(float), 0u);
+
+	// create the resource view on the texture
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = textureDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = -1;
+
+	hResult = graphics.device->CreateShaderResourceView(textureResource.Get(), &srvDesc, texture.textureView.GetAddressOf());
+	assert(SUCCEEDED(hResult));
+
+	return texture;
+}
+
+static mvCubeTexture
+create_cube_map_from_bake(mvGraphics& graphics, int width, int mipLevels, float* data, ID3D11Texture2D** resource)
+{
+	mvCubeTexture texture{};
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = width;
+	textureDesc.Height = width;
+	textureDesc.MipLevels = mipLevels;
+	textureDesc.ArraySize = 6;
+	textureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	// baked data is stored mip by mip, subresources are face by face
+	std::vector<D3D11_SUBRESOURCE_DATA> sdata(6 * mipLevels);
+	float* mipData = data;
+	for (int mip = 0; mip < mipLevels; mip++)
+	{
+		int mipWidth = width >> mip;
+		for (int face = 0; face < 6; face++)
+		{
+			D3D11_SUBRESOURCE_DATA& subresource = sdata[D3D11CalcSubresource(mip, face, mipLevels)];
+			subresource.pSysMem = &mipData[face * mipWidth * mipWidth * 4];
+			subresource.SysMemPitch = mipWidth * 4 * sizeof(float);
+			subresource.SysMemSlicePitch = 0;
+		}
+		mipData += 6 * mipWidth * mipWidth * 4;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> textureResource;
+	HRESULT hResult = graphics.device->CreateTexture2D(&textureDesc, sdata.data(), textureResource.GetAddressOf());
+	assert(SUCCEEDED(hResult));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = textureDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+	srvDesc.TextureCube.MipLevels = mipLevels;
+
+	hResult = graphics.device->CreateShaderResourceView(textureResource.Get(), &srvDesc, texture.textureView.GetAddressOf());
+	assert(SUCCEEDED(hResult));
+
+	if (resource)
+		*resource = textureResource.Detach();
+	return texture;
+}
+
 mvEnvironment 
 create_environment(mvGraphics& graphics, const std::string& path, int resolution, int sampleCount, float lodBias, int mipLevels)
 {
 
     mvEnvironment environment{};
 
-	environment.skyMap = create_cube_map_from_hdr(graphics, path);
-
     // create environment sampler
     D3D11_SAMPLER_DESC envSamplerDesc{};
     envSamplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -2030,8 +2502,36 @@ create_environment(mvGraphics& graphics, const std::string& path, int resolution
 	brdfLutSamplerDesc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
 	graphics.device->CreateSamplerState(&brdfLutSamplerDesc, environment.brdfSampler.GetAddressOf());
 
+	// load previously baked results keyed by HDR contents and bake parameters
+	uint64_t cacheKey = get_environment_cache_key(path, resolution, sampleCount, lodBias, mipLevels);
+	std::string cachePath = get_environment_cache_path(cacheKey);
+	mvEnvironmentBake bake{};
+	if (load_environment_cache(cachePath, cacheKey, bake))
+	{
+		environment.skyMap = create_cube_map_from_bake(graphics, bake.skyResolution, 1, bake.sky.data(), nullptr);
+		environment.irradianceMap = create_cube_map_from_bake(graphics, bake.resolution, 1, bake.irradiance.data(), nullptr);
+		environment.specularMap = create_cube_map_from_bake(graphics, bake.resolution, bake.mipLevels, bake.specular.data(), environment.specularTextureResource.GetAddressOf());
+		environment.brdfLUT = create_brdf_lut(graphics, bake.resolution, bake.brdfLUT.data());
+		return environment;
+	}
+
+	bake.resolution = resolution;
+	bake.mipLevels = mipLevels;
+	environment.skyMap = create_cube_map_from_hdr(graphics, path, bake);
+
 	// create irradianceMap
-	environment.irradianceMap = create_irradiance_map(graphics, environment.skyMap, resolution, sampleCount, 0.0f);
+	environment.irradianceMap = create_irradiance_map(graphics, environment.skyMap, resolution, sampleCount, 0.0f, bake);
+
+	// specular mips are baked coarsest first, stored finest first
+	std::vector<size_t> specularOffsets(mipLevels);
+	size_t specularSize = 0u;
+	for (int i = 0; i < mipLevels; i++)
+	{
+		size_t currentWidth = resolution >> i;
+		specularOffsets[i] = specularSize;
+		specularSize += 6u * currentWidth * currentWidth * 4u;
+	}
+	bake.specular.resize(specularSize);
 
 	// initial specular map
 	D3D11_TEXTURE2D_DESC texDesc = {};
@@ -2065,35 +2565,13 @@ create_environment(mvGraphics& graphics, const std::string& path, int resolution
 		std::vector<sVec4*>* faces = create_single_specular_map(graphics, environment.skyMap, resolution, currentWidth, sampleCount, lodBias, i, mipLevels);
 		copy_resource_to_cubemap(graphics, environment.specularTextureResource.Get(), environment.specularMap, *faces, currentWidth, currentWidth, i, mipLevels);
 
+		for (int j = 0; j < 6; j++)
+			memcpy(&bake.specular[specularOffsets[i] + j * currentWidth * currentWidth * 4], (*faces)[j], currentWidth * currentWidth * sizeof(float) * 4);
+
 		if (i == 0)
 		{
-			// Create Texture
-			D3D11_TEXTURE2D_DESC textureDesc = {};
-			textureDesc.Width = currentWidth;
-			textureDesc.Height = currentWidth;
-			textureDesc.MipLevels = 1;
-			textureDesc.ArraySize = 1;
-			textureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-			textureDesc.SampleDesc.Count = 1;
-			textureDesc.SampleDesc.Quality = 0;
-			textureDesc.Usage = D3D11_USAGE_DEFAULT;
-			textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-			textureDesc.CPUAccessFlags = 0;
-
-			Microsoft::WRL::ComPtr<ID3D11Texture2D> textureResource2;
-			HRESULT hResult = graphics.device->CreateTexture2D(&textureDesc, nullptr, textureResource2.GetAddressOf());
-			assert(SUCCEEDED(hResult));
-			graphics.imDeviceContext->UpdateSubresource(textureResource2.Get(), 0u, nullptr, (*faces)[6], 4 * currentWidth * sizeof(float), 0u);
-
-			// create the resource view on the texture
-			D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-			srvDesc.Format = textureDesc.Format;
-			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			srvDesc.Texture2D.MostDetailedMip = 0;
-			srvDesc.Texture2D.MipLevels = -1;
-
-			hResult = graphics.device->CreateShaderResourceView(textureResource2.Get(), &srvDesc, environment.brdfLUT.textureView.GetAddressOf());
-			assert(SUCCEEDED(hResult));
+			environment.brdfLUT = create_brdf_lut(graphics, currentWidth, (float*)(*faces)[6]);
+			bake.brdfLUT.assign((float*)(*faces)[6], (float*)(*faces)[6] + currentWidth * currentWidth * 4);
 		}
 
 		for (int i = 0; i < 7; i++)
@@ -2105,6 +2583,8 @@ create_environment(mvGraphics& graphics, const std::string& path, int resolution
 
 	}
 
+	save_environment_cache(cachePath, cacheKey, bake);
+
     return environment;
 }
 
@@ -2121,12 +2601,24 @@ cleanup_environment(mvEnvironment& environment)
 	environment.specularTextureResource = nullptr;
 }
 
-static std::wstring
-ToWide(const std::string& narrow)
+// pipelines also compile on the pipeline compiler's workers, which only log
+static void
+report_shader_error(mvGraphics& graphics, HRESULT hResult, ID3DBlob* errors)
 {
-	wchar_t wide[1024];
-	mbstowcs_s(nullptr, wide, narrow.c_str(), _TRUNCATE);
-	return wide;
+	const char* errorString = "Could not compile shader";
+	if (hResult == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))
+		errorString = "Could not compile shader; file not found";
+	else if (errors)
+		errorString = (const char*)errors->GetBufferPointer();
+
+	if (std::this_thread::get_id() == graphics.threadID)
+		MessageBoxA(0, errorString, "Shader Compiler Error", MB_ICONERROR | MB_OK);
+	else
+	{
+		OutputDebugStringA("Shader Compiler Error: ");
+		OutputDebugStringA(errorString);
+		OutputDebugStringA("\n");
+	}
 }
 
 mvComputeShader
@@ -2136,20 +2628,12 @@ create_compute_shader(mvGraphics& graphics, const std::string& path, std::vector
 	shader.path = path;
 
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderCompileErrorsBlob;
-	HRESULT hResult = D3DCompileFromFile(ToWide(path).c_str(),
-		macros ? macros->data() : nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", "cs_5_0", 0, 0,
+	HRESULT hResult = compile_shader(graphics.shaderCache, path,
+		macros ? macros->data() : nullptr, "cs_5_0", 0,
 		shader.blob.GetAddressOf(), shaderCompileErrorsBlob.GetAddressOf());
 
 	if (FAILED(hResult))
-	{
-		const char* errorString = NULL;
-		if (hResult == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))
-			errorString = "Could not compile shader; file not found";
-		else if (shaderCompileErrorsBlob)
-			errorString = (const char*)shaderCompileErrorsBlob->GetBufferPointer();
-
-		MessageBoxA(0, errorString, "Shader Compiler Error", MB_ICONERROR | MB_OK);
-	}
+		report_shader_error(graphics, hResult, shaderCompileErrorsBlob.Get());
 
 	hResult = graphics.device->CreateComputeShader(shader.blob->GetBufferPointer(), shader.blob->GetBufferSize(), nullptr, shader.shader.GetAddressOf());
 	assert(SUCCEEDED(hResult));
@@ -2163,24 +2647,18 @@ create_pixel_shader(mvGraphics& graphics, const std::string& path, std::vector<D
 	shader.path = path;
 
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderCompileErrorsBlob;
-	HRESULT hResult = D3DCompileFromFile(
-		ToWide(path).c_str(),
-		macros ? macros->data() : nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", "ps_5_0", 0, 0,
+	HRESULT hResult = compile_shader(graphics.shaderCache, path,
+		macros ? macros->data() : nullptr, "ps_5_0", 0,
 		shader.blob.GetAddressOf(), shaderCompileErrorsBlob.GetAddressOf());
 
+	// the shader stays null, finalize_pipeline reports the failure
 	if (FAILED(hResult))
 	{
-		const char* errorString = NULL;
-		if (hResult == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))
-			errorString = "Could not compile shader; file not found";
-		else if (shaderCompileErrorsBlob)
-			errorString = (const char*)shaderCompileErrorsBlob->GetBufferPointer();
-
-		MessageBoxA(0, errorString, "Shader Compiler Error", MB_ICONERROR | MB_OK);
+		report_shader_error(graphics, hResult, shaderCompileErrorsBlob.Get());
+		return shader;
 	}
 
-	hResult = graphics.device->CreatePixelShader(shader.blob->GetBufferPointer(), shader.blob->GetBufferSize(), nullptr, shader.shader.GetAddressOf());
-	assert(SUCCEEDED(hResult));
+	shader.shader = get_pixel_shader(graphics, shader.blob.Get());
 	return shader;
 }
 
@@ -2191,26 +2669,19 @@ create_vertex_shader(mvGraphics& graphics, const std::string& path, mvVertexLayo
 	shader.path = path;
 
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderCompileErrorsBlob;
-	HRESULT hResult = D3DCompileFromFile(ToWide(path).c_str(),
-		macros ? macros->data() : nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", "vs_5_0",
-		0, 0, shader.blob.GetAddressOf(), shaderCompileErrorsBlob.GetAddressOf());
+	HRESULT hResult = compile_shader(graphics.shaderCache, path,
+		macros ? macros->data() : nullptr, "vs_5_0", 0,
+		shader.blob.GetAddressOf(), shaderCompileErrorsBlob.GetAddressOf());
 
 	if (FAILED(hResult))
 	{
-		const char* errorString = NULL;
-		if (hResult == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))
-			errorString = "Could not compile shader; file not found";
-		else if (shaderCompileErrorsBlob)
-			errorString = (const char*)shaderCompileErrorsBlob->GetBufferPointer();
-
-		MessageBoxA(0, errorString, "Shader Compiler Error", MB_ICONERROR | MB_OK);
+		report_shader_error(graphics, hResult, shaderCompileErrorsBlob.Get());
+		return shader;
 	}
 
-	hResult = graphics.device->CreateVertexShader(shader.blob->GetBufferPointer(),
-		shader.blob->GetBufferSize(), nullptr, shader.shader.GetAddressOf());
-
-	assert(SUCCEEDED(hResult));
+	shader.shader = get_vertex_shader(graphics, shader.blob.Get());
 
+	layout.d3dLayout.clear();
 	for (int i = 0; i < layout.semantics.size(); i++)
 	{
 		layout.d3dLayout.push_back(D3D11_INPUT_ELEMENT_DESC{
@@ -2224,13 +2695,7 @@ create_vertex_shader(mvGraphics& graphics, const std::string& path, mvVertexLayo
 			});
 	}
 
-	hResult = graphics.device->CreateInputLayout(layout.d3dLayout.data(),
-		(uint32_t)layout.d3dLayout.size(),
-		shader.blob->GetBufferPointer(),
-		shader.blob->GetBufferSize(),
-		shader.inputLayout.GetAddressOf());
-
-	assert(SUCCEEDED(hResult));
+	shader.inputLayout = get_input_layout(graphics, layout.d3dLayout.data(), (unsigned int)layout.d3dLayout.size(), shader.blob.Get());
 
 	return shader;
 }
@@ -2377,6 +2842,14 @@ mvGetVertexElementInfo(mvVertexElement element)
 		newelement.semantic = "Weights";
 		break;
 
+	case Occlusion:
+		newelement.format = DXGI_FORMAT_R32_FLOAT;
+		newelement.itemCount = 1;
+		newelement.normalize = false;
+		newelement.size = sizeof(float) * newelement.itemCount;
+		newelement.semantic = "Occlusion";
+		break;
+
 	}
 
 	newelement.type = element;
@@ -2387,30 +2860,28 @@ mvVertexLayout
 create_vertex_layout(std::vector<mvVertexElement> elements)
 {
 	mvVertexLayout layout{};
-
-	std::vector<mvVertexElementTemp> newelements;
-
-	uint32_t stride = 0u;
-	uint32_t size = 0u;
+	layout.elementCount = 0u;
+	layout.size = 0u;
 
 	for (auto& element : elements)
-	{
-		newelements.push_back(mvGetVertexElementInfo(element));
-		newelements.back().offset = stride;
-		layout.indices.push_back(newelements.back().index);
-		layout.semantics.push_back(newelements.back().semantic);
-		layout.formats.push_back(newelements.back().format);
-		stride += newelements.back().size;
-		size += newelements.back().size;
-		layout.elementCount += newelements.back().itemCount;
-	}
-
-	layout.size = size;
-	//layout.stride = stride;
+		append_vertex_element(layout, element);
 
 	return layout;
 }
 
+void
+append_vertex_element(mvVertexLayout& layout, mvVertexElement element)
+{
+	mvVertexElementTemp newelement = mvGetVertexElementInfo(element);
+	newelement.offset = layout.size;
+	layout.indices.push_back(newelement.index);
+	layout.offsets.push_back(newelement.offset);
+	layout.semantics.push_back(newelement.semantic);
+	layout.formats.push_back(newelement.format);
+	layout.size += newelement.size;
+	layout.elementCount += newelement.itemCount;
+}
+
 mvVertexElement
 get_element_from_gltf_semantic(const char* semantic)
 {
@@ -2456,6 +2927,15 @@ operator!=(mvVertexLayout& left, mvVertexLayout& right)
 	return !(left == right);
 }
 
+// no states or shaders, so a failed compile can't leave a half built pipeline around
+static mvPipeline
+failed_pipeline(mvPipelineInfo& info)
+{
+    mvPipeline pipeline{};
+    pipeline.info = info;
+    return pipeline;
+}
+
 mvPipeline
 finalize_pipeline(mvGraphics& graphics, mvPipelineInfo& info)
 {
@@ -2471,7 +2951,7 @@ finalize_pipeline(mvGraphics& graphics, mvPipelineInfo& info)
     rasterDesc.DepthBiasClamp = info.clamp;
     rasterDesc.SlopeScaledDepthBias = info.slopeBias;
 
-    graphics.device->CreateRasterizerState(&rasterDesc, pipeline.rasterizationState.GetAddressOf());
+    pipeline.rasterizationState = get_rasterizer_state(graphics, rasterDesc);
 
 	D3D11_DEPTH_STENCIL_DESC dsDesc = CD3D11_DEPTH_STENCIL_DESC{ CD3D11_DEFAULT{} };
     // Depth test parameters
@@ -2496,29 +2976,42 @@ finalize_pipeline(mvGraphics& graphics, mvPipelineInfo& info)
     dsDesc.BackFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
     dsDesc.BackFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
 
-    graphics.device->CreateDepthStencilState(&dsDesc, pipeline.depthStencilState.GetAddressOf());
+    pipeline.depthStencilState = get_depth_stencil_state(graphics, dsDesc);
 
     D3D11_BLEND_DESC blendDesc = CD3D11_BLEND_DESC{ CD3D11_DEFAULT{} };
     auto& brt = blendDesc.RenderTarget[0];
     brt.BlendEnable = TRUE;
     brt.SrcBlend = D3D11_BLEND_SRC_ALPHA;
     brt.DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
-    graphics.device->CreateBlendState(&blendDesc, pipeline.blendState.GetAddressOf());
+    pipeline.blendState = get_blend_state(graphics, blendDesc);
 
-    std::vector<D3D_SHADER_MACRO> macros;
+    std::vector<D3D_SHADER_MACRO> vertexMacros;
+    std::vector<D3D_SHADER_MACRO> pixelMacros;
     for (auto& mac : info.macros)
-        macros.push_back({ mac.macro.c_str(), mac.value.c_str()});
+    {
+        vertexMacros.push_back({ mac.macro.c_str(), mac.value.c_str()});
+        pixelMacros.push_back({ mac.macro.c_str(), mac.value.c_str()});
+    }
+    for (auto& mac : info.vertexMacros)
+        vertexMacros.push_back({ mac.macro.c_str(), mac.value.c_str()});
+    for (auto& mac : info.pixelMacros)
+        pixelMacros.push_back({ mac.macro.c_str(), mac.value.c_str()});
 
-    macros.push_back({ NULL, NULL });
+    vertexMacros.push_back({ NULL, NULL });
+    pixelMacros.push_back({ NULL, NULL });
 
     if (!info.pixelShader.empty())
     {
-        mvPixelShader pixelShader = create_pixel_shader(graphics, std::string(graphics.shaderDirectory) + info.pixelShader, macros.empty() ? nullptr : &macros);
+        mvPixelShader pixelShader = create_pixel_shader(graphics, std::string(graphics.shaderDirectory) + info.pixelShader, &pixelMacros);
+        if (pixelShader.blob.Get() == nullptr)
+            return failed_pipeline(info);
         pipeline.pixelShader = pixelShader.shader;
         pipeline.pixelBlob = pixelShader.blob;
     }
 
-    mvVertexShader vertexShader = create_vertex_shader(graphics, std::string(graphics.shaderDirectory) + info.vertexShader, info.layout, macros.empty() ? nullptr : &macros);
+    mvVertexShader vertexShader = create_vertex_shader(graphics, std::string(graphics.shaderDirectory) + info.vertexShader, info.layout, &vertexMacros);
+    if (vertexShader.blob.Get() == nullptr) // the shader objects are null without a device too
+        return failed_pipeline(info);
 
     pipeline.vertexShader = vertexShader.shader;
     pipeline.vertexBlob = vertexShader.blob;
@@ -9,6 +9,10 @@
 #include "mvWindows.h"
 #include "sGltf.h"
 #include "sMath.h"
+#include "mvTextureStreaming.h"
+#include "mvGeometryPool.h"
+#include "mvShaderCache.h"
+#include "mvStateCache.h"
 
 typedef int mvAssetID;
 typedef int mvVertexElement;
@@ -25,6 +29,8 @@ struct mvConstBuffer;
 struct mvGLTFModel;
 struct mvMeshPrimitive;
 struct mvMesh;
+struct mvBatchRange;
+struct mvStaticBatch;
 struct mvSkin;
 struct mvNode;
 struct mvTexture;
@@ -40,11 +46,15 @@ struct mvShaderOptions;
 struct mvShaderMacro;
 struct mvGraphics;
 struct mvScene;
+struct mvPipelineCompiler;
+struct mvMorphBlender;
 
 // graphics
 mvGraphics setup_graphics    (mvViewport& viewport, const char* shaderDirectory);
+mvGraphics setup_headless_graphics(const char* shaderDirectory); // null device, resources come back empty and uploads are skipped
 void       recreate_swapchain(mvGraphics& graphics, unsigned width, unsigned height);
 void       set_pipeline_state(mvGraphics& graphics, mvPipeline& pipeline);
+unsigned   get_lighting_flags(mvGraphics& graphics); // enabled toggles as mvLightingFlags
 
 // meshes
 mvMesh create_cube         (mvGraphics& graphics, float size = 1.0f);
@@ -53,6 +63,7 @@ mvMesh create_textured_quad(mvGraphics& graphics, float size = 1.0f);
 mvMesh create_frustum      (mvGraphics& graphics, float width, float height, float nearZ, float farZ);
 mvMesh create_frustum2     (mvGraphics& graphics, float fov, float aspect, float nearZ, float farZ);
 mvMesh create_ortho_frustum(mvGraphics& graphics, float width, float height, float nearZ, float farZ);
+mvMesh create_bounds_box   (mvGraphics& graphics); // unit cube outline, [0, 1] on each axis
 
 // buffers
 mvBuffer      create_buffer      (mvGraphics& graphics, void* data, unsigned int size, D3D11_BIND_FLAG flags, unsigned int stride = 0u, unsigned int miscFlags = 0u);
@@ -69,11 +80,14 @@ mvTexture     create_texture     (mvGraphics& graphics, unsigned char* data, uns
 mvCubeTexture create_cube_texture(mvGraphics& graphics, const std::string& path);
 mvTexture     create_dynamic_texture(mvGraphics& graphics, unsigned int width, unsigned int height, unsigned int arraySize = 1);
 mvTexture     create_texture(mvGraphics& graphics, unsigned int width, unsigned int height, unsigned int arraySize = 1, float* data = nullptr);
+mvTexture     create_streamed_texture(mvGraphics& graphics, const std::string& path);
+mvTexture     create_streamed_texture(mvGraphics& graphics, const std::string& key, unsigned char* data, unsigned int dataSize);
 void          update_dynamic_texture(mvGraphics& graphics, mvTexture& texture, unsigned int width, unsigned int height, float* data);
 
 // pipelines
-mvPipeline      finalize_pipeline             (mvGraphics& graphics, mvPipelineInfo& info);
+mvPipeline      finalize_pipeline             (mvGraphics& graphics, mvPipelineInfo& info); // vertexShader is null if a shader failed to compile, and always without a device
 mvVertexLayout  create_vertex_layout          (std::vector<mvVertexElement> elements);
+void            append_vertex_element         (mvVertexLayout& layout, mvVertexElement element);
 mvVertexElement get_element_from_gltf_semantic(const char* semantic);
 mvPixelShader   create_pixel_shader           (mvGraphics& graphics, const std::string& path, std::vector<D3D_SHADER_MACRO>* macros = nullptr);
 mvVertexShader  create_vertex_shader          (mvGraphics& graphics, const std::string& path, mvVertexLayout& layout, std::vector<D3D_SHADER_MACRO>* macros = nullptr);
@@ -86,6 +100,7 @@ void              submit_scene     (mvGraphics& graphics, mvModel& model, mvRend
 void              render_scenes    (mvGraphics& graphics, mvModel& model, mvRendererContext& ctx, sMat4 cam, sMat4 proj);
 void              render_skybox    (mvGraphics& graphics, mvRendererContext& rendererCtx, mvModel& model, mvCubeTexture& cubemap, ID3D11SamplerState* sampler, sMat4 cam, sMat4 proj);
 void              render_mesh_solid(mvGraphics& graphics, mvRendererContext& rendererCtx, mvModel& model, mvMesh& mesh, sMat4 transform, sMat4 cam, sMat4 proj);
+float             get_projected_size(mvMeshPrimitive& primitive, sMat4 transform, sMat4 cam, sMat4 proj, float viewportHeight);
 
 enum mvVertexElement_
 {
@@ -103,6 +118,16 @@ enum mvVertexElement_
 	Joints1,
 	Weights0,
 	Weights1,
+	Occlusion, // baked per-vertex ambient occlusion
+};
+
+// global lighting toggles, matches LIGHTING_* in PBR_PS.hlsl
+enum mvLightingFlags
+{
+    MV_LIGHTING_IBL       = 1 << 0,
+    MV_LIGHTING_PUNCTUAL  = 1 << 1,
+    MV_LIGHTING_CLEARCOAT = 1 << 2,
+    MV_LIGHTING_ALL       = MV_LIGHTING_IBL | MV_LIGHTING_PUNCTUAL | MV_LIGHTING_CLEARCOAT
 };
 
 struct mvTransforms
@@ -110,6 +135,8 @@ struct mvTransforms
 	sMat4 model               = sMat4(1.0f);
 	sMat4 modelView           = sMat4(1.0f);
 	sMat4 modelViewProjection = sMat4(1.0f);
+	int   materialIndex       = 0; // into mvMaterialManager::dataBuffer, read by the pixel shader
+	int   _padding[3];
 };
 
 struct mvNode
@@ -118,7 +145,7 @@ struct mvNode
     mvAssetID    skin   = -1;
     mvAssetID    mesh   = -1;
     mvAssetID    camera = -1;
-    mvAssetID    children[256];
+    unsigned int childOffset = 0u; // into mvModel::nodeIndices
     unsigned int childCount = 0u;
     sMat4       matrix               = sMat4(1.0f);
     sVec3       translation          = { 0.0f, 0.0f, 0.0f };
@@ -131,6 +158,9 @@ struct mvNode
     bool         rotationAnimated = false;
     bool         scaleAnimated = false;
     bool         animated = false;
+    bool         batched = false; // primitives drawn through a static batch
+    unsigned int instanceCount = 0u;  // EXT_mesh_gpu_instancing, transform and normal matrix pairs bound to VS t2
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> instanceBuffer;
 
     sMat4      transform = sMat4(1.0f);
     sMat4      worldTransform = sMat4(1.0f);
@@ -139,7 +169,7 @@ struct mvNode
 
 struct mvScene
 {
-    mvAssetID    nodes[256];
+    unsigned int nodeOffset = 0u; // into mvModel::nodeIndices
     unsigned int nodeCount = 0u;
     unsigned int meshOffset = 0u;
 };
@@ -149,6 +179,7 @@ struct mvVertexLayout
 	unsigned int                          elementCount;
 	unsigned int                          size;
 	std::vector<unsigned int>             indices;
+	std::vector<unsigned int>             offsets;
 	std::vector<std::string>              semantics;
 	std::vector<DXGI_FORMAT>              formats;
 	std::vector<D3D11_INPUT_ELEMENT_DESC> d3dLayout;
@@ -228,7 +259,9 @@ struct mvPipelineInfo
     float                      slopeBias;
     float                      clamp;
     bool                       cull = true;
-    std::vector<mvShaderMacro> macros;
+    std::vector<mvShaderMacro> macros;       // both stages
+    std::vector<mvShaderMacro> vertexMacros; // kept apart so pixel-only features don't split the vertex shader
+    std::vector<mvShaderMacro> pixelMacros;
 };
 
 struct mvPipeline
@@ -250,6 +283,7 @@ struct mvTexture
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureView = nullptr;
     bool                                             alpha       = false;
     Microsoft::WRL::ComPtr<ID3D11SamplerState>       sampler     = nullptr;
+    mvAssetID                                        streamID    = -1; // mvTextureStreamer entry, textureView unused
 };
 
 struct mvCubeTexture
@@ -282,23 +316,39 @@ struct mvConstBuffer
 	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
 };
 
+// one morphed vertex attribute, its targets are consecutive morph texture layers
+struct mvMorphAttribute
+{
+    unsigned int vertexOffset = 0u; // floats into the vertex
+    unsigned int componentCount = 0u;
+    unsigned int layerOffset = 0u;  // layer of target 0
+};
+
 struct mvMeshPrimitive
 {
     mvVertexLayout layout;
     mvBuffer       indexBuffer;
     mvBuffer       vertexBuffer;
-    mvTexture      normalTexture;
-    mvTexture      specularTexture;
-    mvTexture      albedoTexture;
-    mvTexture      emissiveTexture;
-    mvTexture      occlusionTexture;
-    mvTexture      metalRoughnessTexture;
-    mvTexture      clearcoatTexture;
-    mvTexture      clearcoatRoughnessTexture;
-    mvTexture      clearcoatNormalTexture;
     mvTexture      morphTexture;
     mvAssetID      materialID = -1;
+    mvAssetID      defaultMaterialID = -1;
+    mvAssetID      geometryID = -1; // range in graphics.geometryPool, otherwise the buffers above
     float*         morphData = nullptr;
+    unsigned int   morphWidth = 0u;
+    sVec3          minBound = { 0.0f, 0.0f, 0.0f };
+    sVec3          maxBound = { 0.0f, 0.0f, 0.0f };
+
+    // KHR_materials_variants, indexed by variant (-1 uses the default material)
+    std::vector<mvAssetID> variantMaterialIDs;
+
+    // CPU copies, only kept while loading
+    std::vector<float>        vertexData;
+    std::vector<unsigned int> indexData;
+
+    // morph pre-blending (graphics.morphPreblend), undeformed and deformed vertices
+    std::vector<mvMorphAttribute> morphAttributes;
+    std::vector<float>            morphBase;
+    std::vector<float>            morphBlended;
 };
 
 struct mvMesh
@@ -307,10 +357,28 @@ struct mvMesh
     std::vector<mvMeshPrimitive> primitives;
     std::vector<float>           weights;
     std::vector<float>           weightsAnimated;
+    std::vector<float>           weightsApplied;   // weightsAnimated at the last morph update
+    std::vector<float>           morphTargets;     // MorphCBuf: active count, then (weight, target) per active target
     unsigned int                 weightCount;
+    bool                         morphPreblended = false;
     mvConstBuffer                morphBuffer;
 };
 
+struct mvBatchRange
+{
+    unsigned int indexOffset = 0u;
+    unsigned int indexCount = 0u;
+    sVec3        minBound = { 0.0f, 0.0f, 0.0f }; // world space
+    sVec3        maxBound = { 0.0f, 0.0f, 0.0f };
+};
+
+struct mvStaticBatch
+{
+    mvAssetID                 scene = -1;
+    mvMeshPrimitive           primitive; // merged buffers, material shared by the source primitives
+    std::vector<mvBatchRange> ranges;    // one per source primitive
+};
+
 struct GlobalInfo
 {
 
@@ -319,7 +387,7 @@ struct GlobalInfo
     //-------------------------- ( 16 bytes )
 
     sVec3 camPos;
-    char _padding[4];
+    int lightingFlags = MV_LIGHTING_ALL; // see get_lighting_flags
     //-------------------------- ( 16 bytes )
     
     sMat4 projection;
@@ -336,6 +404,9 @@ struct mvRenderJob
     sMat4                                accumulatedTransform = sMat4(1.0f);
     mvSkin*                              skin = nullptr;
     Microsoft::WRL::ComPtr<ID3D11Buffer> morphBuffer = nullptr;
+    mvStaticBatch*                       batch = nullptr;
+    ID3D11ShaderResourceView*            instanceBuffer = nullptr;
+    unsigned int                         instanceCount = 0u;
 };
 
 struct mvRendererContext
@@ -350,6 +421,7 @@ struct mvRendererContext
     mvPipeline               skyboxPipeline;
     mvPipeline               solidPipeline;
     mvPipeline               solidWireframePipeline;
+    mvMesh                   boundsMesh; // stands in for primitives still loading
 };
 
 struct mvGraphics
@@ -364,11 +436,19 @@ struct mvGraphics
     Microsoft::WRL::ComPtr<ID3D11Device>           device;
     std::thread::id                                threadID;
     D3D11_VIEWPORT                                 viewport;
+    mvTextureStreamer                              textureStreamer;
+    mvGeometryPool                                 geometryPool;
+    mvShaderCache                                  shaderCache;
+    mvStateCache                                   stateCache;
+    mvPipelineCompiler*                            pipelineCompiler = nullptr; // see start_pipeline_compiler
+    mvMorphBlender*                                morphBlender = nullptr;     // see start_morph_blender
 
     // user options
     bool punctualLighting = true;
     bool imageBasedLighting = true;
     bool clearcoat = true;
+    unsigned int lightingBranches = MV_LIGHTING_ALL; // toggles compiled as branches on GlobalInfo::lightingFlags, flipping them needs no reload_materials
+    bool morphPreblend = false; // blend active morph targets on the CPU when weights change
 };
 
 bool operator==(mvVertexLayout& left, mvVertexLayout& right);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// FNV-1a (64 bit)
+static const uint64_t MV_HASH_SEED = 14695981039346656037ull;
+
+inline uint64_t
+hash_bytes(const void* data, size_t size, uint64_t hash = MV_HASH_SEED)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t
+hash_string(const std::string& value, uint64_t hash = MV_HASH_SEED)
+{
+    return hash_bytes(value.data(), value.size(), hash);
+}
@@ -0,0 +1,304 @@
+#include "mvJson.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+struct mvJsonParser
+{
+    const char* text = nullptr;
+    size_t      size = 0u;
+    size_t      pos = 0u;
+    int         depth = 0;
+};
+
+static void
+skip_whitespace(mvJsonParser& parser)
+{
+    while (parser.pos < parser.size)
+    {
+        char c = parser.text[parser.pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            break;
+        parser.pos++;
+    }
+}
+
+static bool
+match_literal(mvJsonParser& parser, const char* literal)
+{
+    size_t length = strlen(literal);
+    if (parser.pos + length > parser.size || strncmp(&parser.text[parser.pos], literal, length) != 0)
+        return false;
+    parser.pos += length;
+    return true;
+}
+
+static void
+append_utf8(std::string& out, unsigned int codepoint)
+{
+    if (codepoint < 0x80)
+        out.push_back((char)codepoint);
+    else if (codepoint < 0x800)
+    {
+        out.push_back((char)(0xC0 | (codepoint >> 6)));
+        out.push_back((char)(0x80 | (codepoint & 0x3F)));
+    }
+    else
+    {
+        out.push_back((char)(0xE0 | (codepoint >> 12)));
+        out.push_back((char)(0x80 | ((codepoint >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (codepoint & 0x3F)));
+    }
+}
+
+static bool
+parse_string(mvJsonParser& parser, std::string& out)
+{
+    if (parser.pos >= parser.size || parser.text[parser.pos] != '"')
+        return false;
+    parser.pos++;
+
+    while (parser.pos < parser.size)
+    {
+        char c = parser.text[parser.pos++];
+        if (c == '"')
+            return true;
+        if (c != '\\')
+        {
+            out.push_back(c);
+            continue;
+        }
+
+        if (parser.pos >= parser.size)
+            return false;
+        char escape = parser.text[parser.pos++];
+        switch (escape)
+        {
+        case '"':  out.push_back('"'); break;
+        case '\\': out.push_back('\\'); break;
+        case '/':  out.push_back('/'); break;
+        case 'b':  out.push_back('\b'); break;
+        case 'f':  out.push_back('\f'); break;
+        case 'n':  out.push_back('\n'); break;
+        case 'r':  out.push_back('\r'); break;
+        case 't':  out.push_back('\t'); break;
+        case 'u':
+        {
+            if (parser.pos + 4 > parser.size)
+                return false;
+            char hex[5] = {};
+            memcpy(hex, &parser.text[parser.pos], 4);
+            parser.pos += 4;
+            append_utf8(out, (unsigned int)strtoul(hex, nullptr, 16));
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool
+parse_value(mvJsonParser& parser, mvJsonValue& value)
+{
+    // bail out on absurdly deep nesting
+    if (++parser.depth > 256)
+        return false;
+
+    skip_whitespace(parser);
+    if (parser.pos >= parser.size)
+        return false;
+
+    bool success = false;
+    char c = parser.text[parser.pos];
+    if (c == '{')
+    {
+        value.type = MV_JSON_OBJECT;
+        parser.pos++;
+        skip_whitespace(parser);
+        if (parser.pos < parser.size && parser.text[parser.pos] == '}')
+        {
+            parser.pos++;
+            success = true;
+        }
+        while (!success)
+        {
+            skip_whitespace(parser);
+            value.keys.push_back({});
+            if (!parse_string(parser, value.keys.back()))
+                break;
+            skip_whitespace(parser);
+            if (parser.pos >= parser.size || parser.text[parser.pos++] != ':')
+                break;
+            value.elements.push_back({});
+            if (!parse_value(parser, value.elements.back()))
+                break;
+            skip_whitespace(parser);
+            if (parser.pos >= parser.size)
+                break;
+            char next = parser.text[parser.pos++];
+            if (next == '}')
+                success = true;
+            else if (next != ',')
+                break;
+        }
+    }
+    else if (c == '[')
+    {
+        value.type = MV_JSON_ARRAY;
+        parser.pos++;
+        skip_whitespace(parser);
+        if (parser.pos < parser.size && parser.text[parser.pos] == ']')
+        {
+            parser.pos++;
+            success = true;
+        }
+        while (!success)
+        {
+            value.elements.push_back({});
+            if (!parse_value(parser, value.elements.back()))
+                break;
+            skip_whitespace(parser);
+            if (parser.pos >= parser.size)
+                break;
+            char next = parser.text[parser.pos++];
+            if (next == ']')
+                success = true;
+            else if (next != ',')
+                break;
+        }
+    }
+    else if (c == '"')
+    {
+        value.type = MV_JSON_STRING;
+        success = parse_string(parser, value.string);
+    }
+    else if (c == 't' || c == 'f')
+    {
+        value.type = MV_JSON_BOOL;
+        value.boolean = c == 't';
+        success = match_literal(parser, value.boolean ? "true" : "false");
+    }
+    else if (c == 'n')
+    {
+        value.type = MV_JSON_NULL;
+        success = match_literal(parser, "null");
+    }
+    else
+    {
+        // strtod needs a terminated string
+        char buffer[64] = {};
+        size_t length = 0u;
+        while (parser.pos + length < parser.size && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", parser.text[parser.pos + length]))
+        {
+            buffer[length] = parser.text[parser.pos + length];
+            length++;
+        }
+        char* end = nullptr;
+        value.type = MV_JSON_NUMBER;
+        value.number = strtod(buffer, &end);
+        success = length > 0u && end == buffer + length;
+        parser.pos += length;
+    }
+
+    parser.depth--;
+    return success;
+}
+
+bool
+parse_json(const char* text, size_t size, mvJsonValue& value)
+{
+    mvJsonParser parser{};
+    parser.text = text;
+    parser.size = size;
+    value = {};
+    return parse_value(parser, value);
+}
+
+bool
+load_gltf_json(const std::string& path, mvJsonValue& value)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0)
+    {
+        fclose(file);
+        return false;
+    }
+
+    std::vector<char> data(size);
+    size_t read = fread(data.data(), 1, size, file);
+    fclose(file);
+    if (read != (size_t)size)
+        return false;
+
+    // binary container: 12 byte header, then the JSON chunk
+    if (size >= 20 && memcmp(data.data(), "glTF", 4) == 0)
+    {
+        uint32_t chunkLength = 0u;
+        memcpy(&chunkLength, &data[12], sizeof(uint32_t));
+        if (memcmp(&data[16], "JSON", 4) != 0 || 20u + chunkLength > (size_t)size)
+            return false;
+        return parse_json(&data[20], chunkLength, value);
+    }
+
+    return parse_json(data.data(), data.size(), value);
+}
+
+const mvJsonValue*
+get_json_member(const mvJsonValue& value, const char* key)
+{
+    if (value.type != MV_JSON_OBJECT)
+        return nullptr;
+
+    for (size_t i = 0; i < value.keys.size(); i++)
+    {
+        if (value.keys[i] == key)
+            return &value.elements[i];
+    }
+    return nullptr;
+}
+
+const mvJsonValue*
+get_json_path(const mvJsonValue& value, std::vector<const char*> keys)
+{
+    const mvJsonValue* current = &value;
+    for (size_t i = 0; i < keys.size() && current; i++)
+        current = get_json_member(*current, keys[i]);
+    return current;
+}
+
+std::string
+escape_json(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"':  escaped.append("\\\""); break;
+        case '\\': escaped.append("\\\\"); break;
+        case '\n': escaped.append("\\n"); break;
+        case '\r': escaped.append("\\r"); break;
+        case '\t': escaped.append("\\t"); break;
+        default:
+            if ((unsigned char)c < 0x20u)
+            {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", (unsigned)c);
+                escaped.append(code);
+            }
+            else
+                escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+// Minimal JSON reader, used for glTF extension data sGltf.h doesn't expose.
+// The tools write their reports with printf, escape_json covers the strings.
+
+// forward declarations
+struct mvJsonValue;
+
+bool               parse_json     (const char* text, size_t size, mvJsonValue& value);
+bool               load_gltf_json (const std::string& path, mvJsonValue& value); // .gltf or .glb
+const mvJsonValue* get_json_member(const mvJsonValue& value, const char* key);
+const mvJsonValue* get_json_path  (const mvJsonValue& value, std::vector<const char*> keys);
+std::string        escape_json    (const std::string& text); // contents of a string literal, without the quotes
+
+enum mvJsonType
+{
+    MV_JSON_NULL,
+    MV_JSON_BOOL,
+    MV_JSON_NUMBER,
+    MV_JSON_STRING,
+    MV_JSON_ARRAY,
+    MV_JSON_OBJECT,
+};
+
+struct mvJsonValue
+{
+    mvJsonType               type = MV_JSON_NULL;
+    bool                     boolean = false;
+    double                   number = 0.0;
+    std::string              string;
+    std::vector<mvJsonValue> elements; // array items or object member values
+    std::vector<std::string> keys;     // object member names
+};
@@ -1,47 +1,190 @@
 #include "mvMaterials.h"
 #include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include "mvHash.h"
+#include "mvPipelineCompiler.h"
+#include "mvShaderPermutations.h"
 
-std::string hash_material(const mvMaterial& material, const mvVertexLayout& layout, const std::string& pixelShader, const std::string& vertexShader)
-{
-	std::string hash = pixelShader + vertexShader +
-		std::to_string(material.data.albedo.x) +
-		std::to_string(material.data.albedo.y) +
-		std::to_string(material.data.albedo.z) +
-		std::to_string(material.data.albedo.w) +
-		std::to_string(material.data.metalness) +
-		std::to_string(material.data.roughness) +
-		std::to_string(material.data.alphaCutoff) +
-		std::to_string(material.data.emisiveFactor.x) +
-		std::to_string(material.data.emisiveFactor.y) +
-		std::to_string(material.data.emisiveFactor.z) +
-		std::to_string(material.data.radiance) +
-		std::to_string(material.data.fresnel) +
-		std::to_string(material.alphaMode) +
-		std::to_string(material.data.clearcoatFactor) +
-		std::to_string(material.data.clearcoatRoughnessFactor) +
-		std::to_string(material.data.clearcoatNormalScale) +
-		std::to_string(material.data.normalScale) +
-		std::string(material.hasClearcoatMap ? "T" : "F") +
-		std::string(material.hasClearcoatRoughnessMap ? "T" : "F") +
-		std::string(material.hasClearcoatNormalMap ? "T" : "F") +
-		std::string(material.data.doubleSided ? "T" : "F") +
-		std::string(material.hasAlbedoMap ? "T" : "F") +
-		std::string(material.hasNormalMap ? "T" : "F") +
-		std::string(material.hasMetallicRoughnessMap ? "T" : "F") +
-		std::string(material.hasOcculusionMap ? "T" : "F") +
-		std::string(material.hasEmmissiveMap ? "T" : "F");
-
-	for (auto& semantic : layout.semantics)
-		hash.append(semantic);
+// the features create_material turns into macros, one bit each
+static uint32_t
+get_material_features(const mvMaterial& material)
+{
+	bool features[] = {
+		material.hasNormalMap, material.hasEmmissiveMap, material.hasOcculusionMap, material.hasSpecularMap,
+		material.hasSpecularColorMap, material.hasSpecularGlossinessMap, material.hasSheenColorMap, material.hasSheenRoughnessMap,
+		material.hasTransmissionMap, material.hasThicknessMap, material.pbrMetallicRoughness, material.hasAlbedoMap,
+		material.hasMetallicRoughnessMap, material.extensionClearcoat, material.hasClearcoatMap, material.hasClearcoatNormalMap,
+		material.hasClearcoatRoughnessMap };
+
+	uint32_t bits = (uint32_t)material.alphaMode << 24u;
+	for (uint32_t i = 0; i < sizeof(features) / sizeof(features[0]); i++)
+		bits |= features[i] ? 1u << i : 0u;
+	return bits;
+}
+
+// compiles on the pipeline compiler's workers when it is running
+static void
+set_material_pipeline(mvGraphics& graphics, mvMaterial& material, mvPipelineInfo& info)
+{
+	// a request still in flight is superseded by this one
+	release_pipeline(graphics, material.pendingPipeline);
+	material.pendingPipeline = 0u;
+
+	// a failed compile keeps the previous pipeline
+	if (graphics.pipelineCompiler == nullptr)
+	{
+		mvPipeline pipeline = finalize_pipeline(graphics, info);
+		if (pipeline.vertexShader.Get() != nullptr || material.pipeline.vertexShader.Get() == nullptr)
+			material.pipeline = pipeline;
+		return;
+	}
+
+	material.pendingPipeline = request_pipeline(graphics, info);
+	if (poll_pipeline(graphics, material.pendingPipeline, material.pipeline))
+		material.pendingPipeline = 0u;
+	if (material.pipeline.vertexShader.Get() == nullptr)
+		material.pipeline = get_fallback_pipeline(graphics, info);
+}
+
+// split per stage so materials that only differ in pixel features share a vertex shader,
+// the binding table comes from the same permutation
+static void
+set_material_macros(mvGraphics& graphics, mvMaterial& material, mvPipelineInfo& info)
+{
+	mvShaderPermutation permutation = get_material_permutation(material, get_lighting_flags(graphics), graphics.lightingBranches);
+	info.macros = material.macros;
+	info.vertexMacros.clear();
+	info.pixelMacros.clear();
+	get_permutation_macros(permutation, info.vertexMacros, MV_SHADER_STAGE_VERTEX);
+	get_permutation_macros(permutation, info.pixelMacros, MV_SHADER_STAGE_PIXEL);
+
+	mvMaterialBindings bindings{};
+	for (int slot = 0; slot < 8; slot++)
+	{
+		if (permutation.bits & (1ull << (MV_PERMUTATION_HAS_BASE_COLOR_MAP + slot)))
+			bindings.pixelSlots[bindings.pixelSlotCount++] = (unsigned char)slot;
+	}
+	bindings.joints = (permutation.bits & (1ull << MV_PERMUTATION_USE_SKINNING)) != 0u;
+	bindings.morphTargets = (permutation.bits & (1ull << MV_PERMUTATION_USE_MORPHING)) != 0u;
+	bindings.instances = (permutation.bits & (1ull << MV_PERMUTATION_USE_INSTANCING)) != 0u;
+	material.bindings = bindings;
+}
+
+// mvMaterialData without its padding
+static const size_t s_materialDataSize = offsetof(mvMaterialData, _padding);
+
+static bool
+same_macros(const std::vector<mvShaderMacro>& left, const std::vector<mvShaderMacro>& right)
+{
+	if (left.size() != right.size())
+		return false;
+	for (size_t i = 0; i < left.size(); i++)
+	{
+		if (left[i].macro != right[i].macro || left[i].value != right[i].value)
+			return false;
+	}
+	return true;
+}
+
+// the factors live in the material buffer, only culling, features and macros change the pipeline
+uint64_t
+hash_material(const mvMaterial& material, const mvVertexLayout& layout, const std::string& pixelShader, const std::string& vertexShader)
+{
+	uint64_t hash = hash_string(pixelShader);
+	hash = hash_string(vertexShader, hash);
+
+	bool doubleSided = material.data.doubleSided != 0;
+	hash = hash_bytes(&doubleSided, sizeof(bool), hash);
+
+	uint32_t features = get_material_features(material);
+	hash = hash_bytes(&features, sizeof(features), hash);
+
+	for (size_t i = 0; i < layout.semantics.size(); i++)
+	{
+		hash = hash_string(layout.semantics[i], hash);
+		hash = hash_bytes(&layout.formats[i], sizeof(DXGI_FORMAT), hash);
+	}
+
+	for (auto& macro : material.macros)
+	{
+		hash = hash_string(macro.macro, hash);
+		hash = hash_string(macro.value, hash);
+	}
+
+	// a list boundary, so moving a macro between the lists changes the key
+	hash = hash_bytes("", 1u, hash);
+	for (auto& macro : material.extramacros)
+	{
+		hash = hash_string(macro.macro, hash);
+		hash = hash_string(macro.value, hash);
+	}
 
 	return hash;
 }
 
-mvMaterial
-create_material(mvGraphics& graphics, const std::string& vs, const std::string& ps, mvMaterial materialInfo)
+uint64_t
+hash_material_data(const mvMaterial& material, uint64_t hash)
+{
+	return hash_bytes(&material.data, s_materialDataSize, hash);
+}
+
+uint64_t
+hash_material_textures(const mvMaterial& material, uint64_t hash)
+{
+	// identical sampler descriptions return the same D3D11 state object
+	const mvTexture* textures[] = {
+		&material.albedoTexture, &material.normalTexture, &material.metalRoughnessTexture, &material.emissiveTexture,
+		&material.occlusionTexture, &material.clearcoatTexture, &material.clearcoatRoughnessTexture, &material.clearcoatNormalTexture };
+
+	for (int i = 0; i < 8; i++)
+	{
+		ID3D11SamplerState* sampler = textures[i]->sampler.Get();
+		hash = hash_bytes(&textures[i]->streamID, sizeof(mvAssetID), hash);
+		hash = hash_bytes(&sampler, sizeof(sampler), hash);
+	}
+	return hash;
+}
+
+bool
+same_material_pipeline(const mvMaterial& left, const mvMaterial& right)
 {
-	mvMaterial material = materialInfo;
+	if ((left.data.doubleSided != 0) != (right.data.doubleSided != 0))
+		return false;
+	if (get_material_features(left) != get_material_features(right))
+		return false;
+	if (left.layout.semantics != right.layout.semantics || left.layout.formats != right.layout.formats)
+		return false;
+	return same_macros(left.macros, right.macros) && same_macros(left.extramacros, right.extramacros);
+}
 
+bool
+same_material_data(const mvMaterial& left, const mvMaterial& right)
+{
+	return memcmp(&left.data, &right.data, s_materialDataSize) == 0;
+}
+
+bool
+same_material_textures(const mvMaterial& left, const mvMaterial& right)
+{
+	const mvTexture* leftTextures[] = {
+		&left.albedoTexture, &left.normalTexture, &left.metalRoughnessTexture, &left.emissiveTexture,
+		&left.occlusionTexture, &left.clearcoatTexture, &left.clearcoatRoughnessTexture, &left.clearcoatNormalTexture };
+	const mvTexture* rightTextures[] = {
+		&right.albedoTexture, &right.normalTexture, &right.metalRoughnessTexture, &right.emissiveTexture,
+		&right.occlusionTexture, &right.clearcoatTexture, &right.clearcoatRoughnessTexture, &right.clearcoatNormalTexture };
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (leftTextures[i]->streamID != rightTextures[i]->streamID || leftTextures[i]->sampler.Get() != rightTextures[i]->sampler.Get())
+			return false;
+	}
+	return true;
+}
+
+mvMaterial
+create_material(mvGraphics& graphics, const std::string& vs, const std::string& ps, mvMaterial material)
+{
 	// regular pipeline
 	{
 		mvPipelineInfo pipelineInfo{};
@@ -50,31 +193,10 @@ create_material(mvGraphics& graphics, const std::string& vs, const std::string&
 		pipelineInfo.depthBias = 0;
 		pipelineInfo.slopeBias = 0.0f;
 		pipelineInfo.clamp = 0.0f;
-		pipelineInfo.cull = !materialInfo.data.doubleSided;
-		pipelineInfo.macros = materialInfo.macros;
-
-		if (graphics.imageBasedLighting) pipelineInfo.macros.push_back({ "USE_IBL" , "0"});
-		if (materialInfo.extensionClearcoat && graphics.clearcoat) pipelineInfo.macros.push_back({ "MATERIAL_CLEARCOAT", "0" });
-		if (materialInfo.pbrMetallicRoughness) pipelineInfo.macros.push_back({ "MATERIAL_METALLICROUGHNESS", "0" });
-		if (materialInfo.alphaMode == 0) pipelineInfo.macros.push_back({ "ALPHAMODE", "0" });
-		else if (materialInfo.alphaMode == 1) pipelineInfo.macros.push_back({ "ALPHAMODE", "1" });
-		else if (materialInfo.alphaMode == 2) pipelineInfo.macros.push_back({ "ALPHAMODE", "2" });
-		if (materialInfo.hasAlbedoMap)pipelineInfo.macros.push_back({ "HAS_BASE_COLOR_MAP", "0" });
-		if (materialInfo.hasNormalMap)pipelineInfo.macros.push_back({ "HAS_NORMAL_MAP", "0" });
-		if (materialInfo.hasMetallicRoughnessMap)pipelineInfo.macros.push_back({ "HAS_METALLIC_ROUGHNESS_MAP", "0" });
-		if (materialInfo.hasEmmissiveMap)pipelineInfo.macros.push_back({ "HAS_EMISSIVE_MAP", "0" });
-		if (materialInfo.hasOcculusionMap)pipelineInfo.macros.push_back({ "HAS_OCCLUSION_MAP", "0" });
-		if (materialInfo.hasClearcoatMap)pipelineInfo.macros.push_back({ "HAS_CLEARCOAT_MAP", "0" });
-		if (materialInfo.hasClearcoatRoughnessMap)pipelineInfo.macros.push_back({ "HAS_CLEARCOAT_ROUGHNESS_MAP", "0" });
-		if (materialInfo.hasClearcoatNormalMap)pipelineInfo.macros.push_back({ "HAS_CLEARCOAT_NORMAL_MAP", "0" });
-		if (graphics.punctualLighting) pipelineInfo.macros.push_back({ "USE_PUNCTUAL", "0" });
-
-		for (auto& macro : materialInfo.extramacros)
-			pipelineInfo.macros.push_back(macro);
-
+		pipelineInfo.cull = !material.data.doubleSided;
+		set_material_macros(graphics, material, pipelineInfo);
 		pipelineInfo.layout = material.layout;
-		material.pipeline = finalize_pipeline(graphics, pipelineInfo);
-		material.buffer = create_const_buffer(graphics, &material.data, sizeof(mvMaterialData));
+		set_material_pipeline(graphics, material, pipelineInfo);
 
 	}
 
@@ -82,34 +204,38 @@ create_material(mvGraphics& graphics, const std::string& vs, const std::string&
 }
 
 mvAssetID
-register_asset(mvMaterialManager* manager, const std::string& tag, mvMaterial asset)
+register_asset(mvMaterialManager* manager, uint64_t key, uint64_t pipelineKey, mvMaterial asset)
 {
-	manager->materials.push_back({ tag, asset });
-	return manager->materials.size()-1;
+	mvAssetID id = (mvAssetID)manager->materials.size();
+	manager->materials.push_back({ key, pipelineKey, std::move(asset) });
+	manager->dataDirty = true;
+
+	// on a collision the first material keeps the slot
+	manager->keys.insert({ key, id });
+	manager->pipelineKeys.insert({ pipelineKey, id });
+	return id;
 }
 
 mvAssetID
-mvGetMaterialAssetID(mvMaterialManager* manager, const std::string& tag)
+mvGetMaterialAssetID(mvMaterialManager* manager, uint64_t key)
 {
+	auto material = manager->keys.find(key);
+	return material == manager->keys.end() ? -1 : material->second;
+}
 
-	for (int i = 0; i < manager->materials.size(); i++)
-	{
-		if (manager->materials[i].hash == tag)
-			return i;
-	}
-	return -1;
+mvAssetID
+mvGetMaterialPipelineID(mvMaterialManager* manager, uint64_t pipelineKey)
+{
+	auto material = manager->pipelineKeys.find(pipelineKey);
+	return material == manager->pipelineKeys.end() ? -1 : material->second;
 }
 
 mvMaterial*
-mvGetRawMaterialAsset(mvMaterialManager* manager, const std::string& tag)
+mvGetRawMaterialAsset(mvMaterialManager* manager, uint64_t key)
 {
-	for (int i = 0; i < manager->materials.size(); i++)
-	{
-		if (manager->materials[i].hash == tag)
-			return &manager->materials[i].asset;
-	}
-	assert(false && "Material not found.");
-	return nullptr;
+	mvAssetID id = mvGetMaterialAssetID(manager, key);
+	assert(id != -1 && "Material not found.");
+	return id == -1 ? nullptr : &manager->materials[id].asset;
 }
 
 void
@@ -120,39 +246,11 @@ reload_materials(mvGraphics& graphics, mvMaterialManager* manager)
 	{
 
 		mvMaterial& material = manager->materials[i].asset;
-		mvPipeline& pipeline = material.pipeline;
-
-		// clear old pipeline
-		material.pipeline.vertexShader = nullptr;
-		material.pipeline.vertexBlob = nullptr;
-		material.pipeline.inputLayout = nullptr;
-		material.pipeline.blendState = nullptr;
-		material.pipeline.depthStencilState = nullptr;
-		material.pipeline.rasterizationState = nullptr;
-		material.pipeline.pixelBlob = nullptr;
-		material.pipeline.pixelShader = nullptr;
-
-		pipeline.info.macros.clear();
-		if (graphics.imageBasedLighting) pipeline.info.macros.push_back({ "USE_IBL", "0" });
-		if (graphics.punctualLighting) pipeline.info.macros.push_back({ "USE_PUNCTUAL", "0" });
-		if (material.extensionClearcoat && graphics.clearcoat) pipeline.info.macros.push_back({ "MATERIAL_CLEARCOAT", "0" });
-		if (material.pbrMetallicRoughness) pipeline.info.macros.push_back({ "MATERIAL_METALLICROUGHNESS", "0" });
-		if (material.alphaMode == 0) pipeline.info.macros.push_back({ "ALPHAMODE", "0" });
-		else if (material.alphaMode == 1) pipeline.info.macros.push_back({ "ALPHAMODE", "1" });
-		else if (material.alphaMode == 2) pipeline.info.macros.push_back({ "ALPHAMODE", "2" });
-		if (material.hasAlbedoMap)pipeline.info.macros.push_back({ "HAS_BASE_COLOR_MAP", "0" });
-		if (material.hasNormalMap)pipeline.info.macros.push_back({ "HAS_NORMAL_MAP", "0" });
-		if (material.hasMetallicRoughnessMap)pipeline.info.macros.push_back({ "HAS_METALLIC_ROUGHNESS_MAP", "0" });
-		if (material.hasEmmissiveMap)pipeline.info.macros.push_back({ "HAS_EMISSIVE_MAP", "0" });
-		if (material.hasOcculusionMap)pipeline.info.macros.push_back({ "HAS_OCCLUSION_MAP", "0" });
-		if (material.hasClearcoatMap)pipeline.info.macros.push_back({ "HAS_CLEARCOAT_MAP", "0" });
-		if (material.hasClearcoatRoughnessMap)pipeline.info.macros.push_back({ "HAS_CLEARCOAT_ROUGHNESS_MAP", "0" });
-		if (material.hasClearcoatNormalMap)pipeline.info.macros.push_back({ "HAS_CLEARCOAT_NORMAL_MAP", "0" });
-
-		for (auto& macro : material.extramacros)
-			pipeline.info.macros.push_back(macro);
-
-		material.pipeline = finalize_pipeline(graphics, pipeline.info);
+
+		// the old pipeline keeps drawing until the new one is compiled
+		mvPipelineInfo info = material.pipeline.info;
+		set_material_macros(graphics, material, info);
+		set_material_pipeline(graphics, material, info);
 	}
 
 
@@ -162,4 +260,43 @@ void
 clear_materials(mvMaterialManager* manager)
 {
 	manager->materials.clear();
+	manager->keys.clear();
+	manager->pipelineKeys.clear();
+	manager->dataBuffer = {};
+	manager->dataCapacity = 0u;
+	manager->dataDirty = false;
+}
+
+void
+set_material_data(mvMaterialManager* manager, mvAssetID id, const mvMaterialData& data)
+{
+	manager->materials[id].asset.data = data;
+	manager->dataDirty = true;
+}
+
+void
+update_material_buffer(mvGraphics& graphics, mvMaterialManager* manager)
+{
+	if (!manager->dataDirty || manager->materials.empty())
+		return;
+
+	std::vector<mvMaterialData> data(manager->materials.size());
+	for (size_t i = 0; i < manager->materials.size(); i++)
+		data[i] = manager->materials[i].asset.data;
+
+	// grow geometrically, materials trickle in one at a time during progressive loads
+	unsigned int count = (unsigned int)data.size();
+	if (count > manager->dataCapacity)
+	{
+		manager->dataCapacity = count > manager->dataCapacity * 2u ? count : manager->dataCapacity * 2u;
+		data.resize(manager->dataCapacity);
+		manager->dataBuffer = create_buffer(graphics, data.data(), manager->dataCapacity * sizeof(mvMaterialData),
+			D3D11_BIND_SHADER_RESOURCE, sizeof(mvMaterialData), D3D11_RESOURCE_MISC_BUFFER_STRUCTURED);
+	}
+	else
+	{
+		D3D11_BOX box = { 0u, 0u, 0u, count * (unsigned int)sizeof(mvMaterialData), 1u, 1u };
+		graphics.imDeviceContext->UpdateSubresource(manager->dataBuffer.buffer.Get(), 0u, &box, data.data(), 0u, 0u);
+	}
+	manager->dataDirty = false;
 }
@@ -1,23 +1,34 @@
 #pragma once
 
 #include <string>
+#include <stdint.h>
+#include <unordered_map>
 #include "sMath.h"
 #include "mvGraphics.h"
 
 // forward declarations
 struct mvMaterial;
+struct mvMaterialBindings;
 struct mvMaterialData;
 struct mvVertexLayout;
 struct mvMaterialAsset;
 struct mvMaterialManager;
 
-mvMaterial  create_material(mvGraphics& graphics, const std::string& vs, const std::string& ps, mvMaterial materialInfo);
-std::string hash_material (const mvMaterial& materialInfo, const mvVertexLayout& layout, const std::string& pixelShader, const std::string& vertexShader);
-mvAssetID   register_asset(mvMaterialManager* manager, const std::string& tag, mvMaterial asset);
+mvMaterial  create_material(mvGraphics& graphics, const std::string& vs, const std::string& ps, mvMaterial material);
+uint64_t    hash_material (const mvMaterial& material, const mvVertexLayout& layout, const std::string& pixelShader, const std::string& vertexShader);
+uint64_t    hash_material_textures(const mvMaterial& material, uint64_t hash);
+uint64_t    hash_material_data    (const mvMaterial& material, uint64_t hash); // factors, only part of the per-material key
+bool        same_material_pipeline(const mvMaterial& left, const mvMaterial& right); // collision checks for the hashes above
+bool        same_material_textures(const mvMaterial& left, const mvMaterial& right);
+bool        same_material_data    (const mvMaterial& left, const mvMaterial& right);
+mvAssetID   register_asset(mvMaterialManager* manager, uint64_t key, uint64_t pipelineKey, mvMaterial asset);
 void        clear_materials(mvMaterialManager* manager);
+void        set_material_data(mvMaterialManager* manager, mvAssetID id, const mvMaterialData& data);
+void        update_material_buffer(mvGraphics& graphics, mvMaterialManager* manager); // uploads only when dirty
 void        reload_materials(mvGraphics& graphics, mvMaterialManager* manager);
-mvAssetID   mvGetMaterialAssetID(mvMaterialManager* manager, const std::string& tag);
-mvMaterial* mvGetRawMaterialAsset(mvMaterialManager* manager, const std::string& tag);
+mvAssetID   mvGetMaterialAssetID(mvMaterialManager* manager, uint64_t key);
+mvAssetID   mvGetMaterialPipelineID(mvMaterialManager* manager, uint64_t pipelineKey); // first material built with it
+mvMaterial* mvGetRawMaterialAsset(mvMaterialManager* manager, uint64_t key);
 
 struct mvMaterialData
 {
@@ -60,14 +71,35 @@ struct mvMaterialData
 
 };
 
+// the texture slots a material's permutation reads, render_job binds nothing else
+struct mvMaterialBindings
+{
+    unsigned char pixelSlots[8] = {};      // PBR_PS t/s registers, same order as mvMaterial's textures
+    unsigned int  pixelSlotCount = 0u;
+    bool          joints = false;          // PBR_VS t0/s0, USE_SKINNING
+    bool          morphTargets = false;    // PBR_VS t1/s1, USE_MORPHING
+    bool          instances = false;       // PBR_VS t2, USE_INSTANCING
+};
+
 struct mvMaterial
 {
-    mvConstBuffer              buffer;
     mvMaterialData             data;
     mvPipeline                 pipeline; 
+    uint64_t                   pendingPipeline = 0u; // request_pipeline key, pipeline is the previous or fallback one until it lands
     std::vector<mvShaderMacro> macros;
     std::vector<mvShaderMacro> extramacros;
     mvVertexLayout             layout;
+    mvMaterialBindings         bindings; // set with the macros
+
+    // textures
+    mvTexture albedoTexture;
+    mvTexture normalTexture;
+    mvTexture metalRoughnessTexture;
+    mvTexture emissiveTexture;
+    mvTexture occlusionTexture;
+    mvTexture clearcoatTexture;
+    mvTexture clearcoatRoughnessTexture;
+    mvTexture clearcoatNormalTexture;
 
     int alphaMode = 0;
     bool hasNormalMap = false;
@@ -96,11 +128,20 @@ struct mvMaterial
 
 struct mvMaterialAsset
 {
-    std::string hash;
+    uint64_t   key = 0u;         // pipelineKey and textures
+    uint64_t   pipelineKey = 0u; // hash_material
     mvMaterial asset;
 };
 
 struct mvMaterialManager
 {
-    std::vector<mvMaterialAsset> materials;
+    std::vector<mvMaterialAsset>            materials;
+    std::unordered_map<uint64_t, mvAssetID> keys;
+    std::unordered_map<uint64_t, mvAssetID> pipelineKeys;
+    unsigned int                            collisions = 0u; // hash matches that failed the structural check
+
+    // every material's data in one structured buffer, indexed by mvAssetID
+    mvBuffer                                dataBuffer;
+    unsigned int                            dataCapacity = 0u; // materials
+    bool                                    dataDirty = false;
 };
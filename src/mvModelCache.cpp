@@ -0,0 +1,102 @@
+#include "mvModelCache.h"
+#include <assert.h>
+#include "mvGraphics.h"
+
+static void
+evict_cached_model(mvGraphics& graphics, mvModelCache& cache, mvAssetID id)
+{
+    mvModelCacheEntry& entry = cache.entries[id];
+    cache.cpuBytes -= entry.model.cpuBytes;
+    cache.gpuBytes -= entry.model.gpuBytes;
+    unload_gltf_assets(graphics, entry.model);
+    entry.model = {};
+    trim_state_cache(graphics.stateCache);
+    entry.key = -1;
+    entry.pinned = false;
+}
+
+mvAssetID
+find_cached_model(mvModelCache& cache, int key)
+{
+    for (int i = 0; i < cache.entries.size(); i++)
+    {
+        if (cache.entries[i].key == key)
+        {
+            cache.entries[i].lastUsed = ++cache.tick;
+            cache.hits++;
+            return i;
+        }
+    }
+
+    cache.misses++;
+    return -1;
+}
+
+mvAssetID
+insert_cached_model(mvGraphics& graphics, mvModelCache& cache, int key, mvModel model)
+{
+    size_t size = model.cpuBytes + model.gpuBytes;
+
+    // evict least recently used until the new model fits
+    while (cache.cpuBytes + cache.gpuBytes + size > cache.budget)
+    {
+        mvAssetID victim = -1;
+        for (int i = 0; i < cache.entries.size(); i++)
+        {
+            mvModelCacheEntry& entry = cache.entries[i];
+            if (entry.key == -1 || entry.pinned)
+                continue;
+            if (victim == -1 || entry.lastUsed < cache.entries[victim].lastUsed)
+                victim = i;
+        }
+
+        // everything left is pinned, allow going over budget
+        if (victim == -1)
+            break;
+
+        evict_cached_model(graphics, cache, victim);
+        cache.evictions++;
+    }
+
+    mvAssetID id = -1;
+    for (int i = 0; i < cache.entries.size(); i++)
+    {
+        if (cache.entries[i].key == -1)
+        {
+            id = i;
+            break;
+        }
+    }
+    if (id == -1)
+    {
+        cache.entries.push_back({});
+        id = (mvAssetID)cache.entries.size() - 1;
+    }
+
+    mvModelCacheEntry& entry = cache.entries[id];
+    entry.key = key;
+    entry.model = std::move(model);
+    entry.lastUsed = ++cache.tick;
+    entry.pinned = false;
+    cache.cpuBytes += entry.model.cpuBytes;
+    cache.gpuBytes += entry.model.gpuBytes;
+    return id;
+}
+
+void
+pin_cached_model(mvModelCache& cache, mvAssetID id, bool pinned)
+{
+    assert(id > -1 && id < cache.entries.size());
+    cache.entries[id].pinned = pinned;
+}
+
+void
+clear_model_cache(mvGraphics& graphics, mvModelCache& cache)
+{
+    for (int i = 0; i < cache.entries.size(); i++)
+    {
+        if (cache.entries[i].key != -1)
+            evict_cached_model(graphics, cache, i);
+    }
+    cache.entries.clear();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include "mvCamera.h"
+#include "mvAnimation.h"
+#include "mvAssetLoader.h"
+
+// forward declarations
+struct mvGraphics;
+struct mvModelCacheEntry;
+struct mvModelCache;
+
+mvAssetID find_cached_model  (mvModelCache& cache, int key);
+mvAssetID insert_cached_model(mvGraphics& graphics, mvModelCache& cache, int key, mvModel model);
+void      pin_cached_model   (mvModelCache& cache, mvAssetID id, bool pinned);
+void      clear_model_cache  (mvGraphics& graphics, mvModelCache& cache);
+
+struct mvModelCacheEntry
+{
+    int                key = -1; // -1 marks a free slot
+    mvModel            model;
+    unsigned long long lastUsed = 0u;
+    bool               pinned = false;
+};
+
+struct mvModelCache
+{
+    std::vector<mvModelCacheEntry> entries; // slots are reused, ids stay stable
+    size_t                         budget = 1024u * 1024u * 1024u;
+    unsigned long long             tick = 0u;
+
+    // stats
+    size_t       cpuBytes = 0u;
+    size_t       gpuBytes = 0u;
+    unsigned int hits = 0u;
+    unsigned int misses = 0u;
+    unsigned int evictions = 0u;
+};
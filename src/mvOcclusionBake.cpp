@@ -0,0 +1,389 @@
+#include "mvOcclusionBake.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+#include <xmmintrin.h>
+#include "mvAssetLoader.h"
+#include "mvHash.h"
+
+// BVH over every triangle of the baked primitives. Leaves hold up to four
+// triangles in SoA form so a ray tests them with one SSE pass.
+
+struct mvTrianglePack
+{
+    alignas(16) float v0[3][4];
+    alignas(16) float e1[3][4];
+    alignas(16) float e2[3][4]; // unused lanes stay zero, zero edges never hit
+};
+
+struct mvBVHNode
+{
+    float        minBound[3];
+    float        maxBound[3];
+    unsigned int first = 0u; // left child (right is first + 1), or pack for leaves
+    unsigned int count = 0u; // triangles in a leaf, 0 for inner nodes
+};
+
+struct mvBVH
+{
+    std::vector<mvBVHNode>      nodes;
+    std::vector<mvTrianglePack> packs;
+};
+
+static void
+build_bvh_node(mvBVH& bvh, unsigned int nodeIndex, const std::vector<float>& triangles, const std::vector<float>& centroids, std::vector<unsigned int>& order, unsigned int begin, unsigned int end)
+{
+    mvBVHNode node{};
+    for (int c = 0; c < 3; c++)
+    {
+        node.minBound[c] = FLT_MAX;
+        node.maxBound[c] = -FLT_MAX;
+    }
+
+    float centroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float centroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (unsigned int i = begin; i < end; i++)
+    {
+        const float* triangle = &triangles[order[i] * 9];
+        for (int v = 0; v < 3; v++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                node.minBound[c] = fminf(node.minBound[c], triangle[v * 3 + c]);
+                node.maxBound[c] = fmaxf(node.maxBound[c], triangle[v * 3 + c]);
+            }
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            centroidMin[c] = fminf(centroidMin[c], centroids[order[i] * 3 + c]);
+            centroidMax[c] = fmaxf(centroidMax[c], centroids[order[i] * 3 + c]);
+        }
+    }
+
+    if (end - begin <= 4u)
+    {
+        mvTrianglePack pack{};
+        for (unsigned int i = begin; i < end; i++)
+        {
+            const float* triangle = &triangles[order[i] * 9];
+            for (int c = 0; c < 3; c++)
+            {
+                pack.v0[c][i - begin] = triangle[c];
+                pack.e1[c][i - begin] = triangle[3 + c] - triangle[c];
+                pack.e2[c][i - begin] = triangle[6 + c] - triangle[c];
+            }
+        }
+        node.first = (unsigned int)bvh.packs.size();
+        node.count = end - begin;
+        bvh.packs.push_back(pack);
+        bvh.nodes[nodeIndex] = node;
+        return;
+    }
+
+    // median split on the widest centroid axis
+    int axis = 0;
+    for (int c = 1; c < 3; c++)
+    {
+        if (centroidMax[c] - centroidMin[c] > centroidMax[axis] - centroidMin[axis])
+            axis = c;
+    }
+    unsigned int middle = begin + (end - begin) / 2u;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+        [&centroids, axis](unsigned int left, unsigned int right) { return centroids[left * 3 + axis] < centroids[right * 3 + axis]; });
+
+    node.first = (unsigned int)bvh.nodes.size();
+    bvh.nodes[nodeIndex] = node;
+    bvh.nodes.resize(bvh.nodes.size() + 2u);
+    build_bvh_node(bvh, node.first, triangles, centroids, order, begin, middle);
+    build_bvh_node(bvh, node.first + 1u, triangles, centroids, order, middle, end);
+}
+
+static bool
+intersect_box(const mvBVHNode& node, const float* origin, const float* invDirection, float maxDistance)
+{
+    float nearest = 0.0f;
+    float farthest = maxDistance;
+    for (int c = 0; c < 3; c++)
+    {
+        float t0 = (node.minBound[c] - origin[c]) * invDirection[c];
+        float t1 = (node.maxBound[c] - origin[c]) * invDirection[c];
+        nearest = fmaxf(nearest, fminf(t0, t1));
+        farthest = fminf(farthest, fmaxf(t0, t1));
+        if (nearest > farthest)
+            return false;
+    }
+    return true;
+}
+
+// Moller-Trumbore against four triangles, true on any hit closer than maxDistance
+static bool
+intersect_pack(const mvTrianglePack& pack, const float* origin, const float* direction, float maxDistance)
+{
+    const __m128 epsilon = _mm_set1_ps(1e-8f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 dx = _mm_set1_ps(direction[0]);
+    __m128 dy = _mm_set1_ps(direction[1]);
+    __m128 dz = _mm_set1_ps(direction[2]);
+    __m128 e1x = _mm_load_ps(pack.e1[0]);
+    __m128 e1y = _mm_load_ps(pack.e1[1]);
+    __m128 e1z = _mm_load_ps(pack.e1[2]);
+    __m128 e2x = _mm_load_ps(pack.e2[0]);
+    __m128 e2y = _mm_load_ps(pack.e2[1]);
+    __m128 e2z = _mm_load_ps(pack.e2[2]);
+
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 valid = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det), epsilon);
+    __m128 invDet = _mm_div_ps(one, det);
+
+    __m128 tx = _mm_sub_ps(_mm_set1_ps(origin[0]), _mm_load_ps(pack.v0[0]));
+    __m128 ty = _mm_sub_ps(_mm_set1_ps(origin[1]), _mm_load_ps(pack.v0[1]));
+    __m128 tz = _mm_sub_ps(_mm_set1_ps(origin[2]), _mm_load_ps(pack.v0[2]));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+    // q = t x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+    valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, zero));
+    valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(maxDistance)));
+    return _mm_movemask_ps(valid) != 0;
+}
+
+static bool
+is_occluded(const mvBVH& bvh, const float* origin, const float* direction, float maxDistance)
+{
+    float invDirection[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+
+    unsigned int stack[64];
+    int top = 0;
+    stack[top++] = 0u;
+    while (top > 0)
+    {
+        const mvBVHNode& node = bvh.nodes[stack[--top]];
+        if (!intersect_box(node, origin, invDirection, maxDistance))
+            continue;
+
+        if (node.count > 0u)
+        {
+            if (intersect_pack(bvh.packs[node.first], origin, direction, maxDistance))
+                return true;
+            continue;
+        }
+
+        stack[top++] = node.first;
+        stack[top++] = node.first + 1u;
+    }
+    return false;
+}
+
+static int
+find_semantic(const mvVertexLayout& layout, const char* semantic)
+{
+    for (size_t i = 0; i < layout.semantics.size(); i++)
+    {
+        if (layout.semantics[i] == semantic)
+            return (int)(layout.offsets[i] / sizeof(float));
+    }
+    return -1;
+}
+
+void
+bake_vertex_occlusion(std::vector<mvCookedPrimitive*>& primitives, const mvOcclusionSettings& settings)
+{
+    // triangles of every primitive, plus one sample per distinct position/normal pair
+    std::vector<float> triangles;
+    std::vector<float> samplePositions;
+    std::vector<float> sampleNormals;
+    std::vector<std::vector<unsigned int>> sampleIndices(primitives.size());
+    std::unordered_map<uint64_t, unsigned int> sampleLookup;
+    float minBound[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maxBound[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (size_t p = 0; p < primitives.size(); p++)
+    {
+        mvCookedPrimitive& cooked = *primitives[p];
+        int position = find_semantic(cooked.layout, "Position");
+        int normal = find_semantic(cooked.layout, "Normal");
+        unsigned int stride = cooked.layout.size / sizeof(float);
+        if (position == -1 || normal == -1 || stride == 0u)
+            continue;
+
+        for (size_t i = 0; i + 2 < cooked.indexData.size(); i += 3)
+        {
+            for (int v = 0; v < 3; v++)
+            {
+                const float* vertex = &cooked.vertexData[cooked.indexData[i + v] * stride + position];
+                triangles.insert(triangles.end(), vertex, vertex + 3);
+            }
+        }
+
+        size_t vertexCount = cooked.vertexData.size() / stride;
+        sampleIndices[p].resize(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            const float* vertex = &cooked.vertexData[v * stride];
+            uint64_t key = hash_bytes(&vertex[position], sizeof(float) * 3);
+            key = hash_bytes(&vertex[normal], sizeof(float) * 3, key);
+            auto sample = sampleLookup.find(key);
+            if (sample == sampleLookup.end())
+            {
+                sample = sampleLookup.insert({ key, (unsigned int)(samplePositions.size() / 3) }).first;
+                samplePositions.insert(samplePositions.end(), &vertex[position], &vertex[position] + 3);
+                sampleNormals.insert(sampleNormals.end(), &vertex[normal], &vertex[normal] + 3);
+                for (int c = 0; c < 3; c++)
+                {
+                    minBound[c] = fminf(minBound[c], vertex[position + c]);
+                    maxBound[c] = fmaxf(maxBound[c], vertex[position + c]);
+                }
+            }
+            sampleIndices[p][v] = sample->second;
+        }
+    }
+
+    unsigned int sampleCount = (unsigned int)(samplePositions.size() / 3);
+    std::vector<float> occlusion(sampleCount, 1.0f);
+
+    unsigned int triangleCount = (unsigned int)(triangles.size() / 9);
+    if (triangleCount > 0u && sampleCount > 0u)
+    {
+        mvBVH bvh;
+        std::vector<float> centroids(triangleCount * 3);
+        std::vector<unsigned int> order(triangleCount);
+        for (unsigned int i = 0; i < triangleCount; i++)
+        {
+            order[i] = i;
+            for (int c = 0; c < 3; c++)
+                centroids[i * 3 + c] = (triangles[i * 9 + c] + triangles[i * 9 + 3 + c] + triangles[i * 9 + 6 + c]) / 3.0f;
+        }
+        bvh.nodes.reserve(triangleCount / 2u + 1u);
+        bvh.packs.reserve(triangleCount / 2u + 1u);
+        bvh.nodes.resize(1);
+        build_bvh_node(bvh, 0u, triangles, centroids, order, 0u, triangleCount);
+
+        float extent[3] = { maxBound[0] - minBound[0], maxBound[1] - minBound[1], maxBound[2] - minBound[2] };
+        float diagonal = sqrtf(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+        float maxDistance = diagonal * settings.maxDistance;
+        float bias = diagonal * 1e-4f;
+
+        // cosine weighted hemisphere (Hammersley), rotated per sample to break up banding
+        unsigned int rayCount = settings.rayCount > 0u ? settings.rayCount : 1u;
+        std::vector<float> directions(rayCount * 3);
+        for (unsigned int i = 0; i < rayCount; i++)
+        {
+            unsigned int bits = i;
+            bits = (bits << 16u) | (bits >> 16u);
+            bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+            bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+            bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+            bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+            float u1 = (i + 0.5f) / rayCount;
+            float phi = 2.0f * (float)M_PI * (bits * 2.3283064365386963e-10f);
+            float r = sqrtf(u1);
+            directions[i * 3] = r * cosf(phi);
+            directions[i * 3 + 1] = r * sinf(phi);
+            directions[i * 3 + 2] = sqrtf(fmaxf(0.0f, 1.0f - u1));
+        }
+
+        std::atomic<unsigned int> nextSample = 0u;
+        auto worker = [&]()
+        {
+            const unsigned int chunk = 64u;
+            for (unsigned int start = nextSample.fetch_add(chunk); start < sampleCount; start = nextSample.fetch_add(chunk))
+            {
+                unsigned int end = std::min(start + chunk, sampleCount);
+                for (unsigned int s = start; s < end; s++)
+                {
+                    float n[3] = { sampleNormals[s * 3], sampleNormals[s * 3 + 1], sampleNormals[s * 3 + 2] };
+                    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    if (length <= 0.0f)
+                        continue;
+                    n[0] /= length; n[1] /= length; n[2] /= length;
+
+                    // orthonormal basis around the normal (Duff et al. 2017)
+                    float sign = copysignf(1.0f, n[2]);
+                    float a = -1.0f / (sign + n[2]);
+                    float b = n[0] * n[1] * a;
+                    float tangent[3] = { 1.0f + sign * n[0] * n[0] * a, sign * b, -sign * n[0] };
+                    float bitangent[3] = { b, sign + n[1] * n[1] * a, -n[1] };
+
+                    float rotation = 2.0f * (float)M_PI * fmodf(s * 0.6180339887f, 1.0f);
+                    float cr = cosf(rotation);
+                    float sr = sinf(rotation);
+
+                    float origin[3];
+                    for (int c = 0; c < 3; c++)
+                        origin[c] = samplePositions[s * 3 + c] + n[c] * bias;
+
+                    unsigned int hits = 0u;
+                    for (unsigned int i = 0; i < rayCount; i++)
+                    {
+                        float x = directions[i * 3] * cr - directions[i * 3 + 1] * sr;
+                        float y = directions[i * 3] * sr + directions[i * 3 + 1] * cr;
+                        float z = directions[i * 3 + 2];
+                        float direction[3];
+                        for (int c = 0; c < 3; c++)
+                            direction[c] = tangent[c] * x + bitangent[c] * y + n[c] * z;
+                        if (is_occluded(bvh, origin, direction, maxDistance))
+                            hits++;
+                    }
+                    occlusion[s] = 1.0f - (float)hits / rayCount;
+                }
+            }
+        };
+
+        unsigned int threadCount = settings.threadCount > 0u ? settings.threadCount : std::thread::hardware_concurrency();
+        threadCount = std::max(1u, std::min(threadCount, (sampleCount + 63u) / 64u));
+        std::vector<std::thread> threads;
+        for (unsigned int i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    // interleave the result as a trailing float per vertex
+    for (size_t p = 0; p < primitives.size(); p++)
+    {
+        mvCookedPrimitive& cooked = *primitives[p];
+        unsigned int stride = cooked.layout.size / sizeof(float);
+        size_t vertexCount = sampleIndices[p].size();
+
+        std::vector<float> vertices;
+        vertices.reserve(vertexCount * (stride + 1u));
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            vertices.insert(vertices.end(), &cooked.vertexData[v * stride], &cooked.vertexData[v * stride] + stride);
+            vertices.push_back(occlusion[sampleIndices[p][v]]);
+        }
+        if (vertexCount == 0u && stride > 0u)
+        {
+            // no position/normal, still give the primitive a fully open term
+            vertexCount = cooked.vertexData.size() / stride;
+            for (size_t v = 0; v < vertexCount; v++)
+            {
+                vertices.insert(vertices.end(), &cooked.vertexData[v * stride], &cooked.vertexData[v * stride] + stride);
+                vertices.push_back(1.0f);
+            }
+        }
+
+        cooked.vertexData = std::move(vertices);
+        append_vertex_element(cooked.layout, Occlusion);
+        append_vertex_element(cooked.material.layout, Occlusion);
+        cooked.material.extramacros.push_back({ "HAS_VERTEX_OCCLUSION", "1" });
+    }
+}
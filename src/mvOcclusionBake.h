@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+// forward declarations
+struct mvCookedPrimitive;
+struct mvOcclusionSettings;
+
+// appends an Occlusion vertex element (1 = open, 0 = fully occluded) to every primitive,
+// the primitives occlude each other so pass all primitives of a mesh together
+void bake_vertex_occlusion(std::vector<mvCookedPrimitive*>& primitives, const mvOcclusionSettings& settings);
+
+struct mvOcclusionSettings
+{
+    unsigned int rayCount    = 64u;
+    float        maxDistance = 0.25f; // fraction of the bounding box diagonal
+    unsigned int threadCount = 0u;    // 0 for std::thread::hardware_concurrency
+};
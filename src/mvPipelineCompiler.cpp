@@ -0,0 +1,236 @@
+#include "mvPipelineCompiler.h"
+#include <assert.h>
+#include <algorithm>
+#include "mvHash.h"
+
+static uint64_t
+hash_pipeline_info(mvGraphics& graphics, mvPipelineInfo& info)
+{
+    // the shader sources are part of the key so an edited shader recompiles on the next reload
+    std::string directory = graphics.shaderDirectory;
+    uint64_t hash = get_shader_source_key(graphics.shaderCache, directory + info.vertexShader);
+    hash = hash_string(info.vertexShader, hash);
+    if (!info.pixelShader.empty())
+    {
+        uint64_t pixelKey = get_shader_source_key(graphics.shaderCache, directory + info.pixelShader);
+        hash = hash_bytes(&pixelKey, sizeof(uint64_t), hash);
+        hash = hash_string(info.pixelShader, hash);
+    }
+
+    for (size_t i = 0; i < info.layout.semantics.size(); i++)
+    {
+        hash = hash_string(info.layout.semantics[i], hash);
+        hash = hash_bytes(&info.layout.indices[i], sizeof(info.layout.indices[i]), hash);
+        hash = hash_bytes(&info.layout.formats[i], sizeof(DXGI_FORMAT), hash);
+    }
+
+    const std::vector<mvShaderMacro>* macroLists[] = { &info.macros, &info.vertexMacros, &info.pixelMacros };
+    for (const std::vector<mvShaderMacro>* macros : macroLists)
+    {
+        for (auto& macro : *macros)
+        {
+            hash = hash_bytes(macro.macro.c_str(), macro.macro.size() + 1u, hash);
+            hash = hash_bytes(macro.value.c_str(), macro.value.size() + 1u, hash);
+        }
+
+        // a list boundary, so moving a macro between stages changes the key
+        hash = hash_bytes("", 1u, hash);
+    }
+
+    hash = hash_bytes(&info.depthBias, sizeof(int), hash);
+    hash = hash_bytes(&info.slopeBias, sizeof(float), hash);
+    hash = hash_bytes(&info.clamp, sizeof(float), hash);
+    hash = hash_bytes(&info.cull, sizeof(bool), hash);
+    return hash;
+}
+
+static void
+compile_pipelines(mvGraphics* graphics, mvPipelineCompiler* compiler)
+{
+    while (true)
+    {
+        uint64_t key = 0u;
+        mvPipelineInfo info;
+        {
+            std::unique_lock<std::mutex> lock(compiler->mutex);
+            compiler->wake.wait(lock, [compiler] { return compiler->stopping || !compiler->queue.empty(); });
+            if (compiler->stopping)
+                return;
+            key = compiler->queue.front();
+            compiler->queue.pop_front();
+            info = compiler->compiles[key].info;
+        }
+
+        // the device is free threaded and the shader cache locks itself
+        mvPipeline pipeline = finalize_pipeline(*graphics, info);
+
+        std::lock_guard<std::mutex> lock(compiler->mutex);
+        mvPipelineCompile& compile = compiler->compiles[key];
+        compile.failed = pipeline.vertexShader.Get() == nullptr;
+        if (!compile.failed)
+            compile.pipeline = std::move(pipeline);
+        compile.ready = true;
+        compiler->pending--;
+        compiler->completed++;
+        if (compile.failed)
+            compiler->failed++;
+
+        // every material moved on while it was compiling
+        if (compile.waiters == 0u)
+            compiler->compiles.erase(key);
+    }
+}
+
+void
+start_pipeline_compiler(mvGraphics& graphics, unsigned int threadCount)
+{
+    assert(graphics.pipelineCompiler == nullptr);
+    mvPipelineCompiler* compiler = new mvPipelineCompiler();
+
+    // fallback, compiled up front so it is always available
+    mvPipeline& fallback = compiler->fallback;
+    fallback.topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+    D3D11_RASTERIZER_DESC rasterDesc = CD3D11_RASTERIZER_DESC(CD3D11_DEFAULT{});
+    rasterDesc.CullMode = D3D11_CULL_NONE;
+    rasterDesc.FrontCounterClockwise = TRUE;
+    fallback.rasterizationState = get_rasterizer_state(graphics, rasterDesc);
+    fallback.depthStencilState = get_depth_stencil_state(graphics, CD3D11_DEPTH_STENCIL_DESC{ CD3D11_DEFAULT{} });
+    fallback.blendState = get_blend_state(graphics, CD3D11_BLEND_DESC{ CD3D11_DEFAULT{} });
+
+    mvPixelShader pixelShader = create_pixel_shader(graphics, std::string(graphics.shaderDirectory) + "Fallback_PS.hlsl");
+    mvVertexLayout layout = create_vertex_layout({ Position3D });
+    mvVertexShader vertexShader = create_vertex_shader(graphics, std::string(graphics.shaderDirectory) + "Solid_VS.hlsl", layout);
+    fallback.pixelShader = pixelShader.shader;
+    fallback.pixelBlob = pixelShader.blob;
+    fallback.vertexShader = vertexShader.shader;
+    fallback.vertexBlob = vertexShader.blob;
+
+    // leave a core for the render thread
+    if (threadCount == 0u)
+        threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1u;
+    for (unsigned int i = 0; i < threadCount; i++)
+        compiler->workers.emplace_back(compile_pipelines, &graphics, compiler);
+
+    graphics.pipelineCompiler = compiler;
+}
+
+void
+stop_pipeline_compiler(mvGraphics& graphics)
+{
+    mvPipelineCompiler* compiler = graphics.pipelineCompiler;
+    if (compiler == nullptr)
+        return;
+
+    // queued compiles are dropped, running ones finish first
+    {
+        std::lock_guard<std::mutex> lock(compiler->mutex);
+        compiler->stopping = true;
+    }
+    compiler->wake.notify_all();
+    for (auto& worker : compiler->workers)
+        worker.join();
+
+    delete compiler;
+    graphics.pipelineCompiler = nullptr;
+}
+
+uint64_t
+request_pipeline(mvGraphics& graphics, mvPipelineInfo& info)
+{
+    mvPipelineCompiler* compiler = graphics.pipelineCompiler;
+    uint64_t key = hash_pipeline_info(graphics, info);
+
+    std::lock_guard<std::mutex> lock(compiler->mutex);
+    auto existing = compiler->compiles.find(key);
+    if (existing != compiler->compiles.end())
+    {
+        existing->second.waiters++;
+        return key;
+    }
+
+    mvPipelineCompile& compile = compiler->compiles[key];
+    compile.info = info;
+    compile.waiters = 1u;
+    compiler->queue.push_back(key);
+    compiler->pending++;
+    compiler->wake.notify_one();
+    return key;
+}
+
+bool
+poll_pipeline(mvGraphics& graphics, uint64_t key, mvPipeline& pipeline)
+{
+    mvPipelineCompiler* compiler = graphics.pipelineCompiler;
+    if (compiler == nullptr)
+        return false;
+
+    std::lock_guard<std::mutex> lock(compiler->mutex);
+    auto compile = compiler->compiles.find(key);
+    if (compile == compiler->compiles.end() || !compile->second.ready)
+        return false;
+
+    // the material keeps drawing with its previous or fallback pipeline
+    if (!compile->second.failed)
+        pipeline = compile->second.pipeline;
+
+    // handed out, the pipeline's objects now live only as long as the materials using them
+    if (--compile->second.waiters == 0u)
+        compiler->compiles.erase(compile);
+    return true;
+}
+
+void
+retain_pipeline(mvGraphics& graphics, uint64_t key)
+{
+    mvPipelineCompiler* compiler = graphics.pipelineCompiler;
+    if (compiler == nullptr || key == 0u)
+        return;
+
+    std::lock_guard<std::mutex> lock(compiler->mutex);
+    auto compile = compiler->compiles.find(key);
+    if (compile != compiler->compiles.end())
+        compile->second.waiters++;
+}
+
+void
+release_pipeline(mvGraphics& graphics, uint64_t key)
+{
+    mvPipelineCompiler* compiler = graphics.pipelineCompiler;
+    if (compiler == nullptr || key == 0u)
+        return;
+
+    // a running compile is erased by its worker when it finishes
+    std::lock_guard<std::mutex> lock(compiler->mutex);
+    auto compile = compiler->compiles.find(key);
+    if (compile == compiler->compiles.end() || compile->second.waiters == 0u)
+        return;
+    if (--compile->second.waiters == 0u && compile->second.ready)
+        compiler->compiles.erase(compile);
+}
+
+mvPipeline
+get_fallback_pipeline(mvGraphics& graphics, mvPipelineInfo& info)
+{
+    mvPipeline pipeline = graphics.pipelineCompiler->fallback;
+    pipeline.info = info;
+
+    // only Position is read, the rest of the layout sets the element offsets
+    std::vector<D3D11_INPUT_ELEMENT_DESC> elements;
+    for (int i = 0; i < info.layout.semantics.size(); i++)
+    {
+        elements.push_back(D3D11_INPUT_ELEMENT_DESC{
+            info.layout.semantics[i].c_str(),
+            info.layout.indices[i],
+            info.layout.formats[i],
+            0,
+            D3D11_APPEND_ALIGNED_ELEMENT,
+            D3D11_INPUT_PER_VERTEX_DATA,
+            0
+            });
+    }
+
+    pipeline.inputLayout = get_input_layout(graphics, elements.data(), (unsigned int)elements.size(), pipeline.vertexBlob.Get());
+
+    return pipeline;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include "mvGraphics.h"
+
+// forward declarations
+struct mvPipelineCompile;
+struct mvPipelineCompiler;
+
+// while running, materials compile on worker threads instead of blocking the frame
+void       start_pipeline_compiler(mvGraphics& graphics, unsigned int threadCount = 0u); // 0 for hardware_concurrency - 1
+void       stop_pipeline_compiler (mvGraphics& graphics);
+uint64_t   request_pipeline       (mvGraphics& graphics, mvPipelineInfo& info); // queues a compile unless one is running or done, the caller waits on the key
+bool       poll_pipeline          (mvGraphics& graphics, uint64_t key, mvPipeline& pipeline); // true once done and the wait is over, pipeline is left alone if the compile failed
+void       retain_pipeline        (mvGraphics& graphics, uint64_t key); // another material waits on the same key
+void       release_pipeline       (mvGraphics& graphics, uint64_t key); // stop waiting without polling
+mvPipeline get_fallback_pipeline  (mvGraphics& graphics, mvPipelineInfo& info); // flat base color, no skinning/morphing/instancing
+
+struct mvPipelineCompile
+{
+    mvPipelineInfo info;
+    mvPipeline     pipeline;
+    bool           ready = false;
+    bool           failed = false; // a shader didn't compile, see report_shader_error
+    unsigned int   waiters = 0u;   // materials still holding the key, erased once none are left and it is ready
+};
+
+struct mvPipelineCompiler
+{
+    std::vector<std::thread>                        workers;
+    std::mutex                                      mutex;
+    std::condition_variable                         wake;
+    std::deque<uint64_t>                            queue;
+    std::unordered_map<uint64_t, mvPipelineCompile> compiles; // running or finished ones are shared while waited on
+    bool                                            stopping = false;
+    mvPipeline                                      fallback; // input layout is created per vertex layout
+
+    // stats
+    std::atomic<unsigned int> pending = 0u;
+    std::atomic<unsigned int> completed = 0u;
+    std::atomic<unsigned int> failed = 0u;
+};
@@ -0,0 +1,349 @@
+#include "mvShaderCache.h"
+#include <d3dcompiler.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include "mvHash.h"
+
+// guards every mvShaderCache, compiles themselves run unlocked
+static std::mutex s_shaderCacheMutex;
+
+struct mvShaderCacheHeader
+{
+    char     magic[4];
+    int      version;
+    uint64_t key;
+    uint64_t size;
+};
+
+// followed by one mvShaderCacheHeader and blob per entry
+struct mvShaderArchiveHeader
+{
+    char     magic[4];
+    int      version;
+    uint64_t count;
+};
+
+static std::wstring
+to_wide(const std::string& narrow)
+{
+    wchar_t wide[1024];
+    mbstowcs_s(nullptr, wide, narrow.c_str(), _TRUNCATE);
+    return wide;
+}
+
+static void
+parse_shader_includes(const std::string& path, const std::string& source, std::vector<std::string>& includes)
+{
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    if (!directory.empty())
+        directory += "/";
+
+    // D3D_COMPILE_STANDARD_FILE_INCLUDE resolves both forms relative to the including file,
+    // commented out includes are picked up too which only costs an extra hash
+    size_t position = 0u;
+    while ((position = source.find("#include", position)) != std::string::npos)
+    {
+        position += 8u;
+        size_t start = source.find_first_of("\"<\n", position);
+        if (start == std::string::npos || source[start] == '\n')
+            continue;
+        size_t end = source.find_first_of(source[start] == '<' ? ">\n" : "\"\n", start + 1u);
+        if (end == std::string::npos || source[end] == '\n')
+            continue;
+        includes.push_back(directory + source.substr(start + 1u, end - start - 1u));
+        position = end;
+    }
+}
+
+static mvShaderSource&
+get_shader_source(mvShaderCache& cache, const std::string& path)
+{
+    std::error_code ec;
+    auto writeTime = std::filesystem::last_write_time(path, ec);
+    long long time = ec ? 0 : (long long)writeTime.time_since_epoch().count();
+
+    mvShaderSource& source = cache.sources[path];
+    if (source.hash != 0u && source.writeTime == time)
+        return source;
+
+    source.writeTime = time;
+    source.hash = hash_string(path, MV_HASH_SEED); // missing files still get a stable key
+    source.includes.clear();
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file)
+    {
+        std::string contents;
+        char buffer[16 * 1024];
+        size_t count = 0u;
+        while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0u)
+            contents.append(buffer, count);
+        fclose(file);
+
+        source.hash = hash_bytes(contents.data(), contents.size(), MV_HASH_SEED);
+        parse_shader_includes(path, contents, source.includes);
+    }
+    return source;
+}
+
+static uint64_t
+hash_shader_source(mvShaderCache& cache, const std::string& path, std::unordered_set<std::string>& visited, uint64_t hash)
+{
+    std::string normalized = std::filesystem::path(path).lexically_normal().string();
+    if (!visited.insert(normalized).second)
+        return hash;
+
+    // copy, the recursion may rehash the map
+    mvShaderSource source = get_shader_source(cache, normalized);
+    hash = hash_bytes(&source.hash, sizeof(uint64_t), hash);
+    for (const std::string& include : source.includes)
+        hash = hash_shader_source(cache, include, visited, hash);
+    return hash;
+}
+
+uint64_t
+get_shader_source_key(mvShaderCache& cache, const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(s_shaderCacheMutex);
+    std::unordered_set<std::string> visited;
+    return hash_shader_source(cache, path, visited, MV_HASH_SEED);
+}
+
+uint64_t
+get_shader_cache_key(mvShaderCache& cache, const std::string& path, const D3D_SHADER_MACRO* macros, const char* target, unsigned int flags)
+{
+    uint64_t key = get_shader_source_key(cache, path);
+
+    // the same permutation can be requested with its macros in any order
+    std::vector<std::pair<std::string, std::string>> sortedMacros;
+    for (const D3D_SHADER_MACRO* macro = macros; macro && macro->Name; macro++)
+        sortedMacros.push_back({ macro->Name, macro->Definition ? macro->Definition : "" });
+    std::sort(sortedMacros.begin(), sortedMacros.end());
+    for (const auto& macro : sortedMacros)
+    {
+        // include the terminators so "AB" "" and "A" "B" differ
+        key = hash_bytes(macro.first.c_str(), macro.first.size() + 1u, key);
+        key = hash_bytes(macro.second.c_str(), macro.second.size() + 1u, key);
+    }
+
+    int version = MV_SHADER_CACHE_VERSION;
+    key = hash_bytes(&version, sizeof(int), key);
+    key = hash_string(target, key);
+    key = hash_bytes(&flags, sizeof(unsigned int), key);
+    return key;
+}
+
+std::string
+get_shader_cache_path(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cso", (unsigned long long)key);
+    return std::string(MV_SHADER_CACHE_DIRECTORY) + name;
+}
+
+static bool
+load_shader_blob(const std::string& path, uint64_t key, ID3DBlob** blob)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    mvShaderCacheHeader header{};
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, "MVSC", 4) == 0
+        && header.version == MV_SHADER_CACHE_VERSION
+        && header.key == key
+        && header.size > 0u
+        && SUCCEEDED(D3DCreateBlob((size_t)header.size, blob));
+
+    if (valid)
+    {
+        valid = fread((*blob)->GetBufferPointer(), 1, (size_t)header.size, file) == header.size;
+        if (!valid)
+        {
+            (*blob)->Release();
+            *blob = nullptr;
+        }
+    }
+
+    fclose(file);
+    return valid;
+}
+
+static bool
+save_shader_blob(const std::string& path, uint64_t key, ID3DBlob* blob)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    // write to a temporary so an interrupted save never leaves a truncated cache,
+    // one per thread since two workers can finish the same blob
+    std::string tempPath = path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+
+    mvShaderCacheHeader header{};
+    memcpy(header.magic, "MVSC", 4);
+    header.version = MV_SHADER_CACHE_VERSION;
+    header.key = key;
+    header.size = blob->GetBufferSize();
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(blob->GetBufferPointer(), 1, blob->GetBufferSize(), file) == blob->GetBufferSize();
+    fclose(file);
+
+    if (success)
+    {
+        std::filesystem::rename(tempPath, path, ec);
+        success = !ec;
+    }
+    if (!success)
+        std::filesystem::remove(tempPath, ec);
+    return success;
+}
+
+HRESULT
+compile_shader(mvShaderCache& cache, const std::string& path, const D3D_SHADER_MACRO* macros, const char* target, unsigned int flags, ID3DBlob** blob, ID3DBlob** errors)
+{
+    uint64_t key = get_shader_cache_key(cache, path, macros, target, flags);
+
+    {
+        std::lock_guard<std::mutex> lock(s_shaderCacheMutex);
+        auto existing = cache.blobs.find(key);
+        if (existing != cache.blobs.end())
+        {
+            cache.memoryHits++;
+            *blob = existing->second.Get();
+            (*blob)->AddRef();
+            return S_OK;
+        }
+    }
+
+    std::string cachePath = get_shader_cache_path(key);
+    if (load_shader_blob(cachePath, key, blob))
+    {
+        std::lock_guard<std::mutex> lock(s_shaderCacheMutex);
+        cache.diskHits++;
+        cache.blobs[key] = *blob;
+        return S_OK;
+    }
+
+    HRESULT hResult = D3DCompileFromFile(to_wide(path).c_str(), macros, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        "main", target, flags, 0, blob, errors);
+
+    // failures are never cached so fixing the source retries the compile
+    if (SUCCEEDED(hResult))
+    {
+        save_shader_blob(cachePath, key, *blob);
+        std::lock_guard<std::mutex> lock(s_shaderCacheMutex);
+        cache.compiles++;
+        cache.blobs[key] = *blob;
+    }
+    return hResult;
+}
+
+void
+clear_shader_cache(mvShaderCache& cache)
+{
+    std::lock_guard<std::mutex> lock(s_shaderCacheMutex);
+    cache.blobs.clear();
+    cache.sources.clear();
+}
+
+unsigned int
+load_shader_archive(mvShaderCache& cache, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return 0u;
+
+    mvShaderArchiveHeader header{};
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, "MVSA", 4) != 0
+        || header.version != MV_SHADER_CACHE_VERSION)
+    {
+        fclose(file);
+        return 0u;
+    }
+
+    unsigned int added = 0u;
+    for (uint64_t i = 0u; i < header.count; i++)
+    {
+        mvShaderCacheHeader entry{};
+        if (fread(&entry, sizeof(entry), 1, file) != 1 || memcmp(entry.magic, "MVSC", 4) != 0 || entry.size == 0u)
+            break;
+
+        Microsoft::WRL::ComPtr<ID3DBlob> blob;
+        if (FAILED(D3DCreateBlob((size_t)entry.size, blob.GetAddressOf()))
+            || fread(blob->GetBufferPointer(), 1, (size_t)entry.size, file) != entry.size)
+            break;
+
+        std::lock_guard<std::mutex> lock(s_shaderCacheMutex);
+        if (cache.blobs.insert({ entry.key, blob }).second)
+        {
+            cache.archived++;
+            added++;
+        }
+    }
+
+    fclose(file);
+    return added;
+}
+
+bool
+save_shader_archive(mvShaderCache& cache, const std::string& path, const std::vector<uint64_t>& keys)
+{
+    std::lock_guard<std::mutex> lock(s_shaderCacheMutex);
+
+    std::vector<std::pair<uint64_t, ID3DBlob*>> entries;
+    for (uint64_t key : keys)
+    {
+        auto existing = cache.blobs.find(key);
+        if (existing != cache.blobs.end())
+            entries.push_back({ key, existing->second.Get() });
+    }
+
+    std::error_code ec;
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    if (!directory.empty())
+        std::filesystem::create_directories(directory, ec);
+
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+
+    mvShaderArchiveHeader header{};
+    memcpy(header.magic, "MVSA", 4);
+    header.version = MV_SHADER_CACHE_VERSION;
+    header.count = entries.size();
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (size_t i = 0; success && i < entries.size(); i++)
+    {
+        ID3DBlob* blob = entries[i].second;
+        mvShaderCacheHeader entry{};
+        memcpy(entry.magic, "MVSC", 4);
+        entry.version = MV_SHADER_CACHE_VERSION;
+        entry.key = entries[i].first;
+        entry.size = blob->GetBufferSize();
+        success = fwrite(&entry, sizeof(entry), 1, file) == 1
+            && fwrite(blob->GetBufferPointer(), 1, blob->GetBufferSize(), file) == blob->GetBufferSize();
+    }
+    fclose(file);
+
+    if (success)
+    {
+        std::filesystem::rename(tempPath, path, ec);
+        success = !ec;
+    }
+    if (!success)
+        std::filesystem::remove(tempPath, ec);
+    return success;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "mvWindows.h"
+#include <d3d11.h>
+#include <wrl.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+// bump when the key or the file layout changes
+#define MV_SHADER_CACHE_VERSION 1
+#define MV_SHADER_CACHE_DIRECTORY "../cache/shaders/"
+#define MV_SHADER_ARCHIVE_PATH "shaders.mvsa" // shipped next to the executable, written by shader_census
+
+// forward declarations
+struct mvShaderSource;
+struct mvShaderCache;
+
+// drop-in for D3DCompileFromFile (entry point "main"), checks memory then disk before compiling,
+// safe to call from the pipeline compiler's workers
+HRESULT      compile_shader       (mvShaderCache& cache, const std::string& path, const D3D_SHADER_MACRO* macros, const char* target, unsigned int flags, ID3DBlob** blob, ID3DBlob** errors);
+uint64_t     get_shader_cache_key (mvShaderCache& cache, const std::string& path, const D3D_SHADER_MACRO* macros, const char* target, unsigned int flags);
+uint64_t     get_shader_source_key(mvShaderCache& cache, const std::string& path); // the file and its includes
+std::string  get_shader_cache_path(uint64_t key);
+void         clear_shader_cache   (mvShaderCache& cache); // memory only, disk entries are keyed by content
+unsigned int load_shader_archive  (mvShaderCache& cache, const std::string& path); // returns the blobs added, stale entries are simply never hit
+bool         save_shader_archive  (mvShaderCache& cache, const std::string& path, const std::vector<uint64_t>& keys); // keys must be in memory
+
+struct mvShaderSource
+{
+    long long                writeTime = 0;
+    uint64_t                 hash = 0u; // file contents only
+    std::vector<std::string> includes;  // resolved relative to the including file
+};
+
+struct mvShaderCache
+{
+    std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3DBlob>> blobs;
+    std::unordered_map<std::string, mvShaderSource>                sources; // rehashed when the write time changes
+
+    // stats
+    unsigned int memoryHits = 0u;
+    unsigned int diskHits = 0u;
+    unsigned int compiles = 0u;
+    unsigned int archived = 0u; // blobs loaded from the archive
+};
@@ -0,0 +1,154 @@
+#include "mvShaderPermutations.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mvGraphics.h"
+#include "mvMaterials.h"
+#include "mvHash.h"
+
+static constexpr mvPermutationMacro s_permutationMacros[] = {
+    { "USE_IBL",                        "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "USE_PUNCTUAL",                   "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "LIGHTING_BRANCHES",              nullptr, MV_PERMUTATION_VALUE_LIGHTING_BRANCHES,       MV_SHADER_STAGE_PIXEL },
+    { "MATERIAL_CLEARCOAT",             "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "MATERIAL_METALLICROUGHNESS",     "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "ALPHAMODE",                      "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "ALPHAMODE",                      "1",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "ALPHAMODE",                      "2",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "HAS_BASE_COLOR_MAP",             "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "HAS_NORMAL_MAP",                 "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "HAS_METALLIC_ROUGHNESS_MAP",     "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "HAS_EMISSIVE_MAP",               "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "HAS_OCCLUSION_MAP",              "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "HAS_CLEARCOAT_MAP",              "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "HAS_CLEARCOAT_ROUGHNESS_MAP",    "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+    { "HAS_CLEARCOAT_NORMAL_MAP",       "0",     -1,                                           MV_SHADER_STAGE_PIXEL },
+
+    { "HAS_NORMALS",                    "0",     -1,                                           MV_SHADER_STAGE_ALL },
+    { "HAS_TANGENTS",                   "0",     -1,                                           MV_SHADER_STAGE_ALL },
+    { "HAS_TEXCOORD_0_VEC2",            "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "HAS_TEXCOORD_1_VEC2",            "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "HAS_VERTEX_COLOR_0_VEC3",        "0",     -1,                                           MV_SHADER_STAGE_ALL },
+    { "HAS_VERTEX_COLOR_0_VEC4",        "0",     -1,                                           MV_SHADER_STAGE_ALL },
+    { "HAS_VERTEX_COLOR_1_VEC3",        "0",     -1,                                           MV_SHADER_STAGE_ALL },
+    { "HAS_VERTEX_COLOR_1_VEC4",        "0",     -1,                                           MV_SHADER_STAGE_ALL },
+    { "HAS_JOINTS_0_VEC4",              "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "HAS_JOINTS_1_VEC4",              "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "HAS_WEIGHTS_0_VEC4",             "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "HAS_WEIGHTS_1_VEC4",             "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "USE_SKINNING",                   "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "USE_INSTANCING",                 "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "HAS_VERTEX_OCCLUSION",           "1",     -1,                                           MV_SHADER_STAGE_ALL },
+    { "USE_MORPHING",                   "0",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "WEIGHT_COUNT",                   nullptr, MV_PERMUTATION_VALUE_WEIGHT_COUNT,            MV_SHADER_STAGE_VERTEX },
+    { "HAS_MORPH_TARGETS",              "1",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "HAS_MORPH_TARGET_POSITION",      "1",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "MORPH_TARGET_POSITION_OFFSET",   nullptr, MV_PERMUTATION_VALUE_MORPH_POSITION_OFFSET,   MV_SHADER_STAGE_VERTEX },
+    { "HAS_MORPH_TARGET_NORMAL",        "1",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "MORPH_TARGET_NORMAL_OFFSET",     nullptr, MV_PERMUTATION_VALUE_MORPH_NORMAL_OFFSET,     MV_SHADER_STAGE_VERTEX },
+    { "HAS_MORPH_TARGET_TANGENT",       "1",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "MORPH_TARGET_TANGENT_OFFSET",    nullptr, MV_PERMUTATION_VALUE_MORPH_TANGENT_OFFSET,    MV_SHADER_STAGE_VERTEX },
+    { "HAS_MORPH_TARGET_TEXCOORD_0",    "1",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "MORPH_TARGET_TEXCOORD_0_OFFSET", nullptr, MV_PERMUTATION_VALUE_MORPH_TEXCOORD_0_OFFSET, MV_SHADER_STAGE_VERTEX },
+    { "HAS_MORPH_TARGET_TEXCOORD_1",    "1",     -1,                                           MV_SHADER_STAGE_VERTEX },
+    { "MORPH_TARGET_TEXCOORD_1_OFFSET", nullptr, MV_PERMUTATION_VALUE_MORPH_TEXCOORD_1_OFFSET, MV_SHADER_STAGE_VERTEX },
+};
+
+static_assert(sizeof(s_permutationMacros) / sizeof(s_permutationMacros[0]) == MV_PERMUTATION_COUNT, "s_permutationMacros is out of sync with mvPermutationBit");
+static_assert(MV_PERMUTATION_COUNT <= 64, "mvShaderPermutation::bits is 64 bits wide");
+
+static void
+set_permutation_bit(mvShaderPermutation& permutation, int bit, bool enabled)
+{
+    if (enabled)
+        permutation.bits |= 1ull << bit;
+}
+
+mvShaderPermutation
+get_material_permutation(const mvMaterial& material, unsigned int lighting, unsigned int lightingBranches)
+{
+    // a toggle compiled as a branch is always in the shader, whatever its current state,
+    // so every state shares one permutation
+    unsigned int branches = lightingBranches & (MV_LIGHTING_IBL | MV_LIGHTING_PUNCTUAL);
+    if (material.extensionClearcoat)
+        branches |= lightingBranches & MV_LIGHTING_CLEARCOAT;
+    lighting |= branches;
+
+    mvShaderPermutation permutation{};
+    set_permutation_bit(permutation, MV_PERMUTATION_USE_IBL, lighting & MV_LIGHTING_IBL);
+    set_permutation_bit(permutation, MV_PERMUTATION_USE_PUNCTUAL, lighting & MV_LIGHTING_PUNCTUAL);
+    set_permutation_bit(permutation, MV_PERMUTATION_LIGHTING_BRANCHES, branches != 0u);
+    permutation.values[MV_PERMUTATION_VALUE_LIGHTING_BRANCHES] = (int)branches;
+    set_permutation_bit(permutation, MV_PERMUTATION_MATERIAL_CLEARCOAT, material.extensionClearcoat && (lighting & MV_LIGHTING_CLEARCOAT));
+    set_permutation_bit(permutation, MV_PERMUTATION_MATERIAL_METALLICROUGHNESS, material.pbrMetallicRoughness);
+    set_permutation_bit(permutation, MV_PERMUTATION_ALPHAMODE_OPAQUE + material.alphaMode, material.alphaMode >= 0 && material.alphaMode <= 2);
+    set_permutation_bit(permutation, MV_PERMUTATION_HAS_BASE_COLOR_MAP, material.hasAlbedoMap);
+    set_permutation_bit(permutation, MV_PERMUTATION_HAS_NORMAL_MAP, material.hasNormalMap);
+    set_permutation_bit(permutation, MV_PERMUTATION_HAS_METALLIC_ROUGHNESS_MAP, material.hasMetallicRoughnessMap);
+    set_permutation_bit(permutation, MV_PERMUTATION_HAS_EMISSIVE_MAP, material.hasEmmissiveMap);
+    set_permutation_bit(permutation, MV_PERMUTATION_HAS_OCCLUSION_MAP, material.hasOcculusionMap);
+    set_permutation_bit(permutation, MV_PERMUTATION_HAS_CLEARCOAT_MAP, material.hasClearcoatMap);
+    set_permutation_bit(permutation, MV_PERMUTATION_HAS_CLEARCOAT_ROUGHNESS_MAP, material.hasClearcoatRoughnessMap);
+    set_permutation_bit(permutation, MV_PERMUTATION_HAS_CLEARCOAT_NORMAL_MAP, material.hasClearcoatNormalMap);
+
+    // extramacros only ever carry the geometry half of the table
+    for (const mvShaderMacro& macro : material.extramacros)
+    {
+        int bit = MV_PERMUTATION_HAS_NORMALS;
+        while (bit < MV_PERMUTATION_COUNT && strcmp(s_permutationMacros[bit].name, macro.macro.c_str()) != 0)
+            bit++;
+        assert(bit < MV_PERMUTATION_COUNT && "Unknown shader macro, add it to s_permutationMacros.");
+        if (bit == MV_PERMUTATION_COUNT)
+            continue;
+
+        set_permutation_bit(permutation, bit, true);
+        if (s_permutationMacros[bit].valueIndex != -1)
+            permutation.values[s_permutationMacros[bit].valueIndex] = atoi(macro.value.c_str());
+    }
+
+    return permutation;
+}
+
+void
+get_permutation_macros(const mvShaderPermutation& permutation, std::vector<mvShaderMacro>& macros, unsigned int stages)
+{
+    for (int bit = 0; bit < MV_PERMUTATION_COUNT; bit++)
+    {
+        const mvPermutationMacro& macro = s_permutationMacros[bit];
+        if ((permutation.bits & (1ull << bit)) == 0u || (macro.stages & stages) == 0u)
+            continue;
+
+        if (macro.valueIndex == -1)
+            macros.push_back({ macro.name, macro.value });
+        else
+            macros.push_back({ macro.name, std::to_string(permutation.values[macro.valueIndex]) });
+    }
+}
+
+uint64_t
+hash_permutation(const mvShaderPermutation& permutation)
+{
+    uint64_t hash = hash_bytes(&permutation.bits, sizeof(uint64_t));
+    return hash_bytes(permutation.values, sizeof(permutation.values), hash);
+}
+
+std::string
+describe_permutation(const mvShaderPermutation& permutation)
+{
+    std::string description;
+    for (int bit = 0; bit < MV_PERMUTATION_COUNT; bit++)
+    {
+        if ((permutation.bits & (1ull << bit)) == 0u)
+            continue;
+
+        const mvPermutationMacro& macro = s_permutationMacros[bit];
+        if (!description.empty())
+            description += " ";
+        description += macro.name;
+        if (macro.valueIndex != -1)
+            description += "=" + std::to_string(permutation.values[macro.valueIndex]);
+        else if (bit >= MV_PERMUTATION_ALPHAMODE_OPAQUE && bit <= MV_PERMUTATION_ALPHAMODE_BLEND)
+            description += std::string("=") + macro.value;
+    }
+    return description;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// forward declarations
+struct mvShaderMacro;
+struct mvMaterial;
+struct mvPermutationMacro;
+struct mvShaderPermutation;
+
+// one bit per macro PBR_VS/PBR_PS understand, same order as s_permutationMacros
+enum mvPermutationBit
+{
+    // lighting options and material
+    MV_PERMUTATION_USE_IBL,
+    MV_PERMUTATION_USE_PUNCTUAL,
+    MV_PERMUTATION_LIGHTING_BRANCHES,
+    MV_PERMUTATION_MATERIAL_CLEARCOAT,
+    MV_PERMUTATION_MATERIAL_METALLICROUGHNESS,
+    MV_PERMUTATION_ALPHAMODE_OPAQUE,
+    MV_PERMUTATION_ALPHAMODE_MASK,
+    MV_PERMUTATION_ALPHAMODE_BLEND,
+    MV_PERMUTATION_HAS_BASE_COLOR_MAP, // the maps are in PBR_PS register order, t0 to t7
+    MV_PERMUTATION_HAS_NORMAL_MAP,
+    MV_PERMUTATION_HAS_METALLIC_ROUGHNESS_MAP,
+    MV_PERMUTATION_HAS_EMISSIVE_MAP,
+    MV_PERMUTATION_HAS_OCCLUSION_MAP,
+    MV_PERMUTATION_HAS_CLEARCOAT_MAP,
+    MV_PERMUTATION_HAS_CLEARCOAT_ROUGHNESS_MAP,
+    MV_PERMUTATION_HAS_CLEARCOAT_NORMAL_MAP,
+
+    // geometry, the loader adds these as mvMaterial::extramacros
+    MV_PERMUTATION_HAS_NORMALS,
+    MV_PERMUTATION_HAS_TANGENTS,
+    MV_PERMUTATION_HAS_TEXCOORD_0_VEC2,
+    MV_PERMUTATION_HAS_TEXCOORD_1_VEC2,
+    MV_PERMUTATION_HAS_VERTEX_COLOR_0_VEC3,
+    MV_PERMUTATION_HAS_VERTEX_COLOR_0_VEC4,
+    MV_PERMUTATION_HAS_VERTEX_COLOR_1_VEC3,
+    MV_PERMUTATION_HAS_VERTEX_COLOR_1_VEC4,
+    MV_PERMUTATION_HAS_JOINTS_0_VEC4,
+    MV_PERMUTATION_HAS_JOINTS_1_VEC4,
+    MV_PERMUTATION_HAS_WEIGHTS_0_VEC4,
+    MV_PERMUTATION_HAS_WEIGHTS_1_VEC4,
+    MV_PERMUTATION_USE_SKINNING,
+    MV_PERMUTATION_USE_INSTANCING,
+    MV_PERMUTATION_HAS_VERTEX_OCCLUSION,
+    MV_PERMUTATION_USE_MORPHING,
+    MV_PERMUTATION_WEIGHT_COUNT,
+    MV_PERMUTATION_HAS_MORPH_TARGETS,
+    MV_PERMUTATION_HAS_MORPH_TARGET_POSITION,
+    MV_PERMUTATION_MORPH_TARGET_POSITION_OFFSET,
+    MV_PERMUTATION_HAS_MORPH_TARGET_NORMAL,
+    MV_PERMUTATION_MORPH_TARGET_NORMAL_OFFSET,
+    MV_PERMUTATION_HAS_MORPH_TARGET_TANGENT,
+    MV_PERMUTATION_MORPH_TARGET_TANGENT_OFFSET,
+    MV_PERMUTATION_HAS_MORPH_TARGET_TEXCOORD_0,
+    MV_PERMUTATION_MORPH_TARGET_TEXCOORD_0_OFFSET,
+    MV_PERMUTATION_HAS_MORPH_TARGET_TEXCOORD_1,
+    MV_PERMUTATION_MORPH_TARGET_TEXCOORD_1_OFFSET,
+
+    MV_PERMUTATION_COUNT
+};
+
+// the macros whose value is a number rather than just defined
+enum mvPermutationValue
+{
+    MV_PERMUTATION_VALUE_WEIGHT_COUNT,
+    MV_PERMUTATION_VALUE_MORPH_POSITION_OFFSET,
+    MV_PERMUTATION_VALUE_MORPH_NORMAL_OFFSET,
+    MV_PERMUTATION_VALUE_MORPH_TANGENT_OFFSET,
+    MV_PERMUTATION_VALUE_MORPH_TEXCOORD_0_OFFSET,
+    MV_PERMUTATION_VALUE_MORPH_TEXCOORD_1_OFFSET,
+    MV_PERMUTATION_VALUE_LIGHTING_BRANCHES,
+
+    MV_PERMUTATION_VALUE_COUNT
+};
+
+// where a macro is read, PBR_VS only sees the geometry half of the table
+enum mvShaderStage
+{
+    MV_SHADER_STAGE_VERTEX = 1 << 0,
+    MV_SHADER_STAGE_PIXEL  = 1 << 1,
+    MV_SHADER_STAGE_ALL    = MV_SHADER_STAGE_VERTEX | MV_SHADER_STAGE_PIXEL
+};
+
+mvShaderPermutation       get_material_permutation(const mvMaterial& material, unsigned int lighting, unsigned int lightingBranches); // mvLightingFlags
+void                      get_permutation_macros  (const mvShaderPermutation& permutation, std::vector<mvShaderMacro>& macros, unsigned int stages = MV_SHADER_STAGE_ALL); // appends in table order
+uint64_t                  hash_permutation        (const mvShaderPermutation& permutation);
+std::string               describe_permutation    (const mvShaderPermutation& permutation); // "USE_IBL ALPHAMODE=0 ...", for tools
+
+struct mvPermutationMacro
+{
+    const char*  name;
+    const char*  value;      // unused when valueIndex is set
+    int          valueIndex; // mvPermutationValue or -1
+    unsigned int stages;     // mvShaderStage
+};
+
+struct mvShaderPermutation
+{
+    uint64_t bits = 0u; // 1 << mvPermutationBit
+    int      values[MV_PERMUTATION_VALUE_COUNT] = {};
+};
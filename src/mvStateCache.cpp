@@ -0,0 +1,304 @@
+#include "mvStateCache.h"
+#include <assert.h>
+#include <mutex>
+#include <string.h>
+#include <d3dcompiler.h>
+#include "mvGraphics.h"
+#include "mvHash.h"
+
+// pipelines are finalized on the compiler's workers too
+static std::mutex s_stateCacheMutex;
+
+// the descriptors have padding after their UINT8 members, so hash field by field
+static uint64_t
+hash_desc(const D3D11_BLEND_DESC& desc)
+{
+    uint64_t hash = hash_bytes(&desc.AlphaToCoverageEnable, sizeof(BOOL));
+    hash = hash_bytes(&desc.IndependentBlendEnable, sizeof(BOOL), hash);
+    int targetCount = desc.IndependentBlendEnable ? 8 : 1;
+    for (int i = 0; i < targetCount; i++)
+    {
+        const D3D11_RENDER_TARGET_BLEND_DESC& target = desc.RenderTarget[i];
+        hash = hash_bytes(&target.BlendEnable, sizeof(BOOL), hash);
+        hash = hash_bytes(&target.SrcBlend, sizeof(D3D11_BLEND), hash);
+        hash = hash_bytes(&target.DestBlend, sizeof(D3D11_BLEND), hash);
+        hash = hash_bytes(&target.BlendOp, sizeof(D3D11_BLEND_OP), hash);
+        hash = hash_bytes(&target.SrcBlendAlpha, sizeof(D3D11_BLEND), hash);
+        hash = hash_bytes(&target.DestBlendAlpha, sizeof(D3D11_BLEND), hash);
+        hash = hash_bytes(&target.BlendOpAlpha, sizeof(D3D11_BLEND_OP), hash);
+        hash = hash_bytes(&target.RenderTargetWriteMask, sizeof(UINT8), hash);
+    }
+    return hash;
+}
+
+static uint64_t
+hash_desc(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+    uint64_t hash = hash_bytes(&desc.DepthEnable, sizeof(BOOL));
+    hash = hash_bytes(&desc.DepthWriteMask, sizeof(D3D11_DEPTH_WRITE_MASK), hash);
+    hash = hash_bytes(&desc.DepthFunc, sizeof(D3D11_COMPARISON_FUNC), hash);
+    hash = hash_bytes(&desc.StencilEnable, sizeof(BOOL), hash);
+    hash = hash_bytes(&desc.StencilReadMask, sizeof(UINT8), hash);
+    hash = hash_bytes(&desc.StencilWriteMask, sizeof(UINT8), hash);
+    hash = hash_bytes(&desc.FrontFace, sizeof(D3D11_DEPTH_STENCILOP_DESC), hash);
+    hash = hash_bytes(&desc.BackFace, sizeof(D3D11_DEPTH_STENCILOP_DESC), hash);
+    return hash;
+}
+
+static uint64_t
+hash_desc(const D3D11_RASTERIZER_DESC& desc)
+{
+    return hash_bytes(&desc, sizeof(D3D11_RASTERIZER_DESC));
+}
+
+static uint64_t
+hash_desc(const D3D11_SAMPLER_DESC& desc)
+{
+    return hash_bytes(&desc, sizeof(D3D11_SAMPLER_DESC));
+}
+
+static uint64_t
+hash_desc(const std::vector<unsigned char>& bytes)
+{
+    return hash_bytes(bytes.data(), bytes.size());
+}
+
+// same fields as the hashes above
+static bool
+same_desc(const D3D11_BLEND_DESC& left, const D3D11_BLEND_DESC& right)
+{
+    if (left.AlphaToCoverageEnable != right.AlphaToCoverageEnable || left.IndependentBlendEnable != right.IndependentBlendEnable)
+        return false;
+    int targetCount = left.IndependentBlendEnable ? 8 : 1;
+    for (int i = 0; i < targetCount; i++)
+    {
+        const D3D11_RENDER_TARGET_BLEND_DESC& l = left.RenderTarget[i];
+        const D3D11_RENDER_TARGET_BLEND_DESC& r = right.RenderTarget[i];
+        if (l.BlendEnable != r.BlendEnable || l.SrcBlend != r.SrcBlend || l.DestBlend != r.DestBlend || l.BlendOp != r.BlendOp
+            || l.SrcBlendAlpha != r.SrcBlendAlpha || l.DestBlendAlpha != r.DestBlendAlpha || l.BlendOpAlpha != r.BlendOpAlpha
+            || l.RenderTargetWriteMask != r.RenderTargetWriteMask)
+            return false;
+    }
+    return true;
+}
+
+static bool
+same_desc(const D3D11_DEPTH_STENCIL_DESC& left, const D3D11_DEPTH_STENCIL_DESC& right)
+{
+    return left.DepthEnable == right.DepthEnable
+        && left.DepthWriteMask == right.DepthWriteMask
+        && left.DepthFunc == right.DepthFunc
+        && left.StencilEnable == right.StencilEnable
+        && left.StencilReadMask == right.StencilReadMask
+        && left.StencilWriteMask == right.StencilWriteMask
+        && memcmp(&left.FrontFace, &right.FrontFace, sizeof(D3D11_DEPTH_STENCILOP_DESC)) == 0
+        && memcmp(&left.BackFace, &right.BackFace, sizeof(D3D11_DEPTH_STENCILOP_DESC)) == 0;
+}
+
+static bool
+same_desc(const D3D11_RASTERIZER_DESC& left, const D3D11_RASTERIZER_DESC& right)
+{
+    return memcmp(&left, &right, sizeof(D3D11_RASTERIZER_DESC)) == 0;
+}
+
+static bool
+same_desc(const D3D11_SAMPLER_DESC& left, const D3D11_SAMPLER_DESC& right)
+{
+    return memcmp(&left, &right, sizeof(D3D11_SAMPLER_DESC)) == 0;
+}
+
+static bool
+same_desc(const std::vector<unsigned char>& left, const std::vector<unsigned char>& right)
+{
+    return left == right;
+}
+
+template<typename T, typename D, typename F>
+static Microsoft::WRL::ComPtr<T>
+get_state(mvGraphics& graphics, mvStateMap<T, D>& states, const D& desc, F create)
+{
+    // see setup_headless_graphics
+    if (graphics.device.Get() == nullptr)
+        return nullptr;
+
+    mvStateCache& cache = graphics.stateCache;
+    uint64_t key = hash_desc(desc);
+
+    std::lock_guard<std::mutex> lock(s_stateCacheMutex);
+    auto range = states.equal_range(key);
+    for (auto existing = range.first; existing != range.second; existing++)
+    {
+        if (same_desc(existing->second.desc, desc))
+        {
+            cache.hits++;
+            return existing->second.state;
+        }
+        cache.collisions++;
+    }
+
+    Microsoft::WRL::ComPtr<T> state;
+    HRESULT hResult = create(state.GetAddressOf());
+    assert(SUCCEEDED(hResult));
+    cache.misses++;
+    states.insert({ key, mvCachedState<T, D>{ desc, state } });
+    return state;
+}
+
+Microsoft::WRL::ComPtr<ID3D11BlendState>
+get_blend_state(mvGraphics& graphics, const D3D11_BLEND_DESC& desc)
+{
+    ID3D11Device* device = graphics.device.Get();
+    return get_state(graphics, graphics.stateCache.blendStates, desc,
+        [device, &desc](ID3D11BlendState** state) { return device->CreateBlendState(&desc, state); });
+}
+
+Microsoft::WRL::ComPtr<ID3D11DepthStencilState>
+get_depth_stencil_state(mvGraphics& graphics, const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+    ID3D11Device* device = graphics.device.Get();
+    return get_state(graphics, graphics.stateCache.depthStencilStates, desc,
+        [device, &desc](ID3D11DepthStencilState** state) { return device->CreateDepthStencilState(&desc, state); });
+}
+
+Microsoft::WRL::ComPtr<ID3D11RasterizerState>
+get_rasterizer_state(mvGraphics& graphics, const D3D11_RASTERIZER_DESC& desc)
+{
+    ID3D11Device* device = graphics.device.Get();
+    return get_state(graphics, graphics.stateCache.rasterizerStates, desc,
+        [device, &desc](ID3D11RasterizerState** state) { return device->CreateRasterizerState(&desc, state); });
+}
+
+Microsoft::WRL::ComPtr<ID3D11SamplerState>
+get_sampler_state(mvGraphics& graphics, const D3D11_SAMPLER_DESC& desc)
+{
+    ID3D11Device* device = graphics.device.Get();
+    return get_state(graphics, graphics.stateCache.samplerStates, desc,
+        [device, &desc](ID3D11SamplerState** state) { return device->CreateSamplerState(&desc, state); });
+}
+
+static void
+append_bytes(std::vector<unsigned char>& bytes, const void* data, size_t size)
+{
+    const unsigned char* first = (const unsigned char*)data;
+    bytes.insert(bytes.end(), first, first + size);
+}
+
+Microsoft::WRL::ComPtr<ID3D11InputLayout>
+get_input_layout(mvGraphics& graphics, const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, ID3DBlob* vertexBlob)
+{
+    // any vertex shader with the same input signature can share the layout
+    Microsoft::WRL::ComPtr<ID3DBlob> signature;
+    HRESULT hResult = D3DGetInputSignatureBlob(vertexBlob->GetBufferPointer(), vertexBlob->GetBufferSize(), signature.GetAddressOf());
+    assert(SUCCEEDED(hResult));
+
+    std::vector<unsigned char> desc;
+    append_bytes(desc, signature->GetBufferPointer(), signature->GetBufferSize());
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const D3D11_INPUT_ELEMENT_DESC& element = elements[i];
+        append_bytes(desc, element.SemanticName, strlen(element.SemanticName) + 1u);
+        append_bytes(desc, &element.SemanticIndex, sizeof(UINT));
+        append_bytes(desc, &element.Format, sizeof(DXGI_FORMAT));
+        append_bytes(desc, &element.InputSlot, sizeof(UINT));
+        append_bytes(desc, &element.AlignedByteOffset, sizeof(UINT));
+        append_bytes(desc, &element.InputSlotClass, sizeof(D3D11_INPUT_CLASSIFICATION));
+        append_bytes(desc, &element.InstanceDataStepRate, sizeof(UINT));
+    }
+
+    ID3D11Device* device = graphics.device.Get();
+    return get_state(graphics, graphics.stateCache.inputLayouts, desc,
+        [device, elements, count, &signature](ID3D11InputLayout** inputLayout) {
+            return device->CreateInputLayout(elements, count, signature->GetBufferPointer(), signature->GetBufferSize(), inputLayout); });
+}
+
+// equal bytecode means an equal shader, whatever macros or path produced it
+static std::vector<unsigned char>
+get_bytecode(ID3DBlob* blob)
+{
+    const unsigned char* first = (const unsigned char*)blob->GetBufferPointer();
+    return std::vector<unsigned char>(first, first + blob->GetBufferSize());
+}
+
+Microsoft::WRL::ComPtr<ID3D11VertexShader>
+get_vertex_shader(mvGraphics& graphics, ID3DBlob* blob)
+{
+    ID3D11Device* device = graphics.device.Get();
+    return get_state(graphics, graphics.stateCache.vertexShaders, get_bytecode(blob),
+        [device, blob](ID3D11VertexShader** shader) { return device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, shader); });
+}
+
+Microsoft::WRL::ComPtr<ID3D11PixelShader>
+get_pixel_shader(mvGraphics& graphics, ID3DBlob* blob)
+{
+    ID3D11Device* device = graphics.device.Get();
+    return get_state(graphics, graphics.stateCache.pixelShaders, get_bytecode(blob),
+        [device, blob](ID3D11PixelShader** shader) { return device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, shader); });
+}
+
+template<typename T, typename D>
+static unsigned int
+trim_states(mvStateMap<T, D>& states)
+{
+    unsigned int released = 0u;
+    for (auto it = states.begin(); it != states.end();)
+    {
+        // AddRef/Release returns the count, 1 is our own reference
+        it->second.state->AddRef();
+        if (it->second.state->Release() == 1u)
+        {
+            it = states.erase(it);
+            released++;
+        }
+        else
+            it++;
+    }
+    return released;
+}
+
+unsigned int
+trim_state_cache(mvStateCache& cache)
+{
+    std::lock_guard<std::mutex> lock(s_stateCacheMutex);
+    return trim_states(cache.blendStates)
+        + trim_states(cache.depthStencilStates)
+        + trim_states(cache.rasterizerStates)
+        + trim_states(cache.samplerStates)
+        + trim_states(cache.inputLayouts)
+        + trim_states(cache.vertexShaders)
+        + trim_states(cache.pixelShaders);
+}
+
+void
+begin_state_tracking(mvStateCache& cache)
+{
+    cache.tracking = true;
+    cache.valid = false;
+    cache.vertexSlots.bound = 0u;
+    cache.pixelSlots.bound = 0u;
+}
+
+void
+end_state_tracking(mvStateCache& cache)
+{
+    cache.tracking = false;
+    cache.valid = false;
+    cache.vertexSlots.bound = 0u;
+    cache.pixelSlots.bound = 0u;
+}
+
+bool
+update_texture_slot(mvStateCache& cache, mvTextureSlots& slots, unsigned int slot, ID3D11ShaderResourceView* view, ID3D11SamplerState* sampler)
+{
+    unsigned int bit = 1u << slot;
+    if ((slots.bound & bit) != 0u && slots.views[slot] == view && slots.samplers[slot] == sampler)
+    {
+        cache.bindsSkipped++;
+        return false;
+    }
+
+    slots.views[slot] = view;
+    slots.samplers[slot] = sampler;
+    if (cache.tracking)
+        slots.bound |= bit;
+    return true;
+}
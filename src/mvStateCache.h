@@ -0,0 +1,77 @@
+#pragma once
+
+#include "mvWindows.h"
+#include <d3d11.h>
+#include <wrl.h>
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+// forward declarations
+struct mvGraphics;
+struct mvTextureSlots;
+struct mvStateCache;
+template<typename T, typename D> struct mvCachedState;
+
+// identical descriptors return the same object, the cache keeps one reference to each
+Microsoft::WRL::ComPtr<ID3D11BlendState>        get_blend_state        (mvGraphics& graphics, const D3D11_BLEND_DESC& desc);
+Microsoft::WRL::ComPtr<ID3D11DepthStencilState> get_depth_stencil_state(mvGraphics& graphics, const D3D11_DEPTH_STENCIL_DESC& desc);
+Microsoft::WRL::ComPtr<ID3D11RasterizerState>   get_rasterizer_state   (mvGraphics& graphics, const D3D11_RASTERIZER_DESC& desc);
+Microsoft::WRL::ComPtr<ID3D11SamplerState>      get_sampler_state      (mvGraphics& graphics, const D3D11_SAMPLER_DESC& desc);
+Microsoft::WRL::ComPtr<ID3D11InputLayout>       get_input_layout       (mvGraphics& graphics, const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, ID3DBlob* vertexBlob);
+Microsoft::WRL::ComPtr<ID3D11VertexShader>      get_vertex_shader      (mvGraphics& graphics, ID3DBlob* blob); // keyed by bytecode
+Microsoft::WRL::ComPtr<ID3D11PixelShader>       get_pixel_shader       (mvGraphics& graphics, ID3DBlob* blob);
+unsigned int                                    trim_state_cache       (mvStateCache& cache); // drops objects only the cache references
+void                                            begin_state_tracking   (mvStateCache& cache);
+void                                            end_state_tracking     (mvStateCache& cache);
+bool                                            update_texture_slot    (mvStateCache& cache, mvTextureSlots& slots, unsigned int slot, ID3D11ShaderResourceView* view, ID3D11SamplerState* sampler); // false if already bound
+
+// the descriptor (or bytecode) is kept to tell hash collisions apart
+template<typename T, typename D>
+struct mvCachedState
+{
+    D                         desc;
+    Microsoft::WRL::ComPtr<T> state;
+};
+
+template<typename T, typename D>
+using mvStateMap = std::unordered_multimap<uint64_t, mvCachedState<T, D>>;
+
+// what render_job last bound to the material and animation registers of one stage
+struct mvTextureSlots
+{
+    ID3D11ShaderResourceView* views[8] = {};
+    ID3D11SamplerState*       samplers[8] = {};
+    unsigned int              bound = 0u; // slot bits set since begin_state_tracking
+};
+
+struct mvStateCache
+{
+    mvStateMap<ID3D11BlendState, D3D11_BLEND_DESC>                 blendStates;
+    mvStateMap<ID3D11DepthStencilState, D3D11_DEPTH_STENCIL_DESC>  depthStencilStates;
+    mvStateMap<ID3D11RasterizerState, D3D11_RASTERIZER_DESC>       rasterizerStates;
+    mvStateMap<ID3D11SamplerState, D3D11_SAMPLER_DESC>             samplerStates;
+    mvStateMap<ID3D11InputLayout, std::vector<unsigned char>>      inputLayouts; // input signature and elements
+    mvStateMap<ID3D11VertexShader, std::vector<unsigned char>>     vertexShaders; // bytecode
+    mvStateMap<ID3D11PixelShader, std::vector<unsigned char>>      pixelShaders;
+
+    // what set_pipeline_state last bound, only trusted between begin/end_state_tracking
+    // since other code changes state behind our back
+    bool                      tracking = false;
+    bool                      valid = false;
+    D3D11_PRIMITIVE_TOPOLOGY  topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    ID3D11RasterizerState*    rasterizerState = nullptr;
+    ID3D11BlendState*         blendState = nullptr;
+    ID3D11DepthStencilState*  depthStencilState = nullptr;
+    ID3D11InputLayout*        inputLayout = nullptr;
+    ID3D11VertexShader*       vertexShader = nullptr;
+    ID3D11PixelShader*        pixelShader = nullptr;
+    mvTextureSlots            vertexSlots;
+    mvTextureSlots            pixelSlots;
+
+    // stats
+    unsigned int hits = 0u;
+    unsigned int misses = 0u;
+    unsigned int collisions = 0u; // hash matches with a different descriptor
+    unsigned int bindsSkipped = 0u; // reset by the caller
+};
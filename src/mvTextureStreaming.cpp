@@ -0,0 +1,345 @@
+#include "mvTextureStreaming.h"
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include "mvGraphics.h"
+
+static unsigned int
+get_mip_size(mvStreamedTexture& texture, int mip)
+{
+    int width = std::max(texture.width >> mip, 1);
+    int height = std::max(texture.height >> mip, 1);
+    return width * height * 4u;
+}
+
+static unsigned int
+get_resident_size(mvStreamedTexture& texture, int mip)
+{
+    unsigned int size = 0u;
+    for (int i = mip; i < texture.mipCount; i++)
+        size += get_mip_size(texture, i);
+    return size;
+}
+
+static void
+generate_mip_chain(mvStreamedTexture& texture, unsigned char* pixels)
+{
+    texture.mips.resize(texture.mipCount);
+    texture.mips[0].assign(pixels, pixels + texture.width * texture.height * 4);
+
+    // 2x2 box filter, clamped at the edges for odd dimensions
+    for (int mip = 1; mip < texture.mipCount; mip++)
+    {
+        int srcWidth = std::max(texture.width >> (mip - 1), 1);
+        int srcHeight = std::max(texture.height >> (mip - 1), 1);
+        int dstWidth = std::max(texture.width >> mip, 1);
+        int dstHeight = std::max(texture.height >> mip, 1);
+
+        std::vector<unsigned char>& src = texture.mips[mip - 1];
+        std::vector<unsigned char>& dst = texture.mips[mip];
+        dst.resize(dstWidth * dstHeight * 4);
+
+        for (int y = 0; y < dstHeight; y++)
+        {
+            int y0 = std::min(y * 2, srcHeight - 1);
+            int y1 = std::min(y * 2 + 1, srcHeight - 1);
+            for (int x = 0; x < dstWidth; x++)
+            {
+                int x0 = std::min(x * 2, srcWidth - 1);
+                int x1 = std::min(x * 2 + 1, srcWidth - 1);
+                for (int c = 0; c < 4; c++)
+                {
+                    unsigned int sum = src[(y0 * srcWidth + x0) * 4 + c] + src[(y0 * srcWidth + x1) * 4 + c]
+                        + src[(y1 * srcWidth + x0) * 4 + c] + src[(y1 * srcWidth + x1) * 4 + c];
+                    dst[(y * dstWidth + x) * 4 + c] = (unsigned char)((sum + 2u) / 4u);
+                }
+            }
+        }
+    }
+}
+
+static void
+make_resident(mvGraphics& graphics, mvStreamedTexture& texture, int mip)
+{
+    mvTextureStreamer& streamer = graphics.textureStreamer;
+
+    // create a texture holding only [mip, mipCount)
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width = std::max(texture.width >> mip, 1);
+    textureDesc.Height = std::max(texture.height >> mip, 1);
+    textureDesc.MipLevels = texture.mipCount - mip;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+    textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    textureDesc.CPUAccessFlags = 0;
+    textureDesc.MiscFlags = 0;
+
+    std::vector<D3D11_SUBRESOURCE_DATA> sdata(textureDesc.MipLevels);
+    for (unsigned int i = 0; i < textureDesc.MipLevels; i++)
+    {
+        sdata[i].pSysMem = texture.mips[mip + i].data();
+        sdata[i].SysMemPitch = std::max(texture.width >> (mip + i), 1) * 4;
+        sdata[i].SysMemSlicePitch = 0u;
+    }
+
+    // without a device only the bookkeeping runs
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> textureResource;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureView;
+    if (graphics.device)
+    {
+        HRESULT hResult = graphics.device->CreateTexture2D(&textureDesc, sdata.data(), textureResource.GetAddressOf());
+        assert(SUCCEEDED(hResult));
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = textureDesc.Format;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MostDetailedMip = 0;
+        srvDesc.Texture2D.MipLevels = -1;
+
+        hResult = graphics.device->CreateShaderResourceView(textureResource.Get(), &srvDesc, textureView.GetAddressOf());
+        assert(SUCCEEDED(hResult));
+    }
+
+    unsigned int size = get_resident_size(texture, mip);
+    if (mip < texture.residentMip)
+        streamer.uploadedBytes += size;
+
+    streamer.residentBytes -= texture.residentBytes;
+    streamer.residentBytes += size;
+    texture.residentBytes = size;
+    texture.residentMip = mip;
+    texture.texture = textureResource;
+    texture.textureView = textureView;
+}
+
+static bool
+evict_texture_mip(mvGraphics& graphics, mvAssetID exclude, float priority)
+{
+    mvTextureStreamer& streamer = graphics.textureStreamer;
+
+    // prefer textures that are already over-resident, then the least important
+    mvAssetID victim = -1;
+    for (int i = 0; i < streamer.textures.size(); i++)
+    {
+        mvStreamedTexture& texture = streamer.textures[i];
+        if (i == exclude || texture.refCount == 0 || texture.residentMip >= texture.baseMip)
+            continue;
+
+        if (victim == -1)
+        {
+            victim = i;
+            continue;
+        }
+
+        mvStreamedTexture& current = streamer.textures[victim];
+        bool overResident = texture.requestedMip > texture.residentMip;
+        bool currentOverResident = current.requestedMip > current.residentMip;
+        if (overResident != currentOverResident)
+        {
+            if (overResident)
+                victim = i;
+        }
+        else if (texture.lastUsedFrame != current.lastUsedFrame)
+        {
+            if (texture.lastUsedFrame < current.lastUsedFrame)
+                victim = i;
+        }
+        else if (texture.priority < current.priority)
+            victim = i;
+    }
+
+    if (victim == -1)
+        return false;
+
+    mvStreamedTexture& texture = streamer.textures[victim];
+    bool overResident = texture.requestedMip > texture.residentMip;
+    if (!overResident && texture.lastUsedFrame == streamer.frame && texture.priority >= priority)
+        return false;
+
+    make_resident(graphics, texture, texture.residentMip + 1);
+    streamer.evictions++;
+    return true;
+}
+
+mvAssetID
+register_streamed_texture(mvGraphics& graphics, const std::string& key, unsigned char* pixels, int width, int height)
+{
+    mvTextureStreamer& streamer = graphics.textureStreamer;
+
+    mvAssetID id = find_streamed_texture(streamer, key);
+    if (id != -1)
+    {
+        retain_streamed_texture(streamer, id);
+        return id;
+    }
+
+    // reuse a released slot so ids held elsewhere stay valid
+    for (int i = 0; i < streamer.textures.size(); i++)
+    {
+        if (streamer.textures[i].refCount == 0)
+        {
+            id = i;
+            break;
+        }
+    }
+    if (id == -1)
+    {
+        streamer.textures.push_back({});
+        id = (mvAssetID)streamer.textures.size() - 1;
+    }
+
+    mvStreamedTexture& texture = streamer.textures[id];
+    texture = {};
+    texture.key = key;
+    texture.width = width;
+    texture.height = height;
+    texture.mipCount = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+    texture.refCount = 1;
+    texture.lastUsedFrame = streamer.frame;
+    generate_mip_chain(texture, pixels);
+
+    // only the coarse tail is uploaded up front
+    texture.baseMip = 0;
+    while (texture.baseMip < texture.mipCount - 1 && std::max(width >> texture.baseMip, height >> texture.baseMip) > streamer.baseResolution)
+        texture.baseMip++;
+    texture.residentMip = texture.mipCount;
+    texture.requestedMip = texture.baseMip;
+    make_resident(graphics, texture, texture.baseMip);
+
+    streamer.lookup[key] = id;
+    return id;
+}
+
+mvAssetID
+find_streamed_texture(mvTextureStreamer& streamer, const std::string& key)
+{
+    auto it = streamer.lookup.find(key);
+    if (it == streamer.lookup.end())
+        return -1;
+    return it->second;
+}
+
+void
+retain_streamed_texture(mvTextureStreamer& streamer, mvAssetID id)
+{
+    assert(id > -1 && id < streamer.textures.size());
+    streamer.textures[id].refCount++;
+}
+
+void
+release_streamed_texture(mvTextureStreamer& streamer, mvAssetID id)
+{
+    if (id == -1)
+        return;
+
+    mvStreamedTexture& texture = streamer.textures[id];
+    assert(texture.refCount > 0);
+    texture.refCount--;
+    if (texture.refCount > 0)
+        return;
+
+    streamer.residentBytes -= texture.residentBytes;
+    streamer.lookup.erase(texture.key);
+    texture = {};
+}
+
+void
+request_streamed_mip(mvTextureStreamer& streamer, mvAssetID id, float screenSize)
+{
+    mvStreamedTexture& texture = streamer.textures[id];
+
+    int mip = texture.baseMip;
+    if (screenSize > 0.0f)
+    {
+        float texels = (float)std::max(texture.width, texture.height);
+        mip = (int)std::floor(std::log2(std::max(texels / screenSize, 1.0f)));
+        mip = std::min(mip, texture.baseMip);
+    }
+
+    if (mip < texture.requestedMip)
+        texture.requestedMip = mip;
+    if (screenSize > texture.priority)
+        texture.priority = screenSize;
+    texture.lastUsedFrame = streamer.frame;
+}
+
+void
+update_texture_streaming(mvGraphics& graphics)
+{
+    mvTextureStreamer& streamer = graphics.textureStreamer;
+    streamer.uploadedBytes = 0u;
+
+    // textures wanting finer mips, largest on screen first
+    std::vector<mvAssetID> pending;
+    for (int i = 0; i < streamer.textures.size(); i++)
+    {
+        mvStreamedTexture& texture = streamer.textures[i];
+        if (texture.refCount > 0 && texture.requestedMip < texture.residentMip)
+            pending.push_back(i);
+    }
+
+    std::sort(pending.begin(), pending.end(), [&](mvAssetID left, mvAssetID right) {
+        return streamer.textures[left].priority > streamer.textures[right].priority;
+    });
+
+    for (int i = 0; i < pending.size(); i++)
+    {
+        mvStreamedTexture& texture = streamer.textures[pending[i]];
+
+        // finest mip that still fits in this frame's upload limit,
+        // always allowing one step so huge mips can't starve
+        int mip = texture.residentMip - 1;
+        while (mip > texture.requestedMip && streamer.uploadedBytes + get_resident_size(texture, mip - 1) <= streamer.uploadLimit)
+            mip--;
+        if (streamer.uploadedBytes > 0u && streamer.uploadedBytes + get_resident_size(texture, mip) > streamer.uploadLimit)
+            break;
+
+        // make room under the budget
+        unsigned int size = get_resident_size(texture, mip);
+        bool fits = true;
+        while (streamer.residentBytes - texture.residentBytes + size > streamer.budget)
+        {
+            if (!evict_texture_mip(graphics, pending[i], texture.priority))
+            {
+                fits = false;
+                break;
+            }
+        }
+
+        if (fits)
+            make_resident(graphics, texture, mip);
+    }
+
+    // still over budget (budget lowered or nothing to upload), trim unused detail
+    while (streamer.residentBytes > streamer.budget)
+    {
+        if (!evict_texture_mip(graphics, -1, 0.0f))
+            break;
+    }
+
+    // requests are rebuilt every frame
+    for (int i = 0; i < streamer.textures.size(); i++)
+    {
+        streamer.textures[i].requestedMip = streamer.textures[i].baseMip;
+        streamer.textures[i].priority = 0.0f;
+    }
+
+    streamer.frame++;
+}
+
+unsigned int
+get_streamed_texture_size(mvTextureStreamer& streamer, mvAssetID id)
+{
+    if (id == -1)
+        return 0u;
+    return get_resident_size(streamer.textures[id], 0);
+}
+
+ID3D11ShaderResourceView* const*
+get_streamed_view(mvTextureStreamer& streamer, mvAssetID id)
+{
+    return streamer.textures[id].textureView.GetAddressOf();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "mvWindows.h"
+#include <d3d11.h>
+#include <wrl.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+typedef int mvAssetID;
+
+// forward declarations
+struct mvGraphics;
+struct mvStreamedTexture;
+struct mvTextureStreamer;
+
+mvAssetID                         register_streamed_texture(mvGraphics& graphics, const std::string& key, unsigned char* pixels, int width, int height);
+mvAssetID                         find_streamed_texture    (mvTextureStreamer& streamer, const std::string& key);
+void                              retain_streamed_texture  (mvTextureStreamer& streamer, mvAssetID id);
+void                              release_streamed_texture (mvTextureStreamer& streamer, mvAssetID id);
+void                              request_streamed_mip     (mvTextureStreamer& streamer, mvAssetID id, float screenSize);
+void                              update_texture_streaming (mvGraphics& graphics);
+unsigned int                      get_streamed_texture_size(mvTextureStreamer& streamer, mvAssetID id);
+ID3D11ShaderResourceView* const*  get_streamed_view        (mvTextureStreamer& streamer, mvAssetID id);
+
+struct mvStreamedTexture
+{
+    std::string                                      key;
+    int                                              width = 0;
+    int                                              height = 0;
+    int                                              mipCount = 0;
+    int                                              baseMip = 0;      // coarsest mip kept resident at all times
+    int                                              residentMip = 0;  // finest mip currently on the GPU
+    int                                              requestedMip = 0; // finest mip requested this frame
+    float                                            priority = 0.0f;  // largest projected size this frame (pixels)
+    unsigned long long                               lastUsedFrame = 0u;
+    unsigned int                                     residentBytes = 0u;
+    int                                              refCount = 0;
+    std::vector<std::vector<unsigned char>>          mips;             // CPU copy of the full RGBA8 chain
+    Microsoft::WRL::ComPtr<ID3D11Texture2D>          texture;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureView;
+};
+
+struct mvTextureStreamer
+{
+    std::vector<mvStreamedTexture>             textures;
+    std::unordered_map<std::string, mvAssetID> lookup;
+    unsigned long long                         frame = 0u;
+
+    // settings
+    unsigned int budget = 256u * 1024u * 1024u;  // resident bytes across all textures
+    unsigned int uploadLimit = 8u * 1024u * 1024u; // bytes uploaded per frame
+    int          baseResolution = 64;              // largest dimension uploaded at load time
+
+    // stats
+    unsigned int residentBytes = 0u;
+    unsigned int uploadedBytes = 0u; // last frame
+    unsigned int evictions = 0u;
+};
@@ -0,0 +1,15 @@
+
+// drawn while a material's pipeline is still compiling
+struct mvMaterial
+{
+    float4 albedo;
+    float4 _data[7];
+};
+
+cbuffer mvTransformCBuf : register(b4) { matrix transforms[3]; int materialIndex; };
+StructuredBuffer<mvMaterial> Materials : register(t15);
+
+float4 main(float4 pixelPos : SV_Position) : SV_Target
+{
+    return float4(Materials[materialIndex].albedo.rgb, 1.0f);
+}
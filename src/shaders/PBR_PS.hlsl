@@ -54,6 +54,7 @@ struct mvMaterial
 
     float attenuationDistance;
     float ior;
+    float2 _padding;
     //-------------------------- ( 16 bytes )
 
 };
@@ -78,6 +79,7 @@ struct mvGlobalInfo
     //-------------------------- ( 16 bytes )
     
     float3 camPos;
+    int lightingFlags; // LIGHTING_*, only read for the toggles in LIGHTING_BRANCHES
     //-------------------------- ( 16 bytes )
     
     float4x4 projection;
@@ -165,9 +167,31 @@ SamplerState u_GGXLUTSampler : register(s14);
 // constant buffers
 //-----------------------------------------------------------------------------
 cbuffer mvPointLightCBuf       : register(b0) { mvPointLight PointLight; };
-cbuffer mvMaterialCBuf         : register(b1) { mvMaterial material; };
 cbuffer mvDirectionalLightCBuf : register(b2) { mvDirectionalLight DirectionalLight; };
 cbuffer mvGlobalCBuf           : register(b3) { mvGlobalInfo ginfo; };
+cbuffer mvTransformCBuf        : register(b4) { matrix transforms[3]; int materialIndex; };
+
+//-----------------------------------------------------------------------------
+// lighting toggles
+//   LIGHTING_BRANCHES holds the toggles compiled as branches on
+//   ginfo.lightingFlags, the rest are decided by USE_IBL, USE_PUNCTUAL and
+//   MATERIAL_CLEARCOAT alone
+//-----------------------------------------------------------------------------
+#define LIGHTING_IBL       1
+#define LIGHTING_PUNCTUAL  2
+#define LIGHTING_CLEARCOAT 4
+
+#ifndef LIGHTING_BRANCHES
+#define LIGHTING_BRANCHES 0
+#endif
+
+#define LIGHTING_ENABLED(flag) ((LIGHTING_BRANCHES & (flag)) == 0 || (ginfo.lightingFlags & (flag)) != 0)
+
+//-----------------------------------------------------------------------------
+// materials
+//-----------------------------------------------------------------------------
+StructuredBuffer<mvMaterial> Materials : register(t15);
+static mvMaterial material; // Materials[materialIndex], loaded at the top of main
 
 struct VSOut
 {
@@ -202,6 +226,11 @@ struct VSOut
     float3 WorldNormal : NORMAL1;
     float2 UV0 : TEXCOORD0;
     float2 UV1 : TEXCOORD1;
+
+#ifdef HAS_VERTEX_OCCLUSION
+    float v_occlusion : OCCLUSION0;
+#endif
+
     bool frontFace : SV_IsFrontFace;
 
 };
@@ -215,6 +244,8 @@ struct VSOut
 
 float4 main(VSOut input) : SV_Target
 {
+    material = Materials[materialIndex];
+
     float4 finalColor;
     float4 baseColor = getBaseColor(input);
 
@@ -328,16 +359,19 @@ float4 main(VSOut input) : SV_Target
 
     // Calculate lighting contribution from image based lighting source (IBL)
 #ifdef USE_IBL
-    f_specular += getIBLRadianceGGX(n, v, materialInfo.perceptualRoughness, materialInfo.f0, materialInfo.specularWeight);
-    f_diffuse += getIBLRadianceLambertian(n, v, materialInfo.perceptualRoughness, materialInfo.c_diff, materialInfo.f0, materialInfo.specularWeight);
+    if (LIGHTING_ENABLED(LIGHTING_IBL))
+    {
+        f_specular += getIBLRadianceGGX(n, v, materialInfo.perceptualRoughness, materialInfo.f0, materialInfo.specularWeight);
+        f_diffuse += getIBLRadianceLambertian(n, v, materialInfo.perceptualRoughness, materialInfo.c_diff, materialInfo.f0, materialInfo.specularWeight);
 
 #ifdef MATERIAL_CLEARCOAT
-    f_clearcoat += getIBLRadianceGGX(materialInfo.clearcoatNormal, v, materialInfo.clearcoatRoughness, materialInfo.clearcoatF0, 1.0);
+        f_clearcoat += getIBLRadianceGGX(materialInfo.clearcoatNormal, v, materialInfo.clearcoatRoughness, materialInfo.clearcoatF0, 1.0);
 #endif
 
 #ifdef MATERIAL_SHEEN
-    f_sheen += getIBLRadianceCharlie(n, v, materialInfo.sheenRoughnessFactor, materialInfo.sheenColorFactor);
+        f_sheen += getIBLRadianceCharlie(n, v, materialInfo.sheenRoughnessFactor, materialInfo.sheenColorFactor);
 #endif
+    }
 #endif
 
 #if (defined(MATERIAL_TRANSMISSION) || defined(MATERIAL_VOLUME)) && (defined(USE_PUNCTUAL) || defined(USE_IBL))
@@ -360,8 +394,17 @@ float4 main(VSOut input) : SV_Target
     f_sheen = lerp(f_sheen, f_sheen * ao, material.occlusionStrength);
     f_clearcoat = lerp(f_clearcoat, f_clearcoat * ao, material.occlusionStrength);
 #endif
+
+#ifdef HAS_VERTEX_OCCLUSION
+    // baked at load time, multiplies with the authored map
+    f_diffuse *= input.v_occlusion;
+    f_specular *= input.v_occlusion;
+    f_sheen *= input.v_occlusion;
+    f_clearcoat *= input.v_occlusion;
+#endif
     
 #ifdef USE_PUNCTUAL
+    if (LIGHTING_ENABLED(LIGHTING_PUNCTUAL))
     {
         
         //-----------------------------------------------------------------------------
@@ -420,6 +463,7 @@ float4 main(VSOut input) : SV_Target
 #endif
     }
  
+    if (LIGHTING_ENABLED(LIGHTING_PUNCTUAL))
     {
         
         //-----------------------------------------------------------------------------
@@ -493,8 +537,11 @@ float4 main(VSOut input) : SV_Target
     float3 clearcoatFresnel = float3(0.0.xxx);
 
 #ifdef MATERIAL_CLEARCOAT
-    clearcoatFactor = materialInfo.clearcoatFactor;
-    clearcoatFresnel = F_Schlick(materialInfo.clearcoatF0, materialInfo.clearcoatF90, clampedDot(materialInfo.clearcoatNormal, v));
+    if (LIGHTING_ENABLED(LIGHTING_CLEARCOAT))
+    {
+        clearcoatFactor = materialInfo.clearcoatFactor;
+        clearcoatFresnel = F_Schlick(materialInfo.clearcoatF0, materialInfo.clearcoatF90, clampedDot(materialInfo.clearcoatNormal, v));
+    }
     f_clearcoat = f_clearcoat * clearcoatFactor;
 #endif
 
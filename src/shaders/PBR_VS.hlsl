@@ -38,6 +38,10 @@ struct VSOut
     float2 UV0 : TEXCOORD0;
     float2 UV1 : TEXCOORD1;
 
+#ifdef HAS_VERTEX_OCCLUSION
+    float v_occlusion : OCCLUSION0;
+#endif
+
 };
 
 float4 getPosition(VSIn input)
@@ -52,6 +56,10 @@ float4 getPosition(VSIn input)
     pos = mul(getSkinningMatrix(input), pos);
 #endif
 
+#ifdef USE_INSTANCING
+    pos = mul(InstanceTransforms[input.iid * 2], pos);
+#endif
+
     return pos;
 }
 
@@ -68,6 +76,10 @@ float3 getNormal(VSIn input)
     normal = mul((float3x3)getSkinningNormalMatrix(input), normal);
 #endif
 
+#ifdef USE_INSTANCING
+    normal = mul((float3x3)InstanceTransforms[input.iid * 2 + 1], normal);
+#endif
+
     return normalize(normal);
 }
 #endif
@@ -85,6 +97,10 @@ float3 getTangent(VSIn input)
     tangent = mul((float3x3)getSkinningMatrix(input), tangent);
 #endif
 
+#ifdef USE_INSTANCING
+    tangent = mul((float3x3)InstanceTransforms[input.iid * 2], tangent);
+#endif
+
     return normalize(tangent);
 }
 #endif
@@ -134,5 +150,9 @@ VSOut main(VSIn input)
         output.v_color1 = input.a_color1;
     #endif
 
+    #ifdef HAS_VERTEX_OCCLUSION
+        output.v_occlusion = input.a_occlusion;
+    #endif
+
     return output;
 }
\ No newline at end of file
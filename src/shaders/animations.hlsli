@@ -2,7 +2,8 @@
 #ifdef USE_MORPHING
 cbuffer MorphCBuf : register(b3)
 {
-    float morphWeights[WEIGHT_COUNT];
+    float4 morphInfo;                  // x: active target count
+    float4 morphTargets[WEIGHT_COUNT]; // x: weight, y: target index, only non-zero weights
 };
 #endif
 
@@ -58,9 +59,18 @@ struct VSIn
     float4 a_weights_1 : Weights1;
 #endif
 
+#ifdef HAS_VERTEX_OCCLUSION
+    float a_occlusion : Occlusion;
+#endif
+
     uint vid : SV_VertexID;
+    uint iid : SV_InstanceID;
 };
 
+#ifdef USE_INSTANCING
+StructuredBuffer<float4x4> InstanceTransforms : register(t2); // transform, normal matrix per instance
+#endif
+
 #ifdef USE_SKINNING
 Texture2D JointsTexture : register(t0);
 SamplerState JointsTextureSampler : register(s0);
@@ -184,10 +194,11 @@ float4 getTargetPosition(int vertexID)
     int texWidth = 0;
     int texHeight = 0;
     MorphTargetsTexture.GetDimensions(0, texWidth, texHeight, elements, levels);
-    for(int i = 0; i < WEIGHT_COUNT; i++)
+    for(int i = 0; i < int(morphInfo.x); i++)
     {
-        float4 displacement = getDisplacement(vertexID, MORPH_TARGET_POSITION_OFFSET + i, texWidth);
-        pos += morphWeights[i] * displacement;
+        int target = int(morphTargets[i].y);
+        float4 displacement = getDisplacement(vertexID, MORPH_TARGET_POSITION_OFFSET + target, texWidth);
+        pos += morphTargets[i].x * displacement;
     }
 #endif
 
@@ -204,10 +215,11 @@ float3 getTargetNormal(int vertexID)
     int texWidth = 0;
     int texHeight = 0;
     MorphTargetsTexture.GetDimensions(0, texWidth, texHeight, elements, levels);
-    for(int i = 0; i < WEIGHT_COUNT; i++)
+    for(int i = 0; i < int(morphInfo.x); i++)
     {
-        float3 displacement = getDisplacement(vertexID, MORPH_TARGET_NORMAL_OFFSET + i, texWidth).xyz;
-        normal += morphWeights[i] * displacement;
+        int target = int(morphTargets[i].y);
+        float3 displacement = getDisplacement(vertexID, MORPH_TARGET_NORMAL_OFFSET + target, texWidth).xyz;
+        normal += morphTargets[i].x * displacement;
     }
 #endif
 
@@ -225,10 +237,11 @@ float3 getTargetTangent(int vertexID)
     int texWidth = 0;
     int texHeight = 0;
     MorphTargetsTexture.GetDimensions(0, texWidth, texHeight, elements, levels);
-    for(int i = 0; i < WEIGHT_COUNT; i++)
+    for(int i = 0; i < int(morphInfo.x); i++)
     {
-        float3 displacement = getDisplacement(vertexID, MORPH_TARGET_TANGENT_OFFSET + i, texWidth).xyz;
-        tangent += morphWeights[i] * displacement;
+        int target = int(morphTargets[i].y);
+        float3 displacement = getDisplacement(vertexID, MORPH_TARGET_TANGENT_OFFSET + target, texWidth).xyz;
+        tangent += morphTargets[i].x * displacement;
     }
 #endif
 
@@ -246,10 +259,11 @@ float2 getTargetTexCoord0(int vertexID)
     int texHeight = 0;
     //MorphTargetsTexture.GetDimensions(0, texWidth, texHeight, levels);
     MorphTargetsTexture.GetDimensions(0, texWidth, texHeight, elements, levels);
-    for(int i = 0; i < WEIGHT_COUNT; i++)
+    for(int i = 0; i < int(morphInfo.x); i++)
     {
-        float2 displacement = getDisplacement(vertexID, MORPH_TARGET_TEXCOORD_0_OFFSET + i, texWidth).xy;
-        uv += morphWeights[i] * displacement;
+        int target = int(morphTargets[i].y);
+        float2 displacement = getDisplacement(vertexID, MORPH_TARGET_TEXCOORD_0_OFFSET + target, texWidth).xy;
+        uv += morphTargets[i].x * displacement;
     }
 #endif
 
@@ -267,10 +281,11 @@ float2 getTargetTexCoord1(int vertexID)
     int texHeight = 0;
     //MorphTargetsTexture.GetDimensions(0, texWidth, texHeight, levels);
     MorphTargetsTexture.GetDimensions(0, texWidth, texHeight, elements, levels);
-    for(int i = 0; i < WEIGHT_COUNT; i++)
+    for(int i = 0; i < int(morphInfo.x); i++)
     {
-        float2 displacement = getDisplacement(vertexID, MORPH_TARGET_TEXCOORD_1_OFFSET + i, texWidth).xy;
-        uv += morphWeights[i] * displacement;
+        int target = int(morphTargets[i].y);
+        float2 displacement = getDisplacement(vertexID, MORPH_TARGET_TEXCOORD_1_OFFSET + target, texWidth).xy;
+        uv += morphTargets[i].x * displacement;
     }
 #endif
 
@@ -289,10 +304,11 @@ float4 getTargetColor0(int vertexID)
     MorphTargetsTexture.GetDimensions(0, texWidth, texHeight, elements, levels);
 
 #ifdef HAS_MORPH_TARGET_COLOR_0
-    for(int i = 0; i < WEIGHT_COUNT; i++)
+    for(int i = 0; i < int(morphInfo.x); i++)
     {
-        float4 displacement = getDisplacement(vertexID, MORPH_TARGET_COLOR_0_OFFSET + i, texWidth);
-        color += morphWeights[i] * displacement;
+        int target = int(morphTargets[i].y);
+        float4 displacement = getDisplacement(vertexID, MORPH_TARGET_COLOR_0_OFFSET + target, texWidth);
+        color += morphTargets[i].x * displacement;
     }
 #endif
 
@@ -0,0 +1,360 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include "stb_image.h"
+#include "mvGraphics.h"
+#include "mvMaterials.h"
+#include "mvAssetLoader.h"
+#include "mvHash.h"
+#include "mvShaderPermutations.h"
+#include "sGltf.h"
+#include "gltf_scene_info.h"
+
+// usage: asset_analysis [--json output.json] [model.gltf|model.glb ...]
+//
+// Runs the loader's CPU stage (cook_gltf_primitive) over each model and
+// reports what the renderer would end up with. No window or device is created.
+
+struct mvLayoutUsage
+{
+    std::string  semantics;
+    unsigned int stride = 0u;
+    size_t       vertexCount = 0u;
+};
+
+struct mvAssetReport
+{
+    std::string  path;
+    size_t       sourceVertices = 0u;   // glTF POSITION counts
+    size_t       emittedVertices = 0u;  // after de-indexing
+    size_t       uniqueVertices = 0u;   // distinct emitted vertices
+    size_t       triangles = 0u;
+    double       sourceACMR = 0.0;
+    double       sourceATVR = 0.0;
+    double       emittedACMR = 0.0;
+    double       emittedATVR = 0.0;
+    unsigned int indexFormats[4] = {};  // none, u8, u16, u32 (source)
+    std::vector<mvLayoutUsage> layouts;
+    size_t       textureBytes = 0u;
+    unsigned int imageCount = 0u;
+    unsigned int duplicateImages = 0u;
+    unsigned int materialCount = 0u;
+    unsigned int permutationCount = 0u;
+    unsigned int drawCount = 0u;
+    size_t       vertexBytes = 0u;
+    size_t       indexBytes = 0u;
+    size_t       morphBytes = 0u;
+    size_t       skinBytes = 0u;
+    size_t       gpuBytes = 0u;
+};
+
+// misses of a FIFO post-transform cache
+static size_t
+simulate_vertex_cache(const std::vector<unsigned int>& indices, unsigned int cacheSize = 16u)
+{
+    std::vector<unsigned int> cache(cacheSize, 0xFFFFFFFF);
+    unsigned int head = 0u;
+    size_t misses = 0u;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        bool hit = false;
+        for (unsigned int j = 0; j < cacheSize; j++)
+        {
+            if (cache[j] == indices[i])
+            {
+                hit = true;
+                break;
+            }
+        }
+        if (hit)
+            continue;
+        cache[head] = indices[i];
+        head = (head + 1) % cacheSize;
+        misses++;
+    }
+    return misses;
+}
+
+static std::string
+get_texture_key(sGLTFModel& model, int materialIndex)
+{
+    if (materialIndex == -1)
+        return {};
+
+    sGLTFMaterial& glmaterial = model.materials[materialIndex];
+    int textures[] = {
+        glmaterial.base_color_texture, glmaterial.normal_texture, glmaterial.metallic_roughness_texture,
+        glmaterial.emissive_texture, glmaterial.occlusion_texture, glmaterial.clearcoat_texture,
+        glmaterial.clearcoat_roughness_texture, glmaterial.clearcoat_normal_texture };
+    std::string key;
+    for (int i = 0; i < 8; i++)
+        key.append(std::to_string(textures[i] == -1 ? -1 : model.textures[textures[i]].image_index) + ",");
+    return key;
+}
+
+static void
+analyze_images(sGLTFModel& model, mvAssetReport& report)
+{
+    std::unordered_set<uint64_t> contents;
+    for (unsigned int i = 0; i < model.image_count; i++)
+    {
+        sGLTFImage& image = model.images[i];
+        std::vector<unsigned char> fileData;
+        const unsigned char* data = image.data;
+        size_t dataCount = image.dataCount;
+        if (!image.embedded)
+        {
+            FILE* file = fopen((model.root + image.uri).c_str(), "rb");
+            if (file == nullptr)
+                continue;
+            fseek(file, 0, SEEK_END);
+            fileData.resize(ftell(file));
+            fseek(file, 0, SEEK_SET);
+            fileData.resize(fread(fileData.data(), 1, fileData.size(), file));
+            fclose(file);
+            data = fileData.data();
+            dataCount = fileData.size();
+        }
+
+        report.imageCount++;
+        if (!contents.insert(hash_bytes(data, dataCount)).second)
+        {
+            report.duplicateImages++; // the loader shares embedded duplicates, external ones load twice
+            if (image.embedded)
+                continue;
+        }
+
+        // RGBA8 with a full mip chain
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        if (stbi_info_from_memory(data, (int)dataCount, &width, &height, &channels))
+            report.textureBytes += (size_t)width * height * 4u * 4u / 3u;
+    }
+}
+
+static bool
+analyze_model(const char* directory, const char* file, mvAssetReport& report)
+{
+    report.path = file;
+    if (!std::filesystem::exists(file))
+        return false;
+
+    sGLTFModel model = Semper::load_gltf(directory, file);
+
+    std::unordered_set<uint64_t> materials;
+    std::unordered_set<uint64_t> permutations;
+    std::unordered_map<std::string, size_t> layoutIndices;
+    size_t sourceMisses = 0u;
+    size_t emittedMisses = 0u;
+
+    for (unsigned int i = 0; i < model.mesh_count; i++)
+    {
+        sGLTFMesh& glmesh = model.meshes[i];
+        for (unsigned int j = 0; j < glmesh.primitives_count; j++)
+        {
+            mvCookedPrimitive cooked{};
+            cook_gltf_primitive(model, glmesh, j, false, cooked);
+
+            std::vector<unsigned int> sourceIndices = cooked.sourceIndexData;
+            if (sourceIndices.empty())
+            {
+                sourceIndices.resize(cooked.sourceVertexCount);
+                for (unsigned int k = 0; k < cooked.sourceVertexCount; k++)
+                    sourceIndices[k] = k;
+            }
+
+            unsigned int stride = cooked.layout.size;
+            size_t emitted = stride > 0u ? cooked.vertexData.size() * sizeof(float) / stride : 0u;
+            std::unordered_set<uint64_t> unique;
+            for (size_t k = 0; k < emitted; k++)
+                unique.insert(hash_bytes((const char*)cooked.vertexData.data() + k * stride, stride));
+
+            report.sourceVertices += cooked.sourceVertexCount;
+            report.emittedVertices += emitted;
+            report.uniqueVertices += unique.size();
+            report.triangles += cooked.indexData.size() / 3;
+            sourceMisses += simulate_vertex_cache(sourceIndices);
+            emittedMisses += simulate_vertex_cache(cooked.indexData);
+            report.indexFormats[cooked.sourceIndexSize == 4 ? 3 : cooked.sourceIndexSize]++;
+            report.vertexBytes += cooked.vertexData.size() * sizeof(float);
+            report.indexBytes += cooked.indexData.size() * sizeof(unsigned int);
+            report.morphBytes += (size_t)cooked.morphWidth * cooked.morphWidth * cooked.morphLayers * 4u * sizeof(float);
+
+            std::string semantics;
+            for (auto& semantic : cooked.layout.semantics)
+                semantics.append(semantics.empty() ? semantic : "|" + semantic);
+            auto layout = layoutIndices.find(semantics);
+            if (layout == layoutIndices.end())
+            {
+                layout = layoutIndices.insert({ semantics, report.layouts.size() }).first;
+                report.layouts.push_back({ semantics, stride, 0u });
+            }
+            report.layouts[layout->second].vertexCount += emitted;
+
+            int materialIndex = glmesh.primitives[j].material_index;
+            cook_gltf_material(model, materialIndex, cooked.material);
+            materials.insert(hash_string(get_texture_key(model, materialIndex), hash_material_data(cooked.material, hash_material(cooked.material, cooked.layout, "PBR_PS.hlsl", "PBR_VS.hlsl"))));
+            permutations.insert(hash_permutation(get_material_permutation(cooked.material, MV_LIGHTING_ALL, MV_LIGHTING_ALL)));
+
+            delete[] cooked.morphData;
+        }
+    }
+
+    for (unsigned int i = 0; i < model.node_count; i++)
+    {
+        if (model.nodes[i].mesh_index > -1)
+            report.drawCount += model.meshes[model.nodes[i].mesh_index].primitives_count;
+    }
+
+    for (unsigned int i = 0; i < model.skin_count; i++)
+    {
+        size_t textureWidth = (size_t)ceil(sqrt(model.skins[i].joints_count * 8));
+        report.skinBytes += textureWidth * textureWidth * 4u * sizeof(float);
+    }
+
+    analyze_images(model, report);
+
+    report.sourceACMR = report.triangles > 0u ? (double)sourceMisses / report.triangles : 0.0;
+    report.sourceATVR = report.sourceVertices > 0u ? (double)sourceMisses / report.sourceVertices : 0.0;
+    report.emittedACMR = report.triangles > 0u ? (double)emittedMisses / report.triangles : 0.0;
+    report.emittedATVR = report.uniqueVertices > 0u ? (double)emittedMisses / report.uniqueVertices : 0.0;
+    report.materialCount = (unsigned int)materials.size();
+    report.permutationCount = (unsigned int)permutations.size();
+    report.gpuBytes = report.vertexBytes + report.indexBytes + report.morphBytes + report.skinBytes +
+        report.textureBytes + report.materialCount * sizeof(mvMaterialData);
+
+    Semper::free_gltf(model);
+    return true;
+}
+
+static void
+print_table(const std::vector<mvAssetReport>& reports)
+{
+    printf("%-32s %9s %9s %9s %6s %6s %6s %-15s %9s %4s %4s %5s %5s %9s\n", "model", "src vtx", "emitted", "unique",
+        "acmr", "atvr", "e.acmr", "idx n/8/16/32", "tex MB", "dup", "mat", "perm", "draws", "gpu MB");
+    for (size_t i = 0; i < reports.size(); i++)
+    {
+        const mvAssetReport& report = reports[i];
+        std::string name = std::filesystem::path(report.path).stem().string();
+        char formats[32];
+        snprintf(formats, sizeof(formats), "%u/%u/%u/%u", report.indexFormats[0], report.indexFormats[1], report.indexFormats[2], report.indexFormats[3]);
+        printf("%-32.32s %9zu %9zu %9zu %6.3f %6.3f %6.3f %-15s %9.2f %4u %4u %5u %5u %9.2f\n", name.c_str(),
+            report.sourceVertices, report.emittedVertices, report.uniqueVertices, report.sourceACMR, report.sourceATVR,
+            report.emittedACMR, formats, report.textureBytes / (1024.0 * 1024.0), report.duplicateImages,
+            report.materialCount, report.permutationCount, report.drawCount, report.gpuBytes / (1024.0 * 1024.0));
+    }
+
+    printf("\nbytes per vertex by layout\n");
+    std::unordered_map<std::string, mvLayoutUsage> layouts;
+    for (size_t i = 0; i < reports.size(); i++)
+    {
+        for (size_t j = 0; j < reports[i].layouts.size(); j++)
+        {
+            const mvLayoutUsage& usage = reports[i].layouts[j];
+            mvLayoutUsage& total = layouts[usage.semantics];
+            total.semantics = usage.semantics;
+            total.stride = usage.stride;
+            total.vertexCount += usage.vertexCount;
+        }
+    }
+    for (auto& item : layouts)
+        printf("  %4u B  %12zu vertices  %s\n", item.second.stride, item.second.vertexCount, item.second.semantics.c_str());
+}
+
+static void
+write_json(const std::vector<mvAssetReport>& reports, const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+        return;
+
+    fprintf(file, "[\n");
+    for (size_t i = 0; i < reports.size(); i++)
+    {
+        const mvAssetReport& report = reports[i];
+        fprintf(file, "  {\n");
+        fprintf(file, "    \"path\": \"%s\",\n", escape_json(report.path).c_str());
+        fprintf(file, "    \"vertices\": { \"source\": %zu, \"emitted\": %zu, \"unique\": %zu },\n", report.sourceVertices, report.emittedVertices, report.uniqueVertices);
+        fprintf(file, "    \"triangles\": %zu,\n", report.triangles);
+        fprintf(file, "    \"vertexCache\": { \"sourceACMR\": %.4f, \"sourceATVR\": %.4f, \"emittedACMR\": %.4f, \"emittedATVR\": %.4f },\n",
+            report.sourceACMR, report.sourceATVR, report.emittedACMR, report.emittedATVR);
+        fprintf(file, "    \"indexFormats\": { \"none\": %u, \"u8\": %u, \"u16\": %u, \"u32\": %u },\n",
+            report.indexFormats[0], report.indexFormats[1], report.indexFormats[2], report.indexFormats[3]);
+        fprintf(file, "    \"layouts\": [");
+        for (size_t j = 0; j < report.layouts.size(); j++)
+        {
+            const mvLayoutUsage& usage = report.layouts[j];
+            fprintf(file, "%s\n      { \"semantics\": \"%s\", \"bytesPerVertex\": %u, \"vertices\": %zu }", j == 0 ? "" : ",",
+                usage.semantics.c_str(), usage.stride, usage.vertexCount);
+        }
+        fprintf(file, "\n    ],\n");
+        fprintf(file, "    \"images\": { \"count\": %u, \"duplicates\": %u, \"bytes\": %zu },\n", report.imageCount, report.duplicateImages, report.textureBytes);
+        fprintf(file, "    \"materials\": %u,\n", report.materialCount);
+        fprintf(file, "    \"permutations\": %u,\n", report.permutationCount);
+        fprintf(file, "    \"draws\": %u,\n", report.drawCount);
+        fprintf(file, "    \"gpuBytes\": { \"vertex\": %zu, \"index\": %zu, \"morph\": %zu, \"skin\": %zu, \"texture\": %zu, \"total\": %zu }\n",
+            report.vertexBytes, report.indexBytes, report.morphBytes, report.skinBytes, report.textureBytes, report.gpuBytes);
+        fprintf(file, "  }%s\n", i + 1 < reports.size() ? "," : "");
+    }
+    fprintf(file, "]\n");
+    fclose(file);
+}
+
+int main(int argc, char** argv)
+{
+    std::string jsonPath = "../bench/asset_analysis.json";
+    std::vector<std::string> directories;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (argv[i][0] == '-')
+        {
+            printf("usage: asset_analysis [--json output.json] [model.gltf|model.glb ...]\n");
+            return 1;
+        }
+        else
+        {
+            std::string directory = std::filesystem::path(argv[i]).parent_path().string();
+            directories.push_back(directory.empty() ? "./" : directory + "/");
+            files.push_back(argv[i]);
+        }
+    }
+
+    // default to the sandbox's model list
+    if (files.empty())
+    {
+        for (int i = 0; i < sizeof(gltf_models) / sizeof(gltf_models[0]); i++)
+        {
+            directories.push_back(gltf_directories[i]);
+            files.push_back(gltf_models[i]);
+        }
+    }
+
+    std::vector<mvAssetReport> reports;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        mvAssetReport report{};
+        if (analyze_model(directories[i].c_str(), files[i].c_str(), report))
+            reports.push_back(report);
+        else
+            printf("skipping %s (not found)\n", files[i].c_str());
+    }
+
+    print_table(reports);
+
+    std::filesystem::path output(jsonPath);
+    if (output.has_parent_path())
+        std::filesystem::create_directories(output.parent_path());
+    write_json(reports, jsonPath.c_str());
+    printf("\nwrote %s\n", jsonPath.c_str());
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "mvSceneGenerator.h"
+
+// usage: gltf_generator [options] output.gltf|output.glb
+
+static void
+print_usage()
+{
+    printf("usage: gltf_generator [options] output.gltf|output.glb\n");
+    printf("  --nodes N        mesh nodes (default 1)\n");
+    printf("  --depth N        hierarchy levels (default 1)\n");
+    printf("  --meshes N       distinct meshes (default 1)\n");
+    printf("  --primitives N   primitives per mesh (default 1)\n");
+    printf("  --triangles N    triangles per primitive (default 2)\n");
+    printf("  --materials N    materials (default 1)\n");
+    printf("  --textures N     base color textures (default 0)\n");
+    printf("  --texture-size N texture resolution (default 64)\n");
+    printf("  --joints N       skin joints (default 0)\n");
+    printf("  --morphs N       morph targets per primitive (default 0)\n");
+    printf("  --channels N     animation channels (default 0)\n");
+}
+
+int main(int argc, char** argv)
+{
+    mvSceneDesc desc{};
+    const char* output = nullptr;
+
+    struct { const char* name; int* value; } options[] = {
+        { "--nodes",        &desc.nodeCount },
+        { "--depth",        &desc.hierarchyDepth },
+        { "--meshes",       &desc.meshCount },
+        { "--primitives",   &desc.primitivesPerMesh },
+        { "--triangles",    &desc.trianglesPerPrimitive },
+        { "--materials",    &desc.materialCount },
+        { "--textures",     &desc.textureCount },
+        { "--texture-size", &desc.textureSize },
+        { "--joints",       &desc.jointCount },
+        { "--morphs",       &desc.morphTargetCount },
+        { "--channels",     &desc.animationChannels },
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool matched = false;
+        for (int j = 0; j < sizeof(options) / sizeof(options[0]); j++)
+        {
+            if (strcmp(argv[i], options[j].name) == 0 && i + 1 < argc)
+            {
+                *options[j].value = atoi(argv[++i]);
+                matched = true;
+                break;
+            }
+        }
+
+        if (matched)
+            continue;
+        if (argv[i][0] == '-')
+        {
+            print_usage();
+            return 1;
+        }
+        output = argv[i];
+    }
+
+    if (output == nullptr || desc.nodeCount < 1 || desc.meshCount < 1 || desc.primitivesPerMesh < 1 || desc.materialCount < 1 || desc.textureSize < 1)
+    {
+        print_usage();
+        return 1;
+    }
+
+    if (!write_synthetic_gltf(desc, output))
+    {
+        printf("failed to write %s\n", output);
+        return 1;
+    }
+
+    printf("%s: %s\n", output, describe_scene(desc).c_str());
+    return 0;
+}
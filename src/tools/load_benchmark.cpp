@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include "imgui.h"
+#include "mvGraphics.h"
+#include "mvAssetLoader.h"
+#include "mvAnimation.h"
+#include "mvCamera.h"
+#include "mvViewport.h"
+#include "sGltf.h"
+#include "gltf_scene_info.h"
+
+// usage: load_benchmark [options] [model.gltf|model.glb ...]
+//
+// Loads every model (default: gltf_scene_info.h) in sequence, several times,
+// and compares cold/warm wall time, peak heap and allocation count against a
+// baseline file. --headless runs load_gltf_assets on setup_headless_graphics,
+// which skips every D3D call, so no window or GPU is needed.
+
+struct mvLoadResult
+{
+    std::string path;
+    double      coldMs = 0.0;      // first load in the process
+    double      warmMs = 0.0;      // median of the remaining loads
+    double      peakMB = 0.0;      // peak heap growth over a load
+    size_t      allocations = 0u;  // operator new calls per load
+};
+
+//-----------------------------------------------------------------------------
+// allocation tracking (operator new only, malloc inside stb/Semper is not seen)
+//-----------------------------------------------------------------------------
+
+static std::atomic<size_t> s_allocationCount = 0u;
+static std::atomic<size_t> s_liveBytes = 0u;
+static std::atomic<size_t> s_peakBytes = 0u;
+
+static const size_t s_allocationHeader = 16u; // keeps the user block 16 byte aligned
+
+void*
+operator new(size_t size)
+{
+    unsigned char* block = (unsigned char*)malloc(size + s_allocationHeader);
+    if (block == nullptr)
+        throw std::bad_alloc();
+    *(size_t*)block = size;
+
+    s_allocationCount++;
+    size_t live = s_liveBytes += size;
+    size_t peak = s_peakBytes.load();
+    while (live > peak && !s_peakBytes.compare_exchange_weak(peak, live)) {}
+    return block + s_allocationHeader;
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+    unsigned char* block = (unsigned char*)ptr - s_allocationHeader;
+    s_liveBytes -= *(size_t*)block;
+    free(block);
+}
+
+void* operator new[](size_t size)                  { return operator new(size); }
+void  operator delete[](void* ptr) noexcept        { operator delete(ptr); }
+void  operator delete(void* ptr, size_t) noexcept   { operator delete(ptr); }
+void  operator delete[](void* ptr, size_t) noexcept { operator delete(ptr); }
+
+//-----------------------------------------------------------------------------
+// loading
+//-----------------------------------------------------------------------------
+
+static double
+get_elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// headless graphics run the same loader, minus the D3D calls
+static void
+load_model(mvGraphics& graphics, const char* directory, const char* file, bool bakeOcclusion)
+{
+    sGLTFModel gltf = Semper::load_gltf(directory, file);
+    mvModel model = load_gltf_assets(graphics, gltf, file, false, bakeOcclusion);
+    Semper::free_gltf(gltf);
+    unload_gltf_assets(graphics, model);
+}
+
+//-----------------------------------------------------------------------------
+// baseline
+//-----------------------------------------------------------------------------
+
+static std::unordered_map<std::string, mvLoadResult>
+read_results(const std::string& path)
+{
+    std::unordered_map<std::string, mvLoadResult> results;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return results;
+
+    char line[1024];
+    fgets(line, sizeof(line), file); // header
+    while (fgets(line, sizeof(line), file))
+    {
+        char name[512];
+        mvLoadResult result{};
+        if (sscanf(line, "%511[^,],%lf,%lf,%lf,%zu", name, &result.coldMs, &result.warmMs, &result.peakMB, &result.allocations) != 5)
+            continue;
+        result.path = name;
+        results[result.path] = result;
+    }
+    fclose(file);
+    return results;
+}
+
+static void
+write_results(const std::vector<mvLoadResult>& results, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return;
+
+    fprintf(file, "model,cold_ms,warm_ms,peak_mb,allocations\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const mvLoadResult& result = results[i];
+        fprintf(file, "%s,%.3f,%.3f,%.3f,%zu\n", result.path.c_str(), result.coldMs, result.warmMs, result.peakMB, result.allocations);
+    }
+    fclose(file);
+}
+
+// prints metrics that moved past the threshold, returns true if it grew
+static bool
+check_regression(const char* name, double value, double baseline, double threshold)
+{
+    if (baseline <= 0.0)
+        return false;
+    if (value < baseline * (1.0 - threshold))
+        printf("    improved   %s %.3f -> %.3f (%.1f%%)\n", name, baseline, value, (value / baseline - 1.0) * 100.0);
+    if (value <= baseline * (1.0 + threshold))
+        return false;
+    printf("    REGRESSION %s %.3f -> %.3f (+%.1f%%)\n", name, baseline, value, (value / baseline - 1.0) * 100.0);
+    return true;
+}
+
+static void
+print_usage()
+{
+    printf("usage: load_benchmark [options] [model.gltf|model.glb ...]\n");
+    printf("  --repeat N          loads per model, first is cold (default 5)\n");
+    printf("  --threshold P       regression threshold in percent (default 10)\n");
+    printf("  --baseline path     baseline csv (default ../bench/load_baseline.csv)\n");
+    printf("  --update-baseline   write this run as the new baseline\n");
+    printf("  --headless          run the loader without a device or window\n");
+    printf("  --bake-occlusion    include the per-vertex occlusion bake\n");
+}
+
+int main(int argc, char** argv)
+{
+    int repeat = 5;
+    double threshold = 0.10;
+    bool updateBaseline = false;
+    bool headless = false;
+    bool bakeOcclusion = false;
+    std::string baselinePath = "../bench/load_baseline.csv";
+    std::vector<std::string> directories;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = std::max(atoi(argv[++i]), 2);
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]) / 100.0;
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--update-baseline") == 0)
+            updateBaseline = true;
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--bake-occlusion") == 0)
+            bakeOcclusion = true;
+        else if (argv[i][0] == '-')
+        {
+            print_usage();
+            return 1;
+        }
+        else
+        {
+            std::string directory = std::filesystem::path(argv[i]).parent_path().string();
+            directories.push_back(directory.empty() ? "./" : directory + "/");
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.empty())
+    {
+        for (int i = 0; i < sizeof(gltf_models) / sizeof(gltf_models[0]); i++)
+        {
+            directories.push_back(gltf_directories[i]);
+            files.push_back(gltf_models[i]);
+        }
+    }
+
+    mvViewport* window = nullptr;
+    mvGraphics graphics{};
+    if (headless)
+        graphics = setup_headless_graphics("../src/shaders/");
+    else
+    {
+        window = initialize_viewport(1280, 720);
+        graphics = setup_graphics(*window, "../src/shaders/");
+        ImGui::CreateContext(); // viewport code reads ImGui io
+    }
+
+    // timings[pass][model], every model is loaded once per pass so the first pass is cold
+    std::vector<std::vector<double>> timings(repeat, std::vector<double>(files.size(), 0.0));
+    std::vector<mvLoadResult> results(files.size());
+    for (int pass = 0; pass < repeat; pass++)
+    {
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            results[i].path = files[i];
+            if (!std::filesystem::exists(files[i]))
+                continue;
+
+            size_t allocations = s_allocationCount;
+            size_t live = s_liveBytes;
+            s_peakBytes = live;
+
+            auto start = std::chrono::steady_clock::now();
+            load_model(graphics, directories[i].c_str(), files[i].c_str(), bakeOcclusion);
+            timings[pass][i] = get_elapsed_ms(start);
+
+            results[i].allocations = s_allocationCount - allocations;
+            results[i].peakMB = std::max(results[i].peakMB, (s_peakBytes - live) / (1024.0 * 1024.0));
+        }
+    }
+
+    std::filesystem::path baselineFile(baselinePath);
+    if (baselineFile.has_parent_path())
+        std::filesystem::create_directories(baselineFile.parent_path());
+    std::unordered_map<std::string, mvLoadResult> baseline = read_results(baselinePath);
+
+    int regressions = 0;
+    printf("%-40s %10s %10s %10s %12s\n", "model", "cold ms", "warm ms", "peak MB", "allocations");
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        mvLoadResult& result = results[i];
+        if (!std::filesystem::exists(files[i]))
+        {
+            printf("%-40.40s (not found)\n", std::filesystem::path(files[i]).stem().string().c_str());
+            continue;
+        }
+
+        std::vector<double> warm;
+        for (int pass = 1; pass < repeat; pass++)
+            warm.push_back(timings[pass][i]);
+        std::sort(warm.begin(), warm.end());
+        result.coldMs = timings[0][i];
+        result.warmMs = warm[warm.size() / 2];
+
+        printf("%-40.40s %10.2f %10.2f %10.2f %12zu\n", std::filesystem::path(files[i]).stem().string().c_str(),
+            result.coldMs, result.warmMs, result.peakMB, result.allocations);
+
+        auto previous = baseline.find(result.path);
+        if (previous == baseline.end())
+            continue;
+
+        // cold loads depend on the OS file cache, only warm numbers gate
+        bool regressed = false;
+        regressed |= check_regression("warm ms", result.warmMs, previous->second.warmMs, threshold);
+        regressed |= check_regression("peak MB", result.peakMB, previous->second.peakMB, threshold);
+        regressed |= check_regression("allocations", (double)result.allocations, (double)previous->second.allocations, threshold);
+        if (regressed)
+            regressions++;
+    }
+
+    std::vector<mvLoadResult> loaded;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (std::filesystem::exists(files[i]))
+            loaded.push_back(results[i]);
+    }
+    write_results(loaded, "../bench/load_benchmark.csv");
+
+    size_t allocations = 0u;
+    size_t baselineAllocations = 0u;
+    for (size_t i = 0; i < loaded.size(); i++)
+    {
+        allocations += loaded[i].allocations;
+        auto previous = baseline.find(loaded[i].path);
+        if (previous != baseline.end())
+            baselineAllocations += previous->second.allocations;
+    }
+    printf("\ntotal allocations per pass: %zu (baseline %zu)\n", allocations, baselineAllocations);
+
+    if (updateBaseline || baseline.empty())
+    {
+        write_results(loaded, baselinePath);
+        printf("wrote baseline %s\n", baselinePath.c_str());
+    }
+    else
+        printf("%d of %zu models regressed by more than %.0f%%\n", regressions, loaded.size(), threshold * 100.0);
+
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,555 @@
+#include "mvSceneGenerator.h"
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+struct mvGltfWriter
+{
+    std::vector<unsigned char> bin;
+    std::string                bufferViews; // json, comma separated
+    std::string                accessors;
+    int                        bufferViewCount = 0;
+    int                        accessorCount = 0;
+};
+
+static std::string
+format_floats(const float* values, int count)
+{
+    std::string result = "[";
+    char number[32];
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(number, sizeof(number), i == 0 ? "%.6g" : ",%.6g", values[i]);
+        result.append(number);
+    }
+    return result + "]";
+}
+
+static int
+add_buffer_view(mvGltfWriter& writer, const void* data, size_t size, int target = 0)
+{
+    while (writer.bin.size() % 4 != 0)
+        writer.bin.push_back(0);
+
+    size_t offset = writer.bin.size();
+    writer.bin.insert(writer.bin.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+
+    if (writer.bufferViewCount > 0)
+        writer.bufferViews.append(",");
+    writer.bufferViews.append("{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) + ",\"byteLength\":" + std::to_string(size));
+    if (target != 0)
+        writer.bufferViews.append(",\"target\":" + std::to_string(target));
+    writer.bufferViews.append("}");
+    return writer.bufferViewCount++;
+}
+
+static int
+add_accessor(mvGltfWriter& writer, int bufferView, int componentType, int count, const char* type, const float* mins = nullptr, const float* maxes = nullptr, int components = 0)
+{
+    if (writer.accessorCount > 0)
+        writer.accessors.append(",");
+    writer.accessors.append("{\"bufferView\":" + std::to_string(bufferView) + ",\"componentType\":" + std::to_string(componentType)
+        + ",\"count\":" + std::to_string(count) + ",\"type\":\"" + type + "\"");
+    if (mins && maxes)
+        writer.accessors.append(",\"min\":" + format_floats(mins, components) + ",\"max\":" + format_floats(maxes, components));
+    writer.accessors.append("}");
+    return writer.accessorCount++;
+}
+
+static int
+add_float_accessor(mvGltfWriter& writer, const std::vector<float>& data, int components, const char* type, int target, bool bounds = false)
+{
+    int count = (int)data.size() / components;
+    float mins[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float maxes[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; bounds && i < count; i++)
+    {
+        for (int c = 0; c < components; c++)
+        {
+            float value = data[i * components + c];
+            if (i == 0 || value < mins[c]) mins[c] = value;
+            if (i == 0 || value > maxes[c]) maxes[c] = value;
+        }
+    }
+
+    int view = add_buffer_view(writer, data.data(), data.size() * sizeof(float), target);
+    return add_accessor(writer, view, 5126, count, type, bounds ? mins : nullptr, bounds ? maxes : nullptr, components);
+}
+
+//-----------------------------------------------------------------------------
+// png (uncompressed deflate, good enough for test textures)
+//-----------------------------------------------------------------------------
+
+static unsigned int
+png_crc(const unsigned char* data, size_t size, unsigned int crc = 0xFFFFFFFFu)
+{
+    static unsigned int table[256];
+    static bool tableReady = false;
+    if (!tableReady)
+    {
+        for (unsigned int n = 0; n < 256; n++)
+        {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        tableReady = true;
+    }
+
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static void
+append_u32_be(std::vector<unsigned char>& out, unsigned int value)
+{
+    out.push_back((value >> 24) & 0xFF);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+static void
+append_u32_le(std::vector<unsigned char>& out, unsigned int value)
+{
+    out.push_back(value & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 24) & 0xFF);
+}
+
+static void
+append_png_chunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+{
+    append_u32_be(out, (unsigned int)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    append_u32_be(out, png_crc(out.data() + start, out.size() - start) ^ 0xFFFFFFFFu);
+}
+
+static std::vector<unsigned char>
+encode_png(int width, int height, const unsigned char* rgba)
+{
+    std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+    std::vector<unsigned char> header;
+    append_u32_be(header, width);
+    append_u32_be(header, height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit rgba
+    append_png_chunk(png, "IHDR", header);
+
+    // scanlines with filter type 0
+    std::vector<unsigned char> raw;
+    for (int y = 0; y < height; y++)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y * width * 4, rgba + (y + 1) * width * 4);
+    }
+
+    std::vector<unsigned char> zlib = { 0x78, 0x01 };
+    unsigned int a = 1u;
+    unsigned int b = 0u;
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        a = (a + raw[i]) % 65521u;
+        b = (b + a) % 65521u;
+    }
+
+    for (size_t offset = 0; offset < raw.size(); offset += 65535)
+    {
+        size_t blockSize = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+        zlib.push_back(offset + blockSize == raw.size() ? 1 : 0);
+        zlib.push_back(blockSize & 0xFF);
+        zlib.push_back((blockSize >> 8) & 0xFF);
+        zlib.push_back(~blockSize & 0xFF);
+        zlib.push_back((~blockSize >> 8) & 0xFF);
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+    }
+    append_u32_be(zlib, (b << 16) | a);
+    append_png_chunk(png, "IDAT", zlib);
+    append_png_chunk(png, "IEND", {});
+    return png;
+}
+
+static std::vector<unsigned char>
+create_checker_texture(int size, int index)
+{
+    // distinct tint per texture so sharing bugs are visible
+    unsigned char tint[3] = {
+        (unsigned char)(64 + (index * 97) % 192),
+        (unsigned char)(64 + (index * 57) % 192),
+        (unsigned char)(64 + (index * 151) % 192) };
+
+    std::vector<unsigned char> pixels(size * size * 4);
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            bool light = ((x * 8 / size) + (y * 8 / size)) % 2 == 0;
+            unsigned char* pixel = &pixels[(y * size + x) * 4];
+            for (int c = 0; c < 3; c++)
+                pixel[c] = light ? 255 : tint[c];
+            pixel[3] = 255;
+        }
+    }
+    return encode_png(size, size, pixels.data());
+}
+
+//-----------------------------------------------------------------------------
+// scene
+//-----------------------------------------------------------------------------
+
+static void
+get_grid_position(int index, int count, float* position)
+{
+    int side = (int)std::ceil(std::sqrt((float)count));
+    position[0] = (index % side) * 1.5f;
+    position[1] = (index / side) * 1.5f;
+    position[2] = 0.0f;
+}
+
+static int
+get_parent_node(const mvSceneDesc& desc, int node)
+{
+    int levels = desc.hierarchyDepth < 1 ? 1 : desc.hierarchyDepth;
+    int perLevel = (desc.nodeCount + levels - 1) / levels;
+    int level = node / perLevel;
+    if (level == 0)
+        return -1;
+
+    int parentStart = (level - 1) * perLevel;
+    return parentStart + (node - level * perLevel) % perLevel;
+}
+
+static std::string
+write_primitive(mvGltfWriter& writer, const mvSceneDesc& desc, int mesh, int primitive)
+{
+    // a strip of the unit square per primitive, quads split into two triangles
+    int triangles = desc.trianglesPerPrimitive < 1 ? 1 : desc.trianglesPerPrimitive;
+    int quads = (triangles + 1) / 2;
+    int columns = (int)std::ceil(std::sqrt((float)quads));
+    int rows = (quads + columns - 1) / columns;
+    float height = 1.0f / desc.primitivesPerMesh;
+    float base = primitive * height;
+
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> uvs;
+    for (int r = 0; r <= rows; r++)
+    {
+        for (int c = 0; c <= columns; c++)
+        {
+            positions.insert(positions.end(), { (float)c / columns, base + height * r / rows, 0.0f });
+            normals.insert(normals.end(), { 0.0f, 0.0f, 1.0f });
+            uvs.insert(uvs.end(), { (float)c / columns, 1.0f - (float)r / rows });
+        }
+    }
+
+    std::vector<unsigned int> indices;
+    for (int q = 0; q < quads; q++)
+    {
+        unsigned int v0 = (q / columns) * (columns + 1) + q % columns;
+        unsigned int v2 = v0 + columns + 1;
+        indices.insert(indices.end(), { v0, v0 + 1, v2 + 1 });
+        if ((int)indices.size() / 3 < triangles)
+            indices.insert(indices.end(), { v0, v2 + 1, v2 });
+    }
+
+    int vertexCount = (int)positions.size() / 3;
+    std::string json = "{\"attributes\":{";
+    json.append("\"POSITION\":" + std::to_string(add_float_accessor(writer, positions, 3, "VEC3", 34962, true)));
+    json.append(",\"NORMAL\":" + std::to_string(add_float_accessor(writer, normals, 3, "VEC3", 34962)));
+    json.append(",\"TEXCOORD_0\":" + std::to_string(add_float_accessor(writer, uvs, 2, "VEC2", 34962)));
+
+    if (desc.jointCount > 0)
+    {
+        // rigid bands along y, one joint each
+        std::vector<unsigned short> joints;
+        std::vector<float> weights;
+        for (int i = 0; i < vertexCount; i++)
+        {
+            int joint = (int)(positions[i * 3 + 1] * desc.jointCount);
+            if (joint >= desc.jointCount)
+                joint = desc.jointCount - 1;
+            joints.insert(joints.end(), { (unsigned short)joint, 0, 0, 0 });
+            weights.insert(weights.end(), { 1.0f, 0.0f, 0.0f, 0.0f });
+        }
+
+        int view = add_buffer_view(writer, joints.data(), joints.size() * sizeof(unsigned short), 34962);
+        json.append(",\"JOINTS_0\":" + std::to_string(add_accessor(writer, view, 5123, vertexCount, "VEC4")));
+        json.append(",\"WEIGHTS_0\":" + std::to_string(add_float_accessor(writer, weights, 4, "VEC4", 34962)));
+    }
+    json.append("}");
+
+    int view = add_buffer_view(writer, indices.data(), indices.size() * sizeof(unsigned int), 34963);
+    json.append(",\"indices\":" + std::to_string(add_accessor(writer, view, 5125, (int)indices.size(), "SCALAR")));
+    json.append(",\"material\":" + std::to_string((mesh * desc.primitivesPerMesh + primitive) % desc.materialCount));
+
+    if (desc.morphTargetCount > 0)
+    {
+        json.append(",\"targets\":[");
+        for (int t = 0; t < desc.morphTargetCount; t++)
+        {
+            std::vector<float> offsets(positions.size(), 0.0f);
+            for (int i = 0; i < vertexCount; i++)
+                offsets[i * 3 + 2] = 0.05f * (t + 1) * positions[i * 3];
+            json.append(t == 0 ? "{" : ",{");
+            json.append("\"POSITION\":" + std::to_string(add_float_accessor(writer, offsets, 3, "VEC3", 34962, true)) + "}");
+        }
+        json.append("]");
+    }
+
+    return json + "}";
+}
+
+static std::string
+write_animations(mvGltfWriter& writer, const mvSceneDesc& desc)
+{
+    // a node/path pair may only be targeted once per animation, spill into more animations
+    const int keyCount = 5;
+    std::vector<float> times;
+    for (int k = 0; k < keyCount; k++)
+        times.push_back((float)k / (keyCount - 1));
+    int input = add_float_accessor(writer, times, 1, "SCALAR", 0, true);
+
+    int channelsPerAnimation = desc.nodeCount * 2;
+    std::string json = ",\"animations\":[";
+    for (int first = 0; first < desc.animationChannels; first += channelsPerAnimation)
+    {
+        std::string channels;
+        std::string samplers;
+        int count = desc.animationChannels - first < channelsPerAnimation ? desc.animationChannels - first : channelsPerAnimation;
+        for (int c = 0; c < count; c++)
+        {
+            int node = c / 2;
+            bool rotation = c % 2 == 1;
+
+            float local[3];
+            get_grid_position(node, desc.nodeCount, local);
+            int parent = get_parent_node(desc, node);
+            if (parent != -1)
+            {
+                float parentPosition[3];
+                get_grid_position(parent, desc.nodeCount, parentPosition);
+                for (int i = 0; i < 3; i++)
+                    local[i] -= parentPosition[i];
+            }
+
+            std::vector<float> values;
+            for (int k = 0; k < keyCount; k++)
+            {
+                float angle = 6.2831853f * k / (keyCount - 1);
+                if (rotation)
+                    values.insert(values.end(), { 0.0f, 0.0f, std::sin(angle * 0.5f), std::cos(angle * 0.5f) });
+                else
+                    values.insert(values.end(), { local[0], local[1] + 0.1f * std::sin(angle), local[2] });
+            }
+            int output = add_float_accessor(writer, values, rotation ? 4 : 3, rotation ? "VEC4" : "VEC3", 0);
+
+            channels.append(std::string(c == 0 ? "" : ",") + "{\"sampler\":" + std::to_string(c) + ",\"target\":{\"node\":" + std::to_string(node)
+                + ",\"path\":\"" + (rotation ? "rotation" : "translation") + "\"}}");
+            samplers.append(std::string(c == 0 ? "" : ",") + "{\"input\":" + std::to_string(input) + ",\"output\":" + std::to_string(output) + ",\"interpolation\":\"LINEAR\"}");
+        }
+
+        json.append(std::string(first == 0 ? "" : ",") + "{\"name\":\"animation_" + std::to_string(first / channelsPerAnimation)
+            + "\",\"channels\":[" + channels + "],\"samplers\":[" + samplers + "]}");
+    }
+    return json + "]";
+}
+
+static bool
+write_file(const std::string& path, const void* data, size_t size)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    bool result = fwrite(data, 1, size, file) == size;
+    fclose(file);
+    return result;
+}
+
+bool
+write_synthetic_gltf(const mvSceneDesc& desc, const std::string& path)
+{
+    bool binary = path.size() > 4 && path.compare(path.size() - 4, 4, ".glb") == 0;
+    size_t slash = path.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    std::string stem = path.substr(directory.size(), path.find_last_of('.') - directory.size());
+
+    mvGltfWriter writer{};
+    int jointStart = desc.nodeCount;
+
+    // meshes
+    std::string meshes;
+    for (int m = 0; m < desc.meshCount; m++)
+    {
+        std::string primitives;
+        for (int p = 0; p < desc.primitivesPerMesh; p++)
+            primitives.append((p == 0 ? "" : ",") + write_primitive(writer, desc, m, p));
+
+        meshes.append(std::string(m == 0 ? "" : ",") + "{\"name\":\"mesh_" + std::to_string(m) + "\",\"primitives\":[" + primitives + "]");
+        if (desc.morphTargetCount > 0)
+        {
+            std::vector<float> weights(desc.morphTargetCount, 0.0f);
+            weights[0] = 0.5f;
+            meshes.append(",\"weights\":" + format_floats(weights.data(), desc.morphTargetCount));
+        }
+        meshes.append("}");
+    }
+
+    // nodes, mesh nodes first then the joint chain
+    std::vector<std::vector<int>> children(desc.nodeCount);
+    std::string roots;
+    for (int n = 0; n < desc.nodeCount; n++)
+    {
+        int parent = get_parent_node(desc, n);
+        if (parent == -1)
+            roots.append((roots.empty() ? "" : ",") + std::to_string(n));
+        else
+            children[parent].push_back(n);
+    }
+
+    std::string nodes;
+    for (int n = 0; n < desc.nodeCount; n++)
+    {
+        float translation[3];
+        get_grid_position(n, desc.nodeCount, translation);
+        int parent = get_parent_node(desc, n);
+        if (parent != -1)
+        {
+            float parentPosition[3];
+            get_grid_position(parent, desc.nodeCount, parentPosition);
+            for (int i = 0; i < 3; i++)
+                translation[i] -= parentPosition[i];
+        }
+
+        nodes.append(std::string(n == 0 ? "" : ",") + "{\"name\":\"node_" + std::to_string(n) + "\",\"mesh\":" + std::to_string(n % desc.meshCount)
+            + ",\"translation\":" + format_floats(translation, 3));
+        if (desc.jointCount > 0)
+            nodes.append(",\"skin\":0");
+        if (!children[n].empty())
+        {
+            nodes.append(",\"children\":[");
+            for (size_t c = 0; c < children[n].size(); c++)
+                nodes.append((c == 0 ? "" : ",") + std::to_string(children[n][c]));
+            nodes.append("]");
+        }
+        nodes.append("}");
+    }
+
+    std::string skins;
+    if (desc.jointCount > 0)
+    {
+        std::vector<float> inverseBindMatrices;
+        std::string joints;
+        for (int j = 0; j < desc.jointCount; j++)
+        {
+            float step = j == 0 ? 0.0f : 1.0f / desc.jointCount;
+            nodes.append(",{\"name\":\"joint_" + std::to_string(j) + "\",\"translation\":[0," + std::to_string(step) + ",0]");
+            if (j + 1 < desc.jointCount)
+                nodes.append(",\"children\":[" + std::to_string(jointStart + j + 1) + "]");
+            nodes.append("}");
+
+            // column major, joint j sits at y = j / jointCount
+            float matrix[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,-(float)j / desc.jointCount,0,1 };
+            inverseBindMatrices.insert(inverseBindMatrices.end(), matrix, matrix + 16);
+            joints.append((j == 0 ? "" : ",") + std::to_string(jointStart + j));
+        }
+        roots.append("," + std::to_string(jointStart));
+
+        int accessor = add_float_accessor(writer, inverseBindMatrices, 16, "MAT4", 0);
+        skins = ",\"skins\":[{\"inverseBindMatrices\":" + std::to_string(accessor) + ",\"skeleton\":" + std::to_string(jointStart) + ",\"joints\":[" + joints + "]}]";
+    }
+
+    // materials and textures
+    std::string materials;
+    for (int m = 0; m < desc.materialCount; m++)
+    {
+        float color[4] = { 0.3f + 0.7f * ((m * 37) % 100) / 100.0f, 0.3f + 0.7f * ((m * 61) % 100) / 100.0f, 0.3f + 0.7f * ((m * 83) % 100) / 100.0f, 1.0f };
+        materials.append(std::string(m == 0 ? "" : ",") + "{\"name\":\"material_" + std::to_string(m) + "\",\"pbrMetallicRoughness\":{\"baseColorFactor\":"
+            + format_floats(color, 4) + ",\"metallicFactor\":0,\"roughnessFactor\":0.5");
+        if (desc.textureCount > 0)
+            materials.append(",\"baseColorTexture\":{\"index\":" + std::to_string(m % desc.textureCount) + "}");
+        materials.append("}");
+        if (desc.clearcoat)
+            materials.append(",\"extensions\":{\"KHR_materials_clearcoat\":{\"clearcoatFactor\":1,\"clearcoatRoughnessFactor\":0.1}}");
+        materials.append("}");
+    }
+
+    std::string images;
+    std::string textures;
+    for (int t = 0; t < desc.textureCount; t++)
+    {
+        std::vector<unsigned char> png = create_checker_texture(desc.textureSize, t);
+        if (binary)
+            images.append(std::string(t == 0 ? "" : ",") + "{\"bufferView\":" + std::to_string(add_buffer_view(writer, png.data(), png.size())) + ",\"mimeType\":\"image/png\"}");
+        else
+        {
+            std::string name = stem + "_" + std::to_string(t) + ".png";
+            if (!write_file(directory + name, png.data(), png.size()))
+                return false;
+            images.append(std::string(t == 0 ? "" : ",") + "{\"uri\":\"" + name + "\"}");
+        }
+        textures.append(std::string(t == 0 ? "" : ",") + "{\"sampler\":0,\"source\":" + std::to_string(t) + "}");
+    }
+
+    std::string animations;
+    if (desc.animationChannels > 0)
+        animations = write_animations(writer, desc);
+
+    while (writer.bin.size() % 4 != 0)
+        writer.bin.push_back(0);
+
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"mv3D synthetic scene\"}";
+    if (desc.clearcoat)
+        json.append(",\"extensionsUsed\":[\"KHR_materials_clearcoat\"]");
+    json.append(",\"scene\":0,\"scenes\":[{\"nodes\":[" + roots + "]}]");
+    json.append(",\"nodes\":[" + nodes + "]");
+    json.append(",\"meshes\":[" + meshes + "]");
+    json.append(",\"materials\":[" + materials + "]");
+    if (desc.textureCount > 0)
+    {
+        json.append(",\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987,\"wrapS\":10497,\"wrapT\":10497}]");
+        json.append(",\"images\":[" + images + "],\"textures\":[" + textures + "]");
+    }
+    json.append(skins + animations);
+    json.append(",\"accessors\":[" + writer.accessors + "]");
+    json.append(",\"bufferViews\":[" + writer.bufferViews + "]");
+    json.append(",\"buffers\":[{\"byteLength\":" + std::to_string(writer.bin.size()));
+    if (!binary)
+        json.append(",\"uri\":\"" + stem + ".bin\"");
+    json.append("}]}");
+
+    if (!binary)
+        return write_file(directory + stem + ".bin", writer.bin.data(), writer.bin.size()) && write_file(path, json.data(), json.size());
+
+    while (json.size() % 4 != 0)
+        json.push_back(' ');
+
+    std::vector<unsigned char> glb;
+    append_u32_le(glb, 0x46546C67u); // "glTF"
+    append_u32_le(glb, 2u);
+    append_u32_le(glb, (unsigned int)(12 + 8 + json.size() + 8 + writer.bin.size()));
+    append_u32_le(glb, (unsigned int)json.size());
+    append_u32_le(glb, 0x4E4F534Au); // "JSON"
+    glb.insert(glb.end(), json.begin(), json.end());
+    append_u32_le(glb, (unsigned int)writer.bin.size());
+    append_u32_le(glb, 0x004E4942u); // "BIN"
+    glb.insert(glb.end(), writer.bin.begin(), writer.bin.end());
+    return write_file(path, glb.data(), glb.size());
+}
+
+std::string
+describe_scene(const mvSceneDesc& desc)
+{
+    char text[256];
+    snprintf(text, sizeof(text), "nodes=%d depth=%d meshes=%d primitives=%d triangles=%d materials=%d textures=%d joints=%d morphs=%d channels=%d%s",
+        desc.nodeCount, desc.hierarchyDepth, desc.meshCount, desc.primitivesPerMesh, desc.trianglesPerPrimitive,
+        desc.materialCount, desc.textureCount, desc.jointCount, desc.morphTargetCount, desc.animationChannels,
+        desc.clearcoat ? " clearcoat" : "");
+    return text;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+// Writes synthetic glTF 2.0 scenes (.gltf + .bin + .png, or a single .glb)
+// for loader and renderer scaling tests. No graphics dependencies.
+
+// forward declarations
+struct mvSceneDesc;
+
+bool        write_synthetic_gltf(const mvSceneDesc& desc, const std::string& path); // binary if path ends in .glb
+std::string describe_scene      (const mvSceneDesc& desc);
+
+struct mvSceneDesc
+{
+    int nodeCount             = 1;  // mesh nodes, spread over the hierarchy levels
+    int hierarchyDepth        = 1;  // node levels, 1 keeps every node a scene root
+    int meshCount             = 1;  // distinct meshes, shared round robin by the nodes
+    int primitivesPerMesh     = 1;
+    int trianglesPerPrimitive = 2;
+    int materialCount         = 1;
+    int textureCount          = 0;  // base color textures, shared round robin by the materials
+    int textureSize           = 64;
+    int jointCount            = 0;  // one skin over a joint chain, 0 for none
+    int morphTargetCount      = 0;
+    int animationChannels     = 0;  // translation/rotation channels in one animation
+    bool clearcoat            = false; // KHR_materials_clearcoat on every material
+};
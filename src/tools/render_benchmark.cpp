@@ -0,0 +1,476 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "mvWindows.h"
+#include <psapi.h>
+#include "imgui.h"
+#include "mvGraphics.h"
+#include "mvAssetLoader.h"
+#include "mvAnimation.h"
+#include "mvCamera.h"
+#include "mvLights.h"
+#include "mvViewport.h"
+#include "sGltf.h"
+#include "mvSceneGenerator.h"
+#include "mvMaterials.h"
+
+// Sweeps synthetic scenes one dimension at a time, timing load_gltf_assets,
+// advance_animations, submit_scene and render_scenes. Results are written to
+// ../bench/render_benchmark_<dimension>.csv and plotted to the console.
+//
+// Then compares each lighting toggle compiled as a branch on
+// GlobalInfo::lightingFlags against the specialised permutations, in GPU
+// time per pixel, written to ../bench/render_benchmark_lighting.csv.
+
+struct mvBenchmarkDimension
+{
+    const char*          name;
+    int mvSceneDesc::*   field;
+    std::vector<int>     values;
+    int                  nodeCount = 0; // overrides the base scene, 0 keeps it
+};
+
+struct mvBenchmarkResult
+{
+    int    value = 0;
+    double loadMs = 0.0;       // Semper::load_gltf + load_gltf_assets
+    double animateMs = 0.0;    // advance_animations, per frame
+    double submitMs = 0.0;     // submit_scene, per frame
+    double renderMs = 0.0;     // render_scenes through Present, per frame
+    double modelMB = 0.0;      // model.cpuBytes + model.gpuBytes
+    double workingSetMB = 0.0; // process growth over the load
+};
+
+struct mvLightingResult
+{
+    const char* feature = nullptr;
+    bool        branch = false;  // compiled as a branch rather than a macro
+    bool        enabled = false;
+    double      gpuMs = 0.0;     // render_scenes, per frame
+    double      nsPerPixel = 0.0;
+};
+
+static const int s_frameCount = 32;
+static const int s_warmupFrames = 4;
+
+static double
+get_elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double
+get_working_set_mb()
+{
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.WorkingSetSize / (1024.0 * 1024.0);
+}
+
+static mvSceneDesc
+get_base_scene()
+{
+    // enough distinct primitives that every material and texture is used
+    mvSceneDesc desc{};
+    desc.nodeCount = 64;
+    desc.meshCount = 64;
+    desc.trianglesPerPrimitive = 512;
+    desc.materialCount = 64;
+    return desc;
+}
+
+static void
+fit_camera(mvCamera& camera, mvModel& model)
+{
+    camera.minBound = sVec3{ model.minBoundary[0], model.minBoundary[1], model.minBoundary[2] };
+    camera.maxBound = sVec3{ model.maxBoundary[0], model.maxBoundary[1], model.maxBoundary[2] };
+    camera.target.x = (camera.minBound.x + camera.maxBound.x) / 2.0f;
+    camera.target.y = (camera.minBound.y + camera.maxBound.y) / 2.0f;
+    camera.target.z = (camera.minBound.z + camera.maxBound.z) / 2.0f;
+
+    float maxAxisLength = Semper::get_max(camera.maxBound.x - camera.minBound.x, camera.maxBound.y - camera.minBound.y);
+    float yZoom = maxAxisLength / 2.0f / tan(camera.fieldOfView / 2.0f);
+    float xZoom = maxAxisLength / 2.0f / tan(camera.fieldOfView * camera.aspectRatio / 2.0f);
+    camera.distance = Semper::get_max(xZoom, yZoom);
+    camera.baseDistance = camera.distance;
+    camera.yaw = 0.0f;
+    camera.pitch = 0.0f;
+    camera.nearZ = Semper::get_max(camera.distance * 0.01f, 0.01f);
+    camera.farZ = camera.distance * 10.0f + maxAxisLength;
+    camera.pos = sVec3{ camera.target.x, camera.target.y, camera.target.z + camera.distance };
+}
+
+static mvBenchmarkResult
+run_scene(mvGraphics& graphics, mvRendererContext& renderCtx, mvPointLight& pointlight, mvDirectionalLight& directionalLight, const std::string& path)
+{
+    mvBenchmarkResult result{};
+    ID3D11DeviceContext* ctx = graphics.imDeviceContext.Get();
+
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    double workingSet = get_working_set_mb();
+    auto start = std::chrono::steady_clock::now();
+    sGLTFModel gltf = Semper::load_gltf(directory.c_str(), path.c_str());
+    mvModel model = load_gltf_assets(graphics, gltf, path.c_str());
+    result.loadMs = get_elapsed_ms(start);
+    result.workingSetMB = get_working_set_mb() - workingSet;
+    result.modelMB = (model.cpuBytes + model.gpuBytes) / (1024.0 * 1024.0);
+    Semper::free_gltf(gltf);
+
+    mvCamera camera = create_perspective_camera({ 0.0f, 0.0f, 5.0f }, (float)S_PI / 4.0f, graphics.viewport.Width / graphics.viewport.Height, 0.1f, 400.0f);
+    fit_camera(camera, model);
+    renderCtx.camera = &camera;
+
+    for (int frame = 0; frame < s_frameCount; frame++)
+    {
+        process_viewport_events();
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < model.animations.size(); i++)
+            advance_animations(model, model.animations[i], frame / 60.0f);
+        result.animateMs += get_elapsed_ms(start);
+
+        sMat4 viewMatrix = create_arcball_view(camera);
+        sMat4 projMatrix = create_projection(camera);
+
+        start = std::chrono::steady_clock::now();
+        if (model.defaultScene > -1)
+            submit_scene(graphics, model, renderCtx, model.scenes[model.defaultScene]);
+        result.submitMs += get_elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        static float backgroundColor[] = { 0.2f, 0.2f, 0.2f, 1.0f };
+        ctx->ClearRenderTargetView(graphics.target.Get(), backgroundColor);
+        ctx->ClearDepthStencilView(graphics.targetDepth.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0u);
+        ctx->OMSetRenderTargets(1, graphics.target.GetAddressOf(), graphics.targetDepth.Get());
+        ctx->RSSetViewports(1u, &graphics.viewport);
+
+        renderCtx.globalInfo.camPos = camera.pos;
+        update_const_buffer(graphics, pointlight.buffer, &pointlight.info);
+        update_const_buffer(graphics, directionalLight.buffer, &directionalLight.info);
+        update_const_buffer(graphics, renderCtx.globalInfoBuffer, &renderCtx.globalInfo);
+        ctx->PSSetConstantBuffers(0u, 1u, pointlight.buffer.buffer.GetAddressOf());
+        ctx->PSSetConstantBuffers(2u, 1u, directionalLight.buffer.buffer.GetAddressOf());
+        ctx->PSSetConstantBuffers(3u, 1u, renderCtx.globalInfoBuffer.buffer.GetAddressOf());
+
+        for (int i = 0; i < model.nodes.size(); i++)
+        {
+            mvNode& node = model.nodes[i];
+            if (node.skin != -1 && node.mesh != -1)
+            {
+                unsigned int skeleton = model.skins[node.skin].skeleton;
+                if (skeleton != -1)
+                    compute_joints(graphics, model, model.nodes[skeleton].inverseWorldTransform, model.skins[node.skin]);
+                else
+                    compute_joints(graphics, model, viewMatrix, model.skins[node.skin]);
+            }
+        }
+
+        render_scenes(graphics, model, renderCtx, viewMatrix, projMatrix);
+        update_texture_streaming(graphics);
+        graphics.swapChain->Present(0, 0);
+        result.renderMs += get_elapsed_ms(start);
+    }
+
+    result.animateMs /= s_frameCount;
+    result.submitMs /= s_frameCount;
+    result.renderMs /= s_frameCount;
+
+    renderCtx.camera = nullptr;
+    unload_gltf_assets(graphics, model);
+    return result;
+}
+
+// one disjoint/timestamp pair per frame, read back straight away, the stall doesn't matter here
+static double
+get_gpu_ms(mvGraphics& graphics, ID3D11Query* disjoint, ID3D11Query* begin, ID3D11Query* end)
+{
+    ID3D11DeviceContext* ctx = graphics.imDeviceContext.Get();
+
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData{};
+    while (ctx->GetData(disjoint, &disjointData, sizeof(disjointData), 0u) == S_FALSE)
+        Sleep(0);
+
+    UINT64 beginTime = 0u;
+    UINT64 endTime = 0u;
+    while (ctx->GetData(begin, &beginTime, sizeof(UINT64), 0u) == S_FALSE)
+        Sleep(0);
+    while (ctx->GetData(end, &endTime, sizeof(UINT64), 0u) == S_FALSE)
+        Sleep(0);
+
+    if (disjointData.Disjoint || disjointData.Frequency == 0u)
+        return -1.0;
+    return (endTime - beginTime) * 1000.0 / disjointData.Frequency;
+}
+
+static std::vector<mvLightingResult>
+run_lighting(mvGraphics& graphics, mvRendererContext& renderCtx, mvPointLight& pointlight, mvDirectionalLight& directionalLight,
+    mvEnvironment& environment, const std::string& path)
+{
+    struct mvLightingFeature { const char* name; unsigned int flag; bool* toggle; };
+    mvLightingFeature features[] = {
+        { "ibl",       MV_LIGHTING_IBL,       &graphics.imageBasedLighting },
+        { "punctual",  MV_LIGHTING_PUNCTUAL,  &graphics.punctualLighting },
+        { "clearcoat", MV_LIGHTING_CLEARCOAT, &graphics.clearcoat },
+    };
+
+    std::vector<mvLightingResult> results;
+    ID3D11DeviceContext* ctx = graphics.imDeviceContext.Get();
+
+    Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+    Microsoft::WRL::ComPtr<ID3D11Query> begin;
+    Microsoft::WRL::ComPtr<ID3D11Query> end;
+    D3D11_QUERY_DESC queryDesc{};
+    queryDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+    graphics.device->CreateQuery(&queryDesc, disjoint.GetAddressOf());
+    queryDesc.Query = D3D11_QUERY_TIMESTAMP;
+    graphics.device->CreateQuery(&queryDesc, begin.GetAddressOf());
+    graphics.device->CreateQuery(&queryDesc, end.GetAddressOf());
+
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    sGLTFModel gltf = Semper::load_gltf(directory.c_str(), path.c_str());
+    mvModel model = load_gltf_assets(graphics, gltf, path.c_str());
+    Semper::free_gltf(gltf);
+
+    mvCamera camera = create_perspective_camera({ 0.0f, 0.0f, 5.0f }, (float)S_PI / 4.0f, graphics.viewport.Width / graphics.viewport.Height, 0.1f, 400.0f);
+    fit_camera(camera, model);
+    renderCtx.camera = &camera;
+    sMat4 viewMatrix = create_arcball_view(camera);
+    sMat4 projMatrix = create_projection(camera);
+    double pixelCount = (double)graphics.viewport.Width * graphics.viewport.Height;
+
+    // the other toggles stay on and specialised, so only one feature changes per row
+    for (const mvLightingFeature& feature : features)
+    {
+        for (int mode = 0; mode < 4; mode++)
+        {
+            mvLightingResult result{};
+            result.feature = feature.name;
+            result.branch = mode >= 2;
+            result.enabled = (mode & 1) == 0;
+
+            graphics.imageBasedLighting = graphics.punctualLighting = graphics.clearcoat = true;
+            *feature.toggle = result.enabled;
+            graphics.lightingBranches = result.branch ? feature.flag : 0u;
+            reload_materials(graphics, &model.materialManager);
+
+            int timedFrames = 0;
+            for (int frame = 0; frame < s_warmupFrames + s_frameCount; frame++)
+            {
+                process_viewport_events();
+
+                if (model.defaultScene > -1)
+                    submit_scene(graphics, model, renderCtx, model.scenes[model.defaultScene]);
+
+                static float backgroundColor[] = { 0.2f, 0.2f, 0.2f, 1.0f };
+                ctx->ClearRenderTargetView(graphics.target.Get(), backgroundColor);
+                ctx->ClearDepthStencilView(graphics.targetDepth.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0u);
+                ctx->OMSetRenderTargets(1, graphics.target.GetAddressOf(), graphics.targetDepth.Get());
+                ctx->RSSetViewports(1u, &graphics.viewport);
+
+                renderCtx.globalInfo.camPos = camera.pos;
+                renderCtx.globalInfo.lightingFlags = (int)get_lighting_flags(graphics);
+                update_const_buffer(graphics, pointlight.buffer, &pointlight.info);
+                update_const_buffer(graphics, directionalLight.buffer, &directionalLight.info);
+                update_const_buffer(graphics, renderCtx.globalInfoBuffer, &renderCtx.globalInfo);
+                ctx->PSSetConstantBuffers(0u, 1u, pointlight.buffer.buffer.GetAddressOf());
+                ctx->PSSetConstantBuffers(2u, 1u, directionalLight.buffer.buffer.GetAddressOf());
+                ctx->PSSetConstantBuffers(3u, 1u, renderCtx.globalInfoBuffer.buffer.GetAddressOf());
+                ctx->PSSetSamplers(12u, 1, environment.sampler.GetAddressOf());
+                ctx->PSSetSamplers(13u, 1, environment.sampler.GetAddressOf());
+                ctx->PSSetSamplers(14u, 1, environment.brdfSampler.GetAddressOf());
+                ctx->PSSetShaderResources(12u, 1, environment.irradianceMap.textureView.GetAddressOf());
+                ctx->PSSetShaderResources(13u, 1, environment.specularMap.textureView.GetAddressOf());
+                ctx->PSSetShaderResources(14u, 1, environment.brdfLUT.textureView.GetAddressOf());
+
+                ctx->Begin(disjoint.Get());
+                ctx->End(begin.Get());
+                render_scenes(graphics, model, renderCtx, viewMatrix, projMatrix);
+                ctx->End(end.Get());
+                ctx->End(disjoint.Get());
+                graphics.swapChain->Present(0, 0);
+
+                double gpuMs = get_gpu_ms(graphics, disjoint.Get(), begin.Get(), end.Get());
+                if (frame >= s_warmupFrames && gpuMs >= 0.0)
+                {
+                    result.gpuMs += gpuMs;
+                    timedFrames++;
+                }
+            }
+
+            if (timedFrames > 0)
+                result.gpuMs /= timedFrames;
+            result.nsPerPixel = result.gpuMs * 1000000.0 / pixelCount;
+            results.push_back(result);
+        }
+    }
+
+    graphics.imageBasedLighting = graphics.punctualLighting = graphics.clearcoat = true;
+    graphics.lightingBranches = MV_LIGHTING_ALL;
+    renderCtx.camera = nullptr;
+    unload_gltf_assets(graphics, model);
+    return results;
+}
+
+static void
+print_plot(const char* label, const std::vector<mvBenchmarkResult>& results, double mvBenchmarkResult::* metric)
+{
+    double maxValue = 0.0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (results[i].*metric > maxValue)
+            maxValue = results[i].*metric;
+    }
+
+    printf("  %s\n", label);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        int width = maxValue > 0.0 ? (int)(40.0 * (results[i].*metric) / maxValue + 0.5) : 0;
+        printf("  %8d | %s %.3f\n", results[i].value, std::string(width, '#').c_str(), results[i].*metric);
+    }
+}
+
+static void
+write_results(const mvBenchmarkDimension& dimension, const std::vector<mvBenchmarkResult>& results, const std::string& directory)
+{
+    FILE* file = fopen((directory + "render_benchmark_" + dimension.name + ".csv").c_str(), "w");
+    if (file == nullptr)
+        return;
+
+    fprintf(file, "%s,load_ms,animate_ms,submit_ms,render_ms,model_mb,working_set_mb\n", dimension.name);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const mvBenchmarkResult& result = results[i];
+        fprintf(file, "%d,%.3f,%.4f,%.4f,%.4f,%.3f,%.3f\n", result.value, result.loadMs, result.animateMs,
+            result.submitMs, result.renderMs, result.modelMB, result.workingSetMB);
+    }
+    fclose(file);
+}
+
+static void
+write_lighting_results(const std::vector<mvLightingResult>& results, const std::string& directory)
+{
+    FILE* file = fopen((directory + "render_benchmark_lighting.csv").c_str(), "w");
+    if (file == nullptr)
+        return;
+
+    fprintf(file, "feature,mode,enabled,gpu_ms,ns_per_pixel\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const mvLightingResult& result = results[i];
+        fprintf(file, "%s,%s,%d,%.4f,%.4f\n", result.feature, result.branch ? "branch" : "specialised",
+            result.enabled ? 1 : 0, result.gpuMs, result.nsPerPixel);
+    }
+    fclose(file);
+}
+
+int main(int argc, char** argv)
+{
+    // --quick runs the first three values of every dimension, --lighting only the lighting comparison
+    bool quick = false;
+    bool lightingOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--quick") == 0)
+            quick = true;
+        else if (strcmp(argv[i], "--lighting") == 0)
+            lightingOnly = true;
+    }
+    std::string directory = "../bench/";
+    std::filesystem::create_directories(directory);
+
+    std::vector<mvBenchmarkDimension> dimensions = {
+        { "nodes",      &mvSceneDesc::nodeCount,             { 1, 10, 100, 1000, 10000, 100000 } },
+        { "depth",      &mvSceneDesc::hierarchyDepth,        { 1, 2, 8, 32, 64 } },
+        { "hierarchy",  &mvSceneDesc::hierarchyDepth,        { 1, 2, 8, 32 }, 100000 },
+        { "primitives", &mvSceneDesc::primitivesPerMesh,     { 1, 4, 16, 64 } },
+        { "triangles",  &mvSceneDesc::trianglesPerPrimitive, { 2, 128, 2048, 32768, 262144 } },
+        { "materials",  &mvSceneDesc::materialCount,         { 1, 4, 16, 64 } },
+        { "textures",   &mvSceneDesc::textureCount,          { 0, 4, 16, 64 } },
+        { "joints",     &mvSceneDesc::jointCount,            { 0, 4, 16, 64, 256 } },
+        { "morphs",     &mvSceneDesc::morphTargetCount,      { 0, 1, 2, 4, 8 } },
+        { "channels",   &mvSceneDesc::animationChannels,     { 0, 16, 128, 1024, 8192 } },
+    };
+
+    mvViewport* window = initialize_viewport(1280, 720);
+    mvGraphics graphics = setup_graphics(*window, "../src/shaders/");
+    ImGui::CreateContext(); // camera and viewport code read ImGui io
+    mvRendererContext renderCtx = create_renderer_context(graphics);
+    mvPointLight pointlight = create_point_light(graphics);
+    pointlight.info.viewLightPos = sVec4{ -15.0f, 15.0f, 10.0f, 0.0f };
+    mvDirectionalLight directionalLight = create_directional_light(graphics);
+
+    for (size_t d = 0; d < dimensions.size() && !lightingOnly; d++)
+    {
+        mvBenchmarkDimension& dimension = dimensions[d];
+        std::vector<mvBenchmarkResult> results;
+
+        printf("%s\n", dimension.name);
+        size_t valueCount = quick && dimension.values.size() > 3 ? 3 : dimension.values.size();
+        for (size_t v = 0; v < valueCount; v++)
+        {
+            mvSceneDesc desc = get_base_scene();
+            if (dimension.nodeCount > 0)
+                desc.nodeCount = dimension.nodeCount;
+            desc.*dimension.field = dimension.values[v];
+
+            std::string path = directory + "synthetic_" + dimension.name + "_" + std::to_string(dimension.values[v]) + ".glb";
+            if (!write_synthetic_gltf(desc, path))
+            {
+                printf("  failed to write %s\n", path.c_str());
+                continue;
+            }
+
+            mvBenchmarkResult result = run_scene(graphics, renderCtx, pointlight, directionalLight, path);
+            result.value = dimension.values[v];
+            results.push_back(result);
+            printf("  %s: load %.2f ms, frame %.3f ms, %.2f MB\n", describe_scene(desc).c_str(), result.loadMs,
+                result.animateMs + result.submitMs + result.renderMs, result.modelMB);
+        }
+
+        print_plot("load (ms)", results, &mvBenchmarkResult::loadMs);
+        print_plot("advance_animations (ms/frame)", results, &mvBenchmarkResult::animateMs);
+        print_plot("submit_scene (ms/frame)", results, &mvBenchmarkResult::submitMs);
+        print_plot("render_scenes + present (ms/frame)", results, &mvBenchmarkResult::renderMs);
+        print_plot("model footprint (MB)", results, &mvBenchmarkResult::modelMB);
+        print_plot("working set growth (MB)", results, &mvBenchmarkResult::workingSetMB);
+        write_results(dimension, results, directory);
+    }
+
+    // few large primitives so the pixel shader dominates
+    mvSceneDesc lightingDesc{};
+    lightingDesc.nodeCount = 16;
+    lightingDesc.meshCount = 16;
+    lightingDesc.trianglesPerPrimitive = 2048;
+    lightingDesc.materialCount = 4;
+    lightingDesc.textureCount = 4;
+    lightingDesc.clearcoat = true;
+
+    std::string lightingPath = directory + "synthetic_lighting.glb";
+    if (!write_synthetic_gltf(lightingDesc, lightingPath))
+    {
+        printf("failed to write %s\n", lightingPath.c_str());
+        return 1;
+    }
+
+    // the viewer's default environment
+    mvEnvironment environment = create_environment(graphics, "../data/glTF-Sample-Environments/field.hdr", 1024, 1024, 1.0f, 7);
+    std::vector<mvLightingResult> lightingResults = run_lighting(graphics, renderCtx, pointlight, directionalLight, environment, lightingPath);
+    cleanup_environment(environment);
+
+    // a branch is worth keeping when its overhead over the specialised shader is small in both states
+    printf("lighting (%s, %.0fx%.0f)\n", describe_scene(lightingDesc).c_str(), graphics.viewport.Width, graphics.viewport.Height);
+    for (size_t i = 0; i + 3 < lightingResults.size(); i += 4)
+    {
+        const mvLightingResult* r = &lightingResults[i];
+        printf("  %-9s specialised on %.3f ns/px, off %.3f ns/px | branch on %.3f ns/px (%+.1f%%), off %.3f ns/px (%+.1f%%)\n",
+            r[0].feature, r[0].nsPerPixel, r[1].nsPerPixel,
+            r[2].nsPerPixel, r[0].nsPerPixel > 0.0 ? 100.0 * (r[2].nsPerPixel - r[0].nsPerPixel) / r[0].nsPerPixel : 0.0,
+            r[3].nsPerPixel, r[1].nsPerPixel > 0.0 ? 100.0 * (r[3].nsPerPixel - r[1].nsPerPixel) / r[1].nsPerPixel : 0.0);
+    }
+    write_lighting_results(lightingResults, directory);
+
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include <d3dcompiler.h>
+#include "mvGraphics.h"
+#include "mvMaterials.h"
+#include "mvAssetLoader.h"
+#include "mvOcclusionBake.h"
+#include "mvShaderCache.h"
+#include "mvShaderPermutations.h"
+#include "mvJson.h"
+#include "sGltf.h"
+#include "gltf_scene_info.h"
+
+// usage: shader_census [options] [model.gltf|model.glb ...]
+//
+// Cooks every primitive of each model the way the loader does, lists the PBR
+// permutations it needs and precompiles exactly those into the shader archive
+// the viewer loads at startup (MV_SHADER_ARCHIVE_PATH). No window or device is created.
+
+struct mvCensusPermutation
+{
+    mvShaderPermutation permutation;
+    unsigned int        models = 0u; // how many models use it
+    uint64_t            vertexKey = 0u;
+    uint64_t            pixelKey = 0u;
+    bool                compiled = false;
+};
+
+struct mvModelCensus
+{
+    std::string           path;
+    unsigned int          primitives = 0u;
+    std::vector<uint64_t> permutations; // hash_permutation, into the census map
+};
+
+struct mvCensusOptions
+{
+    std::string shaderDirectory = "../src/shaders/";
+    std::string archivePath = MV_SHADER_ARCHIVE_PATH;
+    std::string jsonPath = "../bench/shader_census.json";
+    bool        compile = true;
+    bool        bakeOcclusion = false;
+    bool        lightingVariants = false; // every IBL/punctual/clearcoat toggle, not just the defaults
+    unsigned    lightingBranches = MV_LIGHTING_ALL; // mvGraphics::lightingBranches of the viewer the archive is for
+};
+
+// the primitive's material plus every KHR_materials_variants mapping, like load_gltf_primitive_materials
+static std::vector<int>
+get_primitive_materials(sGLTFModel& model, const mvJsonValue* jsonMeshes, unsigned int currentMesh, unsigned int currentPrimitive)
+{
+    std::vector<int> materials = { model.meshes[currentMesh].primitives[currentPrimitive].material_index };
+
+    if (jsonMeshes == nullptr || currentMesh >= jsonMeshes->elements.size())
+        return materials;
+    const mvJsonValue* jsonPrimitives = get_json_member(jsonMeshes->elements[currentMesh], "primitives");
+    if (jsonPrimitives == nullptr || currentPrimitive >= jsonPrimitives->elements.size())
+        return materials;
+    const mvJsonValue* mappings = get_json_path(jsonPrimitives->elements[currentPrimitive], { "extensions", "KHR_materials_variants", "mappings" });
+    for (unsigned int i = 0; mappings && i < mappings->elements.size(); i++)
+    {
+        const mvJsonValue* material = get_json_member(mappings->elements[i], "material");
+        if (material && material->number >= 0.0 && material->number < model.material_count)
+            materials.push_back((int)material->number);
+    }
+    return materials;
+}
+
+static bool
+census_model(const char* directory, const char* file, const mvCensusOptions& options, mvModelCensus& census, std::unordered_map<uint64_t, mvCensusPermutation>& permutations)
+{
+    census.path = file;
+    if (!std::filesystem::exists(file))
+        return false;
+
+    sGLTFModel model = Semper::load_gltf(directory, file);
+
+    // sGltf doesn't expose extensions, same json reads as prepare_gltf_extensions
+    mvJsonValue json;
+    load_gltf_json(file, json);
+    const mvJsonValue* jsonNodes = get_json_member(json, "nodes");
+    const mvJsonValue* jsonMeshes = get_json_member(json, "meshes");
+
+    std::vector<bool> instancedMeshes(model.mesh_count, false);
+    for (unsigned int i = 0; i < model.node_count; i++)
+    {
+        int mesh = model.nodes[i].mesh_index;
+        if (mesh > -1 && jsonNodes && i < jsonNodes->elements.size()
+            && get_json_path(jsonNodes->elements[i], { "extensions", "EXT_mesh_gpu_instancing", "attributes" }))
+            instancedMeshes[mesh] = true;
+    }
+
+    int lightingCount = options.lightingVariants ? 8 : 1;
+    for (unsigned int i = 0; i < model.mesh_count; i++)
+    {
+        sGLTFMesh& glmesh = model.meshes[i];
+        std::vector<mvCookedPrimitive> cookedPrimitives(glmesh.primitives_count);
+        std::vector<mvCookedPrimitive*> primitives;
+        for (unsigned int j = 0; j < glmesh.primitives_count; j++)
+        {
+            cook_gltf_primitive(model, glmesh, j, instancedMeshes[i], cookedPrimitives[j]);
+            primitives.push_back(&cookedPrimitives[j]);
+        }
+
+        if (options.bakeOcclusion)
+            bake_vertex_occlusion(primitives, mvOcclusionSettings{});
+
+        for (unsigned int j = 0; j < glmesh.primitives_count; j++)
+        {
+            census.primitives++;
+            for (int materialIndex : get_primitive_materials(model, jsonMeshes, i, j))
+            {
+                mvMaterial material = cookedPrimitives[j].material;
+                cook_gltf_material(model, materialIndex, material);
+
+                // lighting 0 is the viewer's default, everything on
+                for (int lighting = 0; lighting < lightingCount; lighting++)
+                {
+                    mvShaderPermutation permutation = get_material_permutation(material, MV_LIGHTING_ALL & ~(unsigned)lighting, options.lightingBranches);
+                    uint64_t key = hash_permutation(permutation);
+                    if (std::find(census.permutations.begin(), census.permutations.end(), key) != census.permutations.end())
+                        continue;
+
+                    census.permutations.push_back(key);
+                    mvCensusPermutation& entry = permutations[key];
+                    entry.permutation = permutation;
+                    entry.models++;
+                }
+            }
+            delete[] cookedPrimitives[j].morphData;
+        }
+    }
+
+    Semper::free_gltf(model);
+    return true;
+}
+
+static HRESULT
+precompile_shader(mvShaderCache& cache, const std::string& path, const std::vector<mvShaderMacro>& macros, const char* target, uint64_t& key)
+{
+    // same conversion as finalize_pipeline so the keys match the viewer's
+    std::vector<D3D_SHADER_MACRO> d3dMacros;
+    for (auto& macro : macros)
+        d3dMacros.push_back({ macro.macro.c_str(), macro.value.c_str() });
+    d3dMacros.push_back({ NULL, NULL });
+
+    key = get_shader_cache_key(cache, path, d3dMacros.data(), target, 0);
+
+    Microsoft::WRL::ComPtr<ID3DBlob> blob;
+    Microsoft::WRL::ComPtr<ID3DBlob> errors;
+    HRESULT hResult = compile_shader(cache, path, d3dMacros.data(), target, 0, blob.GetAddressOf(), errors.GetAddressOf());
+    if (FAILED(hResult) && errors.Get() != nullptr)
+        printf("%s (%s): %s\n", path.c_str(), target, (const char*)errors->GetBufferPointer());
+    return hResult;
+}
+
+static void
+print_census(const std::vector<mvModelCensus>& models, const std::unordered_map<uint64_t, mvCensusPermutation>& permutations)
+{
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        const mvModelCensus& census = models[i];
+        std::string name = std::filesystem::path(census.path).stem().string();
+        printf("%s: %u primitives, %zu permutations\n", name.c_str(), census.primitives, census.permutations.size());
+        for (uint64_t key : census.permutations)
+            printf("  %016llx  %s\n", (unsigned long long)key, describe_permutation(permutations.at(key).permutation).c_str());
+    }
+
+    unsigned int shared = 0u;
+    for (auto& item : permutations)
+        shared += item.second.models > 1u ? 1u : 0u;
+    printf("\n%zu unique permutations over %zu models, %u used by more than one model\n", permutations.size(), models.size(), shared);
+}
+
+static void
+write_json(const std::vector<mvModelCensus>& models, const std::unordered_map<uint64_t, mvCensusPermutation>& permutations, const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+        return;
+
+    fprintf(file, "{\n  \"models\": [");
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        const mvModelCensus& census = models[i];
+        fprintf(file, "%s\n    { \"path\": \"%s\", \"primitives\": %u, \"permutations\": [", i == 0 ? "" : ",", escape_json(census.path).c_str(), census.primitives);
+        for (size_t j = 0; j < census.permutations.size(); j++)
+            fprintf(file, "%s\"%016llx\"", j == 0 ? "" : ", ", (unsigned long long)census.permutations[j]);
+        fprintf(file, "] }");
+    }
+    fprintf(file, "\n  ],\n  \"permutations\": [");
+    bool first = true;
+    for (auto& item : permutations)
+    {
+        const mvCensusPermutation& entry = item.second;
+        fprintf(file, "%s\n    { \"key\": \"%016llx\", \"bits\": \"%016llx\", \"models\": %u, \"compiled\": %s, \"macros\": \"%s\" }", first ? "" : ",",
+            (unsigned long long)item.first, (unsigned long long)entry.permutation.bits, entry.models, entry.compiled ? "true" : "false",
+            describe_permutation(entry.permutation).c_str());
+        first = false;
+    }
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+}
+
+static void
+print_usage()
+{
+    printf("usage: shader_census [options] [model.gltf|model.glb ...]\n");
+    printf("  --archive <path>     shader archive to write (default %s)\n", MV_SHADER_ARCHIVE_PATH);
+    printf("  --shaders <dir>      shader directory (default ../src/shaders/)\n");
+    printf("  --json <path>        census output (default ../bench/shader_census.json)\n");
+    printf("  --no-compile         list the permutations only\n");
+    printf("  --bake-occlusion     models are loaded with the per-vertex occlusion bake\n");
+    printf("  --lighting-variants  include every IBL/punctual/clearcoat toggle\n");
+    printf("  --specialised        lighting toggles are macros rather than branches\n");
+}
+
+int main(int argc, char** argv)
+{
+    mvCensusOptions options;
+    std::vector<std::string> directories;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
+            options.archivePath = argv[++i];
+        else if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc)
+            options.shaderDirectory = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            options.jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--no-compile") == 0)
+            options.compile = false;
+        else if (strcmp(argv[i], "--bake-occlusion") == 0)
+            options.bakeOcclusion = true;
+        else if (strcmp(argv[i], "--lighting-variants") == 0)
+            options.lightingVariants = true;
+        else if (strcmp(argv[i], "--specialised") == 0)
+            options.lightingBranches = 0u;
+        else if (argv[i][0] == '-')
+        {
+            print_usage();
+            return 1;
+        }
+        else
+        {
+            std::string directory = std::filesystem::path(argv[i]).parent_path().string();
+            directories.push_back(directory.empty() ? "./" : directory + "/");
+            files.push_back(argv[i]);
+        }
+    }
+
+    // default to the sandbox's model list
+    if (files.empty())
+    {
+        for (int i = 0; i < sizeof(gltf_models) / sizeof(gltf_models[0]); i++)
+        {
+            directories.push_back(gltf_directories[i]);
+            files.push_back(gltf_models[i]);
+        }
+    }
+
+    unsigned int failures = 0u;
+    std::vector<mvModelCensus> models;
+    std::unordered_map<uint64_t, mvCensusPermutation> permutations;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        mvModelCensus census{};
+        if (census_model(directories[i].c_str(), files[i].c_str(), options, census, permutations))
+            models.push_back(census);
+        else
+            printf("skipping %s (not found)\n", files[i].c_str());
+    }
+
+    print_census(models, permutations);
+
+    if (options.compile)
+    {
+        mvShaderCache cache;
+        std::vector<uint64_t> keys;
+        for (auto& item : permutations)
+        {
+            mvCensusPermutation& entry = item.second;
+            std::vector<mvShaderMacro> vertexMacros;
+            std::vector<mvShaderMacro> pixelMacros;
+            get_permutation_macros(entry.permutation, vertexMacros, MV_SHADER_STAGE_VERTEX);
+            get_permutation_macros(entry.permutation, pixelMacros, MV_SHADER_STAGE_PIXEL);
+
+            bool vertex = SUCCEEDED(precompile_shader(cache, options.shaderDirectory + "PBR_VS.hlsl", vertexMacros, "vs_5_0", entry.vertexKey));
+            bool pixel = SUCCEEDED(precompile_shader(cache, options.shaderDirectory + "PBR_PS.hlsl", pixelMacros, "ps_5_0", entry.pixelKey));
+            if (vertex)
+                keys.push_back(entry.vertexKey);
+            if (pixel)
+                keys.push_back(entry.pixelKey);
+            entry.compiled = vertex && pixel;
+            failures += entry.compiled ? 0u : 1u;
+        }
+
+        // permutations that differ in one stage only share the other stage's shader
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        printf("compiled %u, disk cache %u, reused %u, failed %u\n", cache.compiles, cache.diskHits, cache.memoryHits, failures);
+        if (save_shader_archive(cache, options.archivePath, keys))
+            printf("wrote %s (%zu shaders)\n", options.archivePath.c_str(), keys.size());
+        else
+            printf("could not write %s\n", options.archivePath.c_str());
+    }
+
+    std::filesystem::path output(options.jsonPath);
+    if (output.has_parent_path())
+        std::filesystem::create_directories(output.parent_path());
+    write_json(models, permutations, options.jsonPath.c_str());
+    printf("wrote %s\n", options.jsonPath.c_str());
+    return failures > 0u ? 1 : 0;
+}